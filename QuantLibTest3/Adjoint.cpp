@@ -0,0 +1,137 @@
+/* -*- mode: c++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+// QuantLib Black-Scholes-Merton test - adjoint algorithmic differentiation
+
+#include "Adjoint.hpp"
+
+#include <cmath>
+
+using namespace QuantLib;
+
+namespace ad {
+
+	Tape::Tape()
+	{
+		clear();
+	}
+
+	void Tape::clear()
+	{
+		Node constants = { 0, 0, 0.0, 0.0 };
+		nodes_.resize(1);
+		nodes_[0] = constants;
+	}
+
+	Number Tape::variable(Real value)
+	{
+		return Number(value, record(0, 0.0), this);
+	}
+
+	Size Tape::record(Size first,
+		Real firstPartial,
+		Size second,
+		Real secondPartial)
+	{
+		Node node = { first, second, firstPartial, secondPartial };
+		nodes_.push_back(node);
+		return nodes_.size() - 1;
+	}
+
+	void Tape::propagate(const Number & result)
+	{
+		QL_REQUIRE(result.tape() == this, "result not recorded on this tape");
+
+		adjoints_.assign(nodes_.size(), 0.0);
+		adjoints_[result.node()] = 1.0;
+		for (Size i = nodes_.size() - 1; i > 0; --i) {
+			const Node & node = nodes_[i];
+			Real adjoint = adjoints_[i];
+			adjoints_[node.first] += adjoint * node.firstPartial;
+			adjoints_[node.second] += adjoint * node.secondPartial;
+		}
+	}
+
+	Real Tape::adjoint(const Number & x) const
+	{
+		if (x.node() == 0)
+			return 0.0;
+		QL_REQUIRE(x.tape() == this, "variable not recorded on this tape");
+		QL_REQUIRE(x.node() < adjoints_.size(), "variable recorded after propagate()");
+		return adjoints_[x.node()];
+	}
+
+	Number Exp(const Number & x)
+	{
+		Real value = std::exp(x.value());
+		return Unary(x, value, value);
+	}
+
+	Number Log(const Number & x)
+	{
+		return Unary(x, std::log(x.value()), 1.0 / x.value());
+	}
+
+	Number Sqrt(const Number & x)
+	{
+		Real value = std::sqrt(x.value());
+		return Unary(x, value, 0.5 / value);
+	}
+
+	Number NormalCdf(const Number & x)
+	{
+		CumulativeNormalDistribution cdf;
+		return Unary(x, cdf(x.value()), cdf.derivative(x.value()));
+	}
+
+	Real Exp(Real x)
+	{
+		return std::exp(x);
+	}
+
+	Real Log(Real x)
+	{
+		return std::log(x);
+	}
+
+	Real Sqrt(Real x)
+	{
+		return std::sqrt(x);
+	}
+
+	Real NormalCdf(Real x)
+	{
+		return CumulativeNormalDistribution()(x);
+	}
+
+}
+
+OptionSensitivities AdjointBlackScholes(const OptionInputs & in,
+	const Date & settlementDate,
+	ad::Tape & tape)
+{
+	tape.clear();
+
+	ad::Number spot = tape.variable(in.underlying);
+	ad::Number strike = tape.variable(in.strike);
+	ad::Number rate = tape.variable(in.riskFreeRate);
+	ad::Number dividend = tape.variable(in.dividendYield);
+	ad::Number volatility = tape.variable(in.volatility);
+	ad::Number time = tape.variable(
+		in.dayCounter.yearFraction(settlementDate, in.maturity));
+	QL_REQUIRE(time.value() > 0.0, "option expired");
+
+	ad::Number npv = ad::BlackScholesPrice(
+		in.type == Option::Call ? 1.0 : -1.0,
+		spot, strike, rate, dividend, volatility, time);
+	tape.propagate(npv);
+
+	OptionSensitivities results;
+	results.npv = npv.value();
+	results.underlying = tape.adjoint(spot);
+	results.strike = tape.adjoint(strike);
+	results.riskFreeRate = tape.adjoint(rate);
+	results.dividendYield = tape.adjoint(dividend);
+	results.volatility = tape.adjoint(volatility);
+	results.maturity = tape.adjoint(time);
+	return results;
+}
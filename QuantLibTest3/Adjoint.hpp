@@ -0,0 +1,214 @@
+/* -*- mode: c++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+// QuantLib Black-Scholes-Merton test - adjoint algorithmic differentiation
+
+#ifndef quantlibtest3_adjoint_hpp
+#define quantlibtest3_adjoint_hpp
+
+#include "OptionInputs.hpp"
+
+#include <vector>
+
+namespace ad {
+
+	class Number;
+
+	/** Records the operations of a calculation on Numbers so that one
+	reverse pass gives the derivatives of its result with respect to
+	every input.
+
+	Each operation appends a node holding the indices of its (at most
+	two) operands and its partial derivatives with respect to them, so
+	the forward pass costs a store of a few words per operation and the
+	reverse pass one multiply-add per operand. Node 0 stands for every
+	constant: derivatives flowing into it are discarded.
+
+	clear() empties the tape but keeps its memory, so a tape reused for
+	one calculation after another allocates only while it grows. A tape
+	is used by one thread at a time.
+	*/
+	class Tape
+	{
+
+	public:
+
+		Tape();
+
+		// Forget every node but keep the memory
+		void clear();
+
+		// A new input with the given value
+		Number variable(QuantLib::Real value);
+
+		// Append an operation and return its node
+		QuantLib::Size record(QuantLib::Size first,
+			QuantLib::Real firstPartial,
+			QuantLib::Size second = 0,
+			QuantLib::Real secondPartial = 0.0);
+
+		// Reverse pass: the derivatives of result with respect to every
+		// node recorded so far, read back with adjoint()
+		void propagate(const Number & result);
+
+		// d result / d x after propagate()
+		QuantLib::Real adjoint(const Number & x) const;
+
+		QuantLib::Size size() const { return nodes_.size(); }
+
+	private:
+
+		struct Node {
+			QuantLib::Size first, second;
+			QuantLib::Real firstPartial, secondPartial;
+		};
+
+		std::vector<Node> nodes_;
+		std::vector<QuantLib::Real> adjoints_;
+
+	};
+
+	/* A value taking part in a taped calculation. Numbers built from a
+	Real are constants and don't touch any tape; operations on
+	variables record themselves on the tape of their operands.
+	*/
+	class Number
+	{
+
+	public:
+
+		Number(QuantLib::Real value = 0.0) :
+			value_(value),
+			node_(0),
+			tape_(0)
+		{
+		}
+
+		Number(QuantLib::Real value,
+			QuantLib::Size node,
+			Tape * tape) :
+			value_(value),
+			node_(node),
+			tape_(tape)
+		{
+		}
+
+		QuantLib::Real value() const { return value_; }
+		QuantLib::Size node() const { return node_; }
+		Tape * tape() const { return tape_; }
+
+	private:
+
+		QuantLib::Real value_;
+		QuantLib::Size node_;
+		Tape * tape_;
+
+	};
+
+	// Result of a unary operation with the given value and derivative
+	inline Number Unary(const Number & x,
+		QuantLib::Real value,
+		QuantLib::Real partial)
+	{
+		if (!x.tape())
+			return Number(value);
+		return Number(value, x.tape()->record(x.node(), partial), x.tape());
+	}
+
+	// Result of a binary operation with the given value and derivatives
+	inline Number Binary(const Number & x,
+		const Number & y,
+		QuantLib::Real value,
+		QuantLib::Real xPartial,
+		QuantLib::Real yPartial)
+	{
+		Tape * tape = x.tape() ? x.tape() : y.tape();
+		if (!tape)
+			return Number(value);
+		return Number(value,
+			tape->record(x.node(), xPartial, y.node(), yPartial),
+			tape);
+	}
+
+	inline Number operator-(const Number & x)
+	{
+		return Unary(x, -x.value(), -1.0);
+	}
+
+	inline Number operator+(const Number & x, const Number & y)
+	{
+		return Binary(x, y, x.value() + y.value(), 1.0, 1.0);
+	}
+
+	inline Number operator-(const Number & x, const Number & y)
+	{
+		return Binary(x, y, x.value() - y.value(), 1.0, -1.0);
+	}
+
+	inline Number operator*(const Number & x, const Number & y)
+	{
+		return Binary(x, y, x.value() * y.value(), y.value(), x.value());
+	}
+
+	inline Number operator/(const Number & x, const Number & y)
+	{
+		QuantLib::Real inverse = 1.0 / y.value();
+		QuantLib::Real value = x.value() * inverse;
+		return Binary(x, y, value, inverse, -value * inverse);
+	}
+
+	Number Exp(const Number & x);
+	Number Log(const Number & x);
+	Number Sqrt(const Number & x);
+	Number NormalCdf(const Number & x);
+
+	// The same functions on plain Reals, so that templates on the
+	// number type compile for both
+	QuantLib::Real Exp(QuantLib::Real x);
+	QuantLib::Real Log(QuantLib::Real x);
+	QuantLib::Real Sqrt(QuantLib::Real x);
+	QuantLib::Real NormalCdf(QuantLib::Real x);
+
+	/* Black-Scholes price of a call (phi = 1) or put (phi = -1) on a
+	number type T, Real or Number, as AnalyticEuropeanEngine prices it
+	on flat continuously compounded curves and a constant volatility
+	*/
+	template <class T>
+	T BlackScholesPrice(QuantLib::Real phi,
+		const T & spot,
+		const T & strike,
+		const T & rate,
+		const T & dividend,
+		const T & volatility,
+		const T & time)
+	{
+		T stdDev = volatility * Sqrt(time);
+		T riskFreeDiscount = Exp(-(rate * time));
+		T forward = spot * Exp(-(dividend * time)) / riskFreeDiscount;
+		T d1 = Log(forward / strike) / stdDev + 0.5 * stdDev;
+		T d2 = d1 - stdDev;
+		return phi * riskFreeDiscount
+			* (forward * NormalCdf(phi * d1) - strike * NormalCdf(phi * d2));
+	}
+
+}
+
+// Price of an option and its derivatives with respect to every input
+struct OptionSensitivities {
+	QuantLib::Real npv;
+	QuantLib::Real underlying;
+	QuantLib::Real strike;
+	QuantLib::Real riskFreeRate;
+	QuantLib::Real dividendYield;
+	QuantLib::Real volatility;
+	QuantLib::Real maturity;     // per year of time to maturity
+};
+
+/* Black-Scholes price of the option and its sensitivities to all of
+its inputs from one taped forward pass and one reverse pass. The tape
+is cleared first and left holding the calculation.
+*/
+OptionSensitivities AdjointBlackScholes(const OptionInputs & in,
+	const QuantLib::Date & settlementDate,
+	ad::Tape & tape);
+
+#endif
@@ -0,0 +1,90 @@
+/* -*- mode: c++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+// QuantLib Black-Scholes-Merton test - heap allocation counts
+
+#include "AllocationCounter.hpp"
+
+#ifdef QLT3_COUNT_ALLOCATIONS
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+namespace {
+
+	std::atomic<std::size_t> allocations(0);
+	std::atomic<std::size_t> bytes(0);
+
+}
+
+void * operator new(std::size_t size)
+{
+	allocations.fetch_add(1, std::memory_order_relaxed);
+	bytes.fetch_add(size, std::memory_order_relaxed);
+
+	if (size == 0)
+		size = 1;
+	for (;;) {
+		if (void * p = std::malloc(size))
+			return p;
+		std::new_handler handler = std::set_new_handler(0);
+		std::set_new_handler(handler);
+		if (!handler)
+			throw std::bad_alloc();
+		handler();
+	}
+}
+
+void operator delete(void * p)
+{
+	std::free(p);
+}
+
+void * operator new[](std::size_t size)
+{
+	return ::operator new(size);
+}
+
+void operator delete[](void * p)
+{
+	::operator delete(p);
+}
+
+bool AllocationsCounted()
+{
+	return true;
+}
+
+AllocationCounts AllocationsSoFar()
+{
+	AllocationCounts counts;
+	counts.allocations = allocations.load(std::memory_order_relaxed);
+	counts.bytes = bytes.load(std::memory_order_relaxed);
+	return counts;
+}
+
+#else
+
+bool AllocationsCounted()
+{
+	return false;
+}
+
+AllocationCounts AllocationsSoFar()
+{
+	AllocationCounts counts;
+	counts.allocations = 0;
+	counts.bytes = 0;
+	return counts;
+}
+
+#endif
+
+AllocationCounts operator-(const AllocationCounts & later,
+	const AllocationCounts & earlier)
+{
+	AllocationCounts counts;
+	counts.allocations = later.allocations - earlier.allocations;
+	counts.bytes = later.bytes - earlier.bytes;
+	return counts;
+}
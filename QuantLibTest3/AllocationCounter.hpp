@@ -0,0 +1,41 @@
+/* -*- mode: c++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+// QuantLib Black-Scholes-Merton test - heap allocation counts
+
+#ifndef quantlibtest3_allocation_counter_hpp
+#define quantlibtest3_allocation_counter_hpp
+
+#include <ql/quantlib.hpp>
+
+/** Heap allocations through the global operator new.
+
+Built with QLT3_COUNT_ALLOCATIONS defined, AllocationCounter.cpp
+replaces the global operator new and delete for the whole program
+with malloc and free, counting every allocation and the bytes asked
+for on the way. The counters are relaxed atomics shared by every
+thread, so each allocation pays two atomic increments that contend
+across threads; that is why the replacement is off by default and
+meant for benchmark builds only (the QLT3_COUNT_ALLOCATIONS CMake
+option). Bytes freed are not tracked, so the difference of two
+counts is what was allocated in between, whether or not it has been
+freed since.
+
+Without the define the library's operator new is left alone and
+every count is zero.
+*/
+struct AllocationCounts {
+	QuantLib::Size allocations;
+	QuantLib::Size bytes;
+};
+
+// Whether this build counts allocations
+bool AllocationsCounted();
+
+// Allocations since the program started
+AllocationCounts AllocationsSoFar();
+
+// Allocations between two counts
+AllocationCounts operator-(const AllocationCounts & later,
+	const AllocationCounts & earlier);
+
+#endif
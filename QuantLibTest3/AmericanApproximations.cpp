@@ -0,0 +1,334 @@
+/* -*- mode: c++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+// QuantLib Black-Scholes-Merton test - analytic American approximations
+
+#include "AmericanApproximations.hpp"
+#include "FastMath.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace QuantLib;
+
+namespace {
+
+	typedef simd::Scalar S;
+
+	inline Real Exp(Real x) { return simd::Exp<S>(x); }
+	inline Real Log(Real x) { return simd::Log<S>(x); }
+	inline Real Cdf(Real x) { return simd::NormalCdf<S>(x); }
+	inline Real Pdf(Real x) { return simd::NormalPdf<S>(x); }
+	inline Real Power(Real x, Real y) { return Exp(y * Log(x)); }
+
+	// Critical price iterations stop at this relative accuracy
+	const Real accuracy = 1.0e-6;
+	const Size maxIterations = 100;
+
+	// One option, with its discount factors and total variance
+	struct Market {
+		Real phi, spot, strike;
+		Rate r, q;
+		Real variance, stdDev;
+		DiscountFactor riskFreeDiscount, dividendDiscount;
+
+		Market(const OptionArrays & in, Size i) :
+			phi(in.phi[i]),
+			spot(in.spot[i]),
+			strike(in.strike[i]),
+			r(in.rate[i]),
+			q(in.dividend[i])
+		{
+			Real vol = in.volatility[i];
+			Time t = in.time[i];
+			variance = vol * vol * t;
+			stdDev = std::sqrt(variance);
+			riskFreeDiscount = Exp(-r * t);
+			dividendDiscount = Exp(-q * t);
+		}
+
+		// The same option with spot and strike, rate and dividend
+		// yield swapped, and the other type: C(S, K, r, q) = P(K, S, q, r)
+		Market symmetric() const
+		{
+			Market m(*this);
+			m.phi = -phi;
+			std::swap(m.spot, m.strike);
+			std::swap(m.r, m.q);
+			std::swap(m.riskFreeDiscount, m.dividendDiscount);
+			return m;
+		}
+
+		Real intrinsic(Real s) const
+		{
+			return std::max(phi * (s - strike), 0.0);
+		}
+
+		// Black-Scholes price at spot s
+		Real european(Real s) const
+		{
+			Real forward = s * dividendDiscount / riskFreeDiscount;
+			Real d1 = Log(forward / strike) / stdDev + 0.5 * stdDev;
+			Real d2 = d1 - stdDev;
+			return riskFreeDiscount * phi
+				* (forward * Cdf(phi * d1) - strike * Cdf(phi * d2));
+		}
+
+		Real d1(Real s) const
+		{
+			return Log(s * dividendDiscount / (strike * riskFreeDiscount)) / stdDev
+				+ 0.5 * stdDev;
+		}
+
+		// Options that are never worth exercising early
+		bool europeanOnly() const
+		{
+			return phi > 0.0 ? q <= 0.0 : r <= 0.0;
+		}
+	};
+
+	/* Critical price of Barone-Adesi and Whaley, with the seed and
+	fixed-point iteration of BaroneAdesiWhaleyApproximationEngine
+	*/
+	Real BaroneAdesiWhaleyCriticalPrice(const Market & m,
+		Real Q)
+	{
+		const Real K = m.strike, phi = m.phi;
+		const Real bT = Log(m.dividendDiscount / m.riskFreeDiscount);
+		const Real n = 2.0 * bT / m.variance;
+		const Real mm = -2.0 * Log(m.riskFreeDiscount) / m.variance;
+		const Real qInfinity = 0.5 * (-(n - 1.0)
+			+ phi * std::sqrt((n - 1.0) * (n - 1.0) + 4.0 * mm));
+		const Real Su = K / (1.0 - 1.0 / qInfinity);
+
+		Real Si;
+		if (phi > 0.0) {
+			Real h = -(bT + 2.0 * m.stdDev) * K / (Su - K);
+			Si = K + (Su - K) * (1.0 - Exp(h));
+		} else {
+			Real h = (bT - 2.0 * m.stdDev) * K / (K - Su);
+			Si = Su + (K - Su) * Exp(h);
+		}
+
+		for (Size i = 0; i < maxIterations; ++i) {
+			Real d1 = m.d1(Si);
+			Real nd1 = Cdf(phi * d1);
+			Real rhs = m.european(Si)
+				+ phi * (1.0 - m.dividendDiscount * nd1) * Si / Q;
+			Real lhs = phi * (Si - K);
+			if (std::fabs(lhs - rhs) / K <= accuracy)
+				break;
+			Real bi = phi * m.dividendDiscount * nd1 * (1.0 - 1.0 / Q)
+				+ phi * (1.0 - phi * m.dividendDiscount * Pdf(d1) / m.stdDev) / Q;
+			Si = (phi * K + rhs - bi * Si) / (phi - bi);
+		}
+		return Si;
+	}
+
+	Real BaroneAdesiWhaleyPrice(const Market & m)
+	{
+		const Real bT = Log(m.dividendDiscount / m.riskFreeDiscount);
+		const Real n = 2.0 * bT / m.variance;
+		const Real oneMinusDiscount = 1.0 - m.riskFreeDiscount;
+		const Real k = oneMinusDiscount > 1.0e-12
+			? -2.0 * Log(m.riskFreeDiscount) / (m.variance * oneMinusDiscount)
+			: 2.0 / m.variance;
+		const Real Q = 0.5 * (-(n - 1.0)
+			+ m.phi * std::sqrt((n - 1.0) * (n - 1.0) + 4.0 * k));
+
+		const Real Sk = BaroneAdesiWhaleyCriticalPrice(m, Q);
+		if (m.phi * (m.spot - Sk) >= 0.0)
+			return m.intrinsic(m.spot);
+
+		Real A = m.phi * Sk * (1.0 - m.dividendDiscount * Cdf(m.phi * m.d1(Sk))) / Q;
+		return m.european(m.spot) + A * Power(m.spot / Sk, Q);
+	}
+
+	// phi(S, T, gamma, H, I) of Bjerksund and Stensland (1993)
+	Real BjerksundStenslandPhi(const Market & m,
+		Real s,
+		Real gamma,
+		Real H,
+		Real I)
+	{
+		const Real rT = -Log(m.riskFreeDiscount);
+		const Real bT = Log(m.dividendDiscount / m.riskFreeDiscount);
+		Real lambda = -rT + gamma * bT + 0.5 * gamma * (gamma - 1.0) * m.variance;
+		Real d = -(Log(s / H) + (bT + (gamma - 0.5) * m.variance)) / m.stdDev;
+		Real kappa = 2.0 * bT / m.variance + (2.0 * gamma - 1.0);
+		return Exp(lambda) * Power(s, gamma) * (Cdf(d)
+			- Power(I / s, kappa) * Cdf(d - 2.0 * Log(I / s) / m.stdDev));
+	}
+
+	Real BjerksundStenslandCall(const Market & m)
+	{
+		const Real S = m.spot, X = m.strike;
+		const Real rT = -Log(m.riskFreeDiscount);
+		const Real bT = Log(m.dividendDiscount / m.riskFreeDiscount);
+
+		Real a = bT / m.variance - 0.5;
+		Real beta = -a + std::sqrt(a * a + 2.0 * rT / m.variance);
+		Real BInfinity = beta / (beta - 1.0) * X;
+		Real B0 = std::max(X, rT / (rT - bT) * X);
+		Real ht = -(bT + 2.0 * m.stdDev) * B0 / (BInfinity - B0);
+		Real I = B0 + (BInfinity - B0) * (1.0 - Exp(ht));
+
+		if (S >= I)
+			return S - X;
+
+		Real alpha = (I - X) * Power(I, -beta);
+		return alpha * Power(S, beta)
+			- alpha * BjerksundStenslandPhi(m, S, beta, I, I)
+			+ BjerksundStenslandPhi(m, S, 1.0, I, I)
+			- BjerksundStenslandPhi(m, S, 1.0, X, I)
+			- X * BjerksundStenslandPhi(m, S, 0.0, I, I)
+			+ X * BjerksundStenslandPhi(m, S, 0.0, X, I);
+	}
+
+	Real BjerksundStenslandPrice(const Market & m)
+	{
+		Real american = m.phi > 0.0
+			? BjerksundStenslandCall(m)
+			: BjerksundStenslandCall(m.symmetric());
+		return std::max(american, m.european(m.spot));
+	}
+
+	/* QD+ terms of a put at boundary B: the Black-Scholes price and
+	delta there, the premium exponent lambda and Li's correction c0
+	*/
+	struct QdPlusTerms {
+		Real price, delta, lambda, c0;
+	};
+
+	QdPlusTerms QdPlusAt(const Market & m,
+		Real B,
+		Real t,
+		Real h,
+		Real alpha,
+		Real beta,
+		Real lambda,
+		Real lambdaPrime)
+	{
+		const Real K = m.strike;
+		Real d1 = m.d1(B), d2 = d1 - m.stdDev;
+		Real nd1 = Cdf(-d1);
+
+		QdPlusTerms x;
+		x.price = m.riskFreeDiscount * K * Cdf(-d2) - m.dividendDiscount * B * nd1;
+		x.delta = -m.dividendDiscount * nd1;
+		x.lambda = lambda;
+
+		// Black-Scholes theta of the put at the boundary
+		Real theta = m.r * K * m.riskFreeDiscount * Cdf(-d2)
+			- m.q * B * m.dividendDiscount * nd1
+			- 0.5 * m.stdDev / t * B * m.dividendDiscount * Pdf(d1);
+
+		Real premium = K - B - x.price;
+		Real denominator = 2.0 * lambda + beta - 1.0;
+		x.c0 = -(1.0 - h) * alpha / denominator
+			* (1.0 / h - theta / (m.r * m.riskFreeDiscount * premium)
+			+ lambdaPrime / denominator);
+		return x;
+	}
+
+	Real QdPlusPut(const Market & m,
+		Real t)
+	{
+		const Real K = m.strike, S = m.spot;
+		const Real vol2 = m.variance / t;
+		const Real h = 1.0 - m.riskFreeDiscount;
+		const Real alpha = 2.0 * m.r / vol2;
+		const Real beta = 2.0 * (m.r - m.q) / vol2;
+		const Real root = std::sqrt((beta - 1.0) * (beta - 1.0) + 4.0 * alpha / h);
+		const Real lambda = 0.5 * (-(beta - 1.0) - root);
+		const Real lambdaPrime = alpha / (h * h * root);
+
+		// Seed as Barone-Adesi and Whaley, below the perpetual and
+		// short-dated limits of the boundary
+		const Real bT = (m.r - m.q) * t;
+		const Real qInfinity = 0.5 * (-(beta - 1.0)
+			- std::sqrt((beta - 1.0) * (beta - 1.0) + 4.0 * alpha));
+		const Real Su = K / (1.0 - 1.0 / qInfinity);
+		const Real upper = m.q > 0.0 ? K * std::min(1.0, m.r / m.q) : K;
+		Real B = Su + (K - Su) * Exp((bT - 2.0 * m.stdDev) * K / (K - Su));
+		B = std::min(B, upper * (1.0 - accuracy));
+
+		/* Newton on f(B) = (1 - e^(-qt) N(-d1)) B + (lambda + c0)(K - B - p)
+		with c0 held constant in the derivative
+		*/
+		QdPlusTerms x = QdPlusAt(m, B, t, h, alpha, beta, lambda, lambdaPrime);
+		for (Size i = 0; i < maxIterations; ++i) {
+			Real premium = K - B - x.price;
+			Real f = (1.0 + x.delta) * B + (lambda + x.c0) * premium;
+			Real d1 = m.d1(B);
+			Real df = (1.0 + x.delta)
+				+ m.dividendDiscount * Pdf(d1) / m.stdDev
+				- (lambda + x.c0) * (1.0 + x.delta);
+			Real next = B - f / df;
+			next = std::min(std::max(next, 0.5 * B), 0.5 * (B + upper));
+			bool converged = std::fabs(next - B) <= accuracy * K;
+			B = next;
+			x = QdPlusAt(m, B, t, h, alpha, beta, lambda, lambdaPrime);
+			if (converged)
+				break;
+		}
+
+		if (S <= B)
+			return K - S;
+
+		// Second order term of the premium's decay away from the
+		// boundary, which the critical price doesn't depend on
+		const Real b = 0.5 * (1.0 - h) * alpha * lambdaPrime
+			/ (2.0 * lambda + beta - 1.0);
+		Real logMoneyness = Log(S / B);
+		return m.european(S) + (K - B - x.price) * Power(S / B, lambda)
+			/ (1.0 - (b * logMoneyness + x.c0) * logMoneyness);
+	}
+
+	Real QdPlusPrice(const Market & m,
+		Real t)
+	{
+		Real american = m.phi < 0.0
+			? QdPlusPut(m, t)
+			: QdPlusPut(m.symmetric(), t);
+		return std::max(american, m.european(m.spot));
+	}
+
+}
+
+void AmericanApproximationKernel(const OptionArrays & in,
+	AmericanApproximation method,
+	Real * npvs)
+{
+	const Size n = in.size();
+	for (Size i = 0; i < n; ++i) {
+		if (in.expired[i] != 0.0) {
+			npvs[i] = 0.0;
+			continue;
+		}
+		Market m(in, i);
+
+		// No time value left: the payoff
+		if (m.stdDev < QL_EPSILON || in.time[i] <= 0.0) {
+			npvs[i] = m.intrinsic(m.spot);
+			continue;
+		}
+		if (m.europeanOnly()) {
+			npvs[i] = m.european(m.spot);
+			continue;
+		}
+
+		switch (method) {
+		case BaroneAdesiWhaley:
+			npvs[i] = BaroneAdesiWhaleyPrice(m);
+			break;
+		case BjerksundStensland:
+			npvs[i] = BjerksundStenslandPrice(m);
+			break;
+		case QdPlus:
+			npvs[i] = QdPlusPrice(m, in.time[i]);
+			break;
+		default:
+			QL_FAIL("unknown American approximation");
+		}
+	}
+}
@@ -0,0 +1,45 @@
+/* -*- mode: c++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+// QuantLib Black-Scholes-Merton test - analytic American approximations
+
+#ifndef quantlibtest3_american_approximations_hpp
+#define quantlibtest3_american_approximations_hpp
+
+#include "BlackScholesKernel.hpp"
+
+/** Closed-form and quasi-closed-form American prices.
+
+BaroneAdesiWhaley follows Barone-Adesi and Whaley (1987) as in
+QuantLib's BaroneAdesiWhaleyApproximationEngine: the early exercise
+premium is a power of the spot above (calls) or below (puts) a
+critical price found by iteration.
+
+BjerksundStensland is the flat exercise boundary of Bjerksund and
+Stensland (1993) as in BjerksundStenslandApproximationEngine, with
+puts priced as calls through put-call symmetry.
+
+QdPlus is Li's QD+ (2010): a Barone-Adesi-Whaley style premium with
+a correction for the time decay at the boundary, whose critical
+price solves a one-dimensional equation by Newton iteration. Calls
+go through put-call symmetry.
+
+Calls on assets without dividends and puts at non-positive rates
+are never exercised early and get the Black-Scholes price.
+*/
+enum AmericanApproximation {
+	BaroneAdesiWhaley,
+	BjerksundStensland,
+	QdPlus
+};
+
+/* American prices by the given approximation for every option in the
+arrays, written to npvs[0..size). The arrays are the shared setup:
+no QuantLib objects are built, and the normal distribution, exp and
+log are those of the SoA kernel. Expired options price at 0 and
+those at time 0 at their payoff, as in the closed-form kernels.
+*/
+void AmericanApproximationKernel(const OptionArrays & in,
+	AmericanApproximation method,
+	QuantLib::Real * npvs);
+
+#endif
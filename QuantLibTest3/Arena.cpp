@@ -0,0 +1,79 @@
+/* -*- mode: c++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+// QuantLib Black-Scholes-Merton test - bump arena for pricing objects
+
+#include "Arena.hpp"
+
+#include <algorithm>
+
+using namespace QuantLib;
+
+Arena::Arena(Size blockSize) :
+	blockSize_(blockSize),
+	current_(0),
+	offset_(0),
+	live_(0)
+{
+	QL_REQUIRE(blockSize > 0, "arena blocks must not be empty");
+}
+
+Arena::~Arena()
+{
+	for (Size i = 0; i < blocks_.size(); ++i)
+		delete[] blocks_[i].data;
+}
+
+void * Arena::allocate(Size bytes,
+	Size alignment)
+{
+	for (;;) {
+		if (current_ < blocks_.size()) {
+			const Block & block = blocks_[current_];
+			std::size_t address = reinterpret_cast<std::size_t>(block.data) + offset_;
+			Size start = offset_ + (alignment - address % alignment) % alignment;
+			if (start + bytes <= block.size) {
+				offset_ = start + bytes;
+				++live_;
+				return block.data + start;
+			}
+			// Try the next block, if a previous round left one
+			if (current_ + 1 < blocks_.size()) {
+				++current_;
+				offset_ = 0;
+				continue;
+			}
+		}
+		// operator new[] aligns for any fundamental type; requests
+		// larger than a block get a block of their own
+		Block block;
+		block.size = std::max(blockSize_, bytes + alignment);
+		block.data = new char[block.size];
+		blocks_.push_back(block);
+		current_ = blocks_.size() - 1;
+		offset_ = 0;
+	}
+}
+
+void Arena::release()
+{
+	QL_REQUIRE(live_ == 0,
+		live_ << " arena allocations still live on release");
+	current_ = 0;
+	offset_ = 0;
+}
+
+Size Arena::bytesUsed() const
+{
+	Size used = offset_;
+	for (Size i = 0; i < current_ && i < blocks_.size(); ++i)
+		used += blocks_[i].size;
+	return used;
+}
+
+Size Arena::bytesReserved() const
+{
+	Size reserved = 0;
+	for (Size i = 0; i < blocks_.size(); ++i)
+		reserved += blocks_[i].size;
+	return reserved;
+}
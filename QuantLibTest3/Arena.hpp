@@ -0,0 +1,142 @@
+/* -*- mode: c++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+// QuantLib Black-Scholes-Merton test - bump arena for pricing objects
+
+#ifndef quantlibtest3_arena_hpp
+#define quantlibtest3_arena_hpp
+
+#include <ql/quantlib.hpp>
+#include <boost/make_shared.hpp>
+#include <cstddef>
+#include <type_traits>
+#include <vector>
+
+/** A bump allocator handing out memory from a list of blocks.
+
+Allocating moves an offset through the current block, going on to
+the next block, or a new one, when it is full; deallocating does
+nothing but count. release() hands back everything at once by
+rewinding to the first block, keeping the blocks for the next round,
+and requires everything allocated since the last release to have
+been deallocated, so that objects are never left on memory about to
+be reused.
+
+An arena is not thread safe; use one per thread.
+*/
+class Arena
+{
+
+public:
+
+	explicit Arena(QuantLib::Size blockSize = 65536);
+	~Arena();
+
+	void * allocate(QuantLib::Size bytes,
+		QuantLib::Size alignment = sizeof(double));
+	void deallocate(void *) { --live_; }
+
+	// Rewind to the first block; nothing may be live
+	void release();
+
+	// Allocations not yet deallocated
+	QuantLib::Size live() const { return live_; }
+
+	// Bytes handed out since the last release, and held in blocks
+	QuantLib::Size bytesUsed() const;
+	QuantLib::Size bytesReserved() const;
+
+private:
+
+	Arena(const Arena &);
+	Arena & operator=(const Arena &);
+
+	struct Block {
+		char * data;
+		QuantLib::Size size;
+	};
+
+	QuantLib::Size blockSize_;
+	std::vector<Block> blocks_;
+	QuantLib::Size current_;
+	QuantLib::Size offset_;
+	QuantLib::Size live_;
+
+};
+
+/* An allocator on an arena, for boost::allocate_shared() and the
+standard containers. Copies and rebinds share the arena, which must
+outlive everything allocated through them.
+*/
+template <class T>
+class ArenaAllocator
+{
+
+public:
+
+	typedef T value_type;
+	typedef T * pointer;
+	typedef const T * const_pointer;
+	typedef T & reference;
+	typedef const T & const_reference;
+	typedef std::size_t size_type;
+	typedef std::ptrdiff_t difference_type;
+
+	template <class U>
+	struct rebind {
+		typedef ArenaAllocator<U> other;
+	};
+
+	explicit ArenaAllocator(Arena & arena) : arena_(&arena) {}
+
+	template <class U>
+	ArenaAllocator(const ArenaAllocator<U> & other) : arena_(other.arena()) {}
+
+	T * allocate(size_type n, const void * = 0)
+	{
+		return static_cast<T *>(arena_->allocate(n * sizeof(T),
+			std::alignment_of<T>::value));
+	}
+
+	void deallocate(T * p, size_type) { arena_->deallocate(p); }
+
+	template <class U, class... Args>
+	void construct(U * p, Args&&... args)
+	{
+		::new(static_cast<void *>(p)) U(std::forward<Args>(args)...);
+	}
+
+	template <class U>
+	void destroy(U * p) { p->~U(); }
+
+	size_type max_size() const { return size_type(-1) / sizeof(T); }
+
+	Arena * arena() const { return arena_; }
+
+private:
+
+	Arena * arena_;
+
+};
+
+template <class T, class U>
+bool operator==(const ArenaAllocator<T> & a, const ArenaAllocator<U> & b)
+{
+	return a.arena() == b.arena();
+}
+
+template <class T, class U>
+bool operator!=(const ArenaAllocator<T> & a, const ArenaAllocator<U> & b)
+{
+	return a.arena() != b.arena();
+}
+
+// A T and its shared_ptr control block in one allocation from the
+// arena; the T is destroyed as usual when its last reference goes
+template <class T, class... Args>
+boost::shared_ptr<T> ArenaNew(Arena & arena, Args&&... args)
+{
+	return boost::allocate_shared<T>(ArenaAllocator<T>(arena),
+		std::forward<Args>(args)...);
+}
+
+#endif
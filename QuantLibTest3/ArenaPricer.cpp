@@ -0,0 +1,68 @@
+/* -*- mode: c++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+// QuantLib Black-Scholes-Merton test - arena-backed per-option pricing
+
+#include "ArenaPricer.hpp"
+
+using namespace QuantLib;
+
+ArenaPricer::ArenaPricer(const Date & settlementDate,
+	const Calendar & calendar,
+	bool useArena) :
+	settlementDate_(settlementDate),
+	calendar_(calendar),
+	useArena_(useArena),
+	arena_(16384)
+{
+}
+
+template <class T, class... Args>
+boost::shared_ptr<T> ArenaPricer::make(Args&&... args)
+{
+	if (useArena_)
+		return ArenaNew<T>(arena_, std::forward<Args>(args)...);
+	return boost::shared_ptr<T>(new T(std::forward<Args>(args)...));
+}
+
+Real ArenaPricer::price(const OptionInputs & in)
+{
+	Real npv;
+	{
+		boost::shared_ptr<Exercise> exercise =
+			make<EuropeanExercise>(in.maturity);
+
+		Handle<Quote> underlyingH(make<SimpleQuote>(in.underlying));
+
+		Handle<YieldTermStructure> flatTermStructure(
+			make<FlatForward>(settlementDate_, in.riskFreeRate, in.dayCounter));
+		Handle<YieldTermStructure> flatDividendTS(
+			make<FlatForward>(settlementDate_, in.dividendYield, in.dayCounter));
+		Handle<BlackVolTermStructure> flatVolTS(
+			make<BlackConstantVol>(settlementDate_, calendar_, in.volatility,
+			in.dayCounter));
+
+		boost::shared_ptr<StrikedTypePayoff> payoff =
+			make<PlainVanillaPayoff>(in.type, in.strike);
+
+		boost::shared_ptr<BlackScholesMertonProcess> process =
+			make<BlackScholesMertonProcess>(underlyingH, flatDividendTS,
+			flatTermStructure, flatVolTS);
+
+		VanillaOption option(payoff, exercise);
+		option.setPricingEngine(make<AnalyticEuropeanEngine>(process));
+		npv = option.NPV();
+	}
+
+	// Everything made above is gone with the scope
+	if (useArena_)
+		arena_.release();
+	return npv;
+}
+
+void ArenaPricer::price(const OptionInputs * inputs,
+	Size n,
+	Real * npvs)
+{
+	for (Size i = 0; i < n; ++i)
+		npvs[i] = price(inputs[i]);
+}
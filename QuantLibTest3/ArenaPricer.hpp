@@ -0,0 +1,57 @@
+/* -*- mode: c++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+// QuantLib Black-Scholes-Merton test - arena-backed per-option pricing
+
+#ifndef quantlibtest3_arena_pricer_hpp
+#define quantlibtest3_arena_pricer_hpp
+
+#include "OptionInputs.hpp"
+#include "Arena.hpp"
+
+/** Prices options one at a time the way EquityOption() does.
+
+Every option gets its own exercise, quote, dividend and risk-free
+curves, volatility, payoff, process and AnalyticEuropeanEngine, and
+is priced through a VanillaOption. In arena mode those eight objects
+and their shared_ptr control blocks come out of the pricer's arena,
+one allocation each, and the arena is released once the option is
+priced, so the same few kilobytes are reused by every option. In
+heap mode they are built with new as EquityOption() builds them, for
+comparison.
+
+The observer lists QuantLib keeps inside the objects still allocate
+from the heap, as does the VanillaOption's registration with the
+evaluation date. A pricer is not thread safe; give each thread its
+own, and so its own arena.
+*/
+class ArenaPricer
+{
+
+public:
+
+	ArenaPricer(const QuantLib::Date & settlementDate,
+		const QuantLib::Calendar & calendar,
+		bool useArena = true);
+
+	// Price n options from inputs into npvs[0..n)
+	void price(const OptionInputs * inputs,
+		QuantLib::Size n,
+		QuantLib::Real * npvs);
+
+	QuantLib::Real price(const OptionInputs & in);
+
+	const Arena & arena() const { return arena_; }
+
+private:
+
+	template <class T, class... Args>
+	boost::shared_ptr<T> make(Args&&... args);
+
+	QuantLib::Date settlementDate_;
+	QuantLib::Calendar calendar_;
+	bool useArena_;
+	Arena arena_;
+
+};
+
+#endif
@@ -0,0 +1,113 @@
+/* -*- mode: c++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+// QuantLib Black-Scholes-Merton test - batch pricing
+
+#include "BatchPricer.hpp"
+
+using namespace QuantLib;
+
+boost::shared_ptr<BlackScholesMertonProcess> MakeProcess(
+	const Handle<Quote> & underlying,
+	const OptionInputs & in,
+	const Date & settlementDate,
+	const Calendar & calendar)
+{
+	Handle<YieldTermStructure> flatTermStructure(
+		boost::shared_ptr<YieldTermStructure>(
+		new FlatForward(settlementDate,
+		in.riskFreeRate,
+		in.dayCounter)));
+
+	Handle<YieldTermStructure> flatDividendTS(
+		boost::shared_ptr<YieldTermStructure>(
+		new FlatForward(settlementDate,
+		in.dividendYield,
+		in.dayCounter)));
+
+	Handle<BlackVolTermStructure> flatVolTS(
+		boost::shared_ptr<BlackVolTermStructure>(
+		new BlackConstantVol(settlementDate,
+		calendar,
+		in.volatility,
+		in.dayCounter)));
+
+	return boost::shared_ptr<BlackScholesMertonProcess>(
+		new BlackScholesMertonProcess(underlying,
+		flatDividendTS,
+		flatTermStructure,
+		flatVolTS));
+}
+
+BatchPricer::BatchPricer(const Date & settlementDate,
+	const Calendar & calendar,
+	Size maxMarkets) :
+	settlementDate_(settlementDate),
+	calendar_(calendar),
+	cache_(settlementDate, calendar, maxMarkets),
+	hasMarket_(false),
+	arguments_(0),
+	results_(0)
+{
+}
+
+// True if the option can reuse the current process and engine
+bool BatchPricer::sameMarket(const OptionInputs & in) const
+{
+	return hasMarket_
+		&& in.underlying == market_.underlying
+		&& in.dividendYield == market_.dividendYield
+		&& in.riskFreeRate == market_.riskFreeRate
+		&& in.volatility == market_.volatility
+		&& in.dayCounter == market_.dayCounter;
+}
+
+// Take the process and engine of a market from the cache, building
+// them the first time the market is seen
+void BatchPricer::switchMarket(const OptionInputs & in)
+{
+	process_ = cache_.process(in);
+	engine_ = cache_.analyticEngine(in);
+
+	arguments_ = dynamic_cast<VanillaOption::arguments *>(
+		engine_->getArguments());
+	results_ = dynamic_cast<const VanillaOption::results *>(
+		engine_->getResults());
+	QL_ENSURE(arguments_ != 0 && results_ != 0,
+		"engine does not price vanilla options");
+
+	market_ = in;
+	hasMarket_ = true;
+}
+
+void BatchPricer::price(const OptionInputs * inputs,
+	Size n,
+	Real * npvs)
+{
+	const Date today = Settings::instance().evaluationDate();
+
+	for (Size i = 0; i < n; ++i) {
+
+		const OptionInputs & in = inputs[i];
+
+		// Expired options are worth nothing, as for Instrument::NPV()
+		if (in.maturity <= today) {
+			npvs[i] = 0.0;
+			continue;
+		}
+
+		if (!sameMarket(in))
+			switchMarket(in);
+
+		// Only the payoff and exercise are specific to the option
+		engine_->reset();
+		arguments_->exercise = boost::shared_ptr<Exercise>(
+			new EuropeanExercise(in.maturity));
+		arguments_->payoff = boost::shared_ptr<Payoff>(
+			new PlainVanillaPayoff(in.type,
+			in.strike));
+		arguments_->validate();
+		engine_->calculate();
+
+		npvs[i] = results_->value;
+	}
+}
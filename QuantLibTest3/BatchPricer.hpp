@@ -0,0 +1,78 @@
+/* -*- mode: c++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+// QuantLib Black-Scholes-Merton test - batch pricing
+
+#ifndef quantlibtest3_batch_pricer_hpp
+#define quantlibtest3_batch_pricer_hpp
+
+#include "OptionInputs.hpp"
+#include "MarketCache.hpp"
+
+// The Black-Scholes-Merton process of EquityOption() for the market of
+// an option, driven by the given underlying quote
+boost::shared_ptr<QuantLib::BlackScholesMertonProcess> MakeProcess(
+	const QuantLib::Handle<QuantLib::Quote> & underlying,
+	const OptionInputs & in,
+	const QuantLib::Date & settlementDate,
+	const QuantLib::Calendar & calendar);
+
+/** Prices many OptionInputs in one call.
+
+The process, term structures and engine are built once per market
+(underlying, dividend yield, risk-free rate, volatility and day
+counter) and interned in a MarketCache, so a book builds one
+Handle/shared_ptr graph per market rather than one per option
+whatever order its options come in. The cache keeps at most
+maxMarkets markets, so a pricer that lives through a stream or a
+server session on ever new markets stays bounded. Runs of options on
+the same market skip the cache lookup too.
+
+Options are priced by driving the engine directly, as Instrument
+does internally, without building a VanillaOption. This skips the
+instrument's registration with the global evaluation date, so
+pricers on different threads share no observable state.
+
+A BatchPricer is not thread safe; use one instance per thread.
+*/
+class BatchPricer
+{
+
+public:
+
+	BatchPricer(const QuantLib::Date & settlementDate,
+		const QuantLib::Calendar & calendar,
+		QuantLib::Size maxMarkets = 4096);
+
+	// Price n options from inputs into npvs[0..n)
+	void price(const OptionInputs * inputs,
+		QuantLib::Size n,
+		QuantLib::Real * npvs);
+
+	// Number of market setups built so far
+	QuantLib::Size marketsBuilt() const { return cache_.marketsBuilt(); }
+
+	// Process of the market of the last option priced
+	const boost::shared_ptr<QuantLib::BlackScholesMertonProcess> & process() const
+	{
+		return process_;
+	}
+
+private:
+
+	bool sameMarket(const OptionInputs & in) const;
+	void switchMarket(const OptionInputs & in);
+
+	QuantLib::Date settlementDate_;
+	QuantLib::Calendar calendar_;
+
+	MarketCache cache_;
+	OptionInputs market_;
+	bool hasMarket_;
+	boost::shared_ptr<QuantLib::BlackScholesMertonProcess> process_;
+	boost::shared_ptr<QuantLib::PricingEngine> engine_;
+	QuantLib::VanillaOption::arguments * arguments_;
+	const QuantLib::VanillaOption::results * results_;
+
+};
+
+#endif
@@ -0,0 +1,82 @@
+/* -*- mode: c++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+// QuantLib Black-Scholes-Merton test - latency benchmark harness
+
+#include "Benchmark.hpp"
+#include <algorithm>
+#include <iomanip>
+
+using namespace QuantLib;
+
+BenchmarkResult Summarize(const std::string & name,
+	Size items,
+	std::vector<Real> samples)
+{
+	QL_REQUIRE(!samples.empty(), "no samples for " << name);
+
+	std::sort(samples.begin(), samples.end());
+
+	BenchmarkResult result;
+	result.name = name;
+	result.items = items;
+	result.repetitions = samples.size();
+
+	Real sum = 0.0;
+	for (Size i = 0; i < samples.size(); ++i)
+		sum += samples[i];
+	result.mean = sum / samples.size();
+	// Nearest rank: the smallest sample with at least that share of
+	// the samples at or below it, so with fewer than 100 repetitions
+	// p99 is the slowest
+	const Size n = samples.size();
+	result.p50 = samples[(n + 1) / 2 - 1];
+	result.p99 = samples[(99 * n + 99) / 100 - 1];
+	result.max = samples.back();
+
+	return result;
+}
+
+void PrintBenchmarks(std::ostream & os,
+	const std::vector<BenchmarkResult> & results)
+{
+	Size widths[] = { 35, 10, 8, 12, 12, 12, 14 };
+
+	os << std::endl
+		<< std::setw(widths[0]) << std::left << "Benchmark (ns/item)"
+		<< std::setw(widths[1]) << std::left << "items"
+		<< std::setw(widths[2]) << std::left << "reps"
+		<< std::setw(widths[3]) << std::left << "p50"
+		<< std::setw(widths[4]) << std::left << "p99"
+		<< std::setw(widths[5]) << std::left << "max"
+		<< std::setw(widths[6]) << std::left << "items/s"
+		<< std::endl;
+
+	for (Size i = 0; i < results.size(); ++i) {
+		const BenchmarkResult & r = results[i];
+		os << std::setw(widths[0]) << std::left << r.name
+			<< std::setw(widths[1]) << std::left << r.items
+			<< std::setw(widths[2]) << std::left << r.repetitions
+			<< std::setw(widths[3]) << std::left << r.p50
+			<< std::setw(widths[4]) << std::left << r.p99
+			<< std::setw(widths[5]) << std::left << r.max
+			<< std::setw(widths[6]) << std::left << r.throughput()
+			<< std::endl;
+	}
+}
+
+void WriteBenchmarksCsv(std::ostream & os,
+	const std::vector<BenchmarkResult> & results)
+{
+	os << "name,items,repetitions,mean,p50,p99,max,throughput\n";
+	for (Size i = 0; i < results.size(); ++i) {
+		const BenchmarkResult & r = results[i];
+		os << '"' << r.name << "\","
+			<< r.items << ','
+			<< r.repetitions << ','
+			<< r.mean << ','
+			<< r.p50 << ','
+			<< r.p99 << ','
+			<< r.max << ','
+			<< r.throughput() << '\n';
+	}
+}
@@ -0,0 +1,125 @@
+/* -*- mode: c++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+// QuantLib Black-Scholes-Merton test - latency benchmark harness
+
+#ifndef quantlibtest3_benchmark_hpp
+#define quantlibtest3_benchmark_hpp
+
+#include <ql/quantlib.hpp>
+#include <chrono>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Wall-clock stopwatch
+class Stopwatch
+{
+
+public:
+
+	typedef std::chrono::steady_clock Clock;
+
+	Stopwatch() : start_(Clock::now()) {}
+
+	void restart() { start_ = Clock::now(); }
+
+	QuantLib::Real nanoseconds() const
+	{
+		return std::chrono::duration<QuantLib::Real, std::nano>(
+			Clock::now() - start_).count();
+	}
+
+	QuantLib::Real seconds() const { return nanoseconds() * 1.0e-9; }
+
+private:
+
+	Clock::time_point start_;
+
+};
+
+// Timing statistics of one benchmark, in nanoseconds per item; the
+// percentiles are nearest-rank
+struct BenchmarkResult {
+	std::string name;
+	QuantLib::Size items;
+	QuantLib::Size repetitions;
+	QuantLib::Real mean;
+	QuantLib::Real p50;
+	QuantLib::Real p99;
+	QuantLib::Real max;
+
+	// Items per second at the median
+	QuantLib::Real throughput() const { return 1.0e9 / p50; }
+};
+
+// Statistics of per-item timings, one sample per repetition
+BenchmarkResult Summarize(const std::string & name,
+	QuantLib::Size items,
+	std::vector<QuantLib::Real> samples);
+
+/** Runs and records wall-clock benchmarks.
+
+Each benchmark is run a number of times untimed to warm caches,
+branch predictors and allocators, then timed over the given number
+of repetitions. Every repetition processes the stated number of
+items and contributes one ns/item sample.
+*/
+class Benchmark
+{
+
+public:
+
+	Benchmark(QuantLib::Size warmup = 1,
+		QuantLib::Size repetitions = 10) :
+		warmup_(warmup),
+		repetitions_(repetitions)
+	{
+	}
+
+	// Results are returned by value: the recorded list grows with
+	// every run
+	template <class F>
+	BenchmarkResult run(const std::string & name,
+		QuantLib::Size items,
+		F f)
+	{
+		for (QuantLib::Size i = 0; i < warmup_; ++i)
+			f();
+
+		std::vector<QuantLib::Real> samples(repetitions_);
+		for (QuantLib::Size i = 0; i < repetitions_; ++i) {
+			Stopwatch watch;
+			f();
+			samples[i] = watch.nanoseconds() / items;
+		}
+
+		return record(Summarize(name, items, samples));
+	}
+
+	// Record statistics of samples taken elsewhere
+	BenchmarkResult record(const BenchmarkResult & result)
+	{
+		results_.push_back(result);
+		return results_.back();
+	}
+
+	const std::vector<BenchmarkResult> & results() const { return results_; }
+
+private:
+
+	QuantLib::Size warmup_;
+	QuantLib::Size repetitions_;
+	std::vector<BenchmarkResult> results_;
+
+};
+
+// Print the recorded benchmarks as a table
+void PrintBenchmarks(std::ostream & os,
+	const std::vector<BenchmarkResult> & results);
+
+// Write the recorded benchmarks as CSV, one row per benchmark, for
+// collection by scripts
+void WriteBenchmarksCsv(std::ostream & os,
+	const std::vector<BenchmarkResult> & results);
+
+#endif
@@ -0,0 +1,190 @@
+/* -*- mode: c++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+// QuantLib Black-Scholes-Merton test - structure-of-arrays closed-form kernel
+
+#include "BlackScholesKernel.hpp"
+#include "BlackScholesTerms.hpp"
+#include "YearFraction.hpp"
+
+using namespace QuantLib;
+
+void OptionArrays::resize(Size n)
+{
+	phi.resize(n);
+	spot.resize(n);
+	strike.resize(n);
+	rate.resize(n);
+	dividend.resize(n);
+	volatility.resize(n);
+	time.resize(n);
+	expired.resize(n);
+}
+
+void LoadOptionArrays(const OptionInputs * inputs,
+	Size n,
+	const Date & settlementDate,
+	OptionArrays & out)
+{
+	const Date today = Settings::instance().evaluationDate();
+
+	out.resize(n);
+	for (Size i = 0; i < n; ++i) {
+		const OptionInputs & in = inputs[i];
+		out.phi[i] = in.type == Option::Call ? 1.0 : -1.0;
+		out.spot[i] = in.underlying;
+		out.strike[i] = in.strike;
+		out.rate[i] = in.riskFreeRate;
+		out.dividend[i] = in.dividendYield;
+		out.volatility[i] = in.volatility;
+		out.expired[i] = in.maturity <= today ? 1.0 : 0.0;
+		QL_REQUIRE(in.maturity <= today || in.maturity >= settlementDate,
+			"option " << i << " matures on " << in.maturity
+			<< ", before the settlement date " << settlementDate);
+	}
+	if (n > 0)
+		YearFractionTable(settlementDate).yearFractions(inputs, n, &out.time[0]);
+}
+
+void OptionResults::resize(Size n)
+{
+	npv.resize(n);
+	delta.resize(n);
+	gamma.resize(n);
+	vega.resize(n);
+	theta.resize(n);
+	rho.resize(n);
+	dividendRho.resize(n);
+	vanna.resize(n);
+	volga.resize(n);
+}
+
+OptionResultColumns OptionResultColumns::offset(Size rows) const
+{
+	OptionResultColumns c = { npv + rows, delta + rows, gamma + rows,
+		vega + rows, theta + rows, rho + rows, dividendRho + rows,
+		vanna + rows, volga + rows };
+	return c;
+}
+
+OptionResultColumns OptionResults::columns(Size first)
+{
+	OptionResultColumns c = { &npv[first], &delta[first], &gamma[first],
+		&vega[first], &theta[first], &rho[first], &dividendRho[first],
+		&vanna[first], &volga[first] };
+	return c;
+}
+
+namespace {
+
+	// phi (S e^-qt N(phi d1) - K e^-rt N(phi d2))
+	template <class V>
+	inline typename V::reg VanillaValue(const BlackScholesTerms<V> & terms,
+		typename V::reg nd1,
+		typename V::reg nd2)
+	{
+		return V::mul(terms.phi, V::sub(V::mul(terms.discountedSpot, nd1),
+			V::mul(terms.discountedStrike, nd2)));
+	}
+
+	// Price V::width options starting at i
+	template <class V>
+	inline void BlackScholesBlock(const OptionArrays & in,
+		Size i,
+		Real * npvs)
+	{
+		BlackScholesTerms<V> terms(in, i, V::load(&in.phi[i]));
+		V::store(npvs + i, terms.unlessExpired(VanillaValue(terms,
+			terms.probability(terms.d1), terms.probability(terms.d2))));
+	}
+
+	// Price and greeks of V::width options starting at i
+	template <class V>
+	inline void BlackScholesGreeksBlock(const OptionArrays & in,
+		Size i,
+		const OptionResultColumns & out)
+	{
+		typedef typename V::reg reg;
+
+		BlackScholesTerms<V> terms(in, i, V::load(&in.phi[i]));
+		reg nd1 = terms.probability(terms.d1);
+		reg nd2 = terms.probability(terms.d2);
+		reg value = VanillaValue(terms, nd1, nd2);
+
+		reg zero = V::set1(0.0);
+		reg density = V::select(terms.degenerate, zero,
+			simd::NormalPdf<V>(terms.d1));
+		reg sqrtT = V::sqrt(terms.t);
+
+		reg delta = V::mul(V::mul(terms.phi, terms.dividendDiscount), nd1);
+		reg gamma = V::div(V::mul(terms.dividendDiscount, density),
+			V::mul(terms.spot, terms.stdDev));
+		reg vega = V::mul(V::mul(terms.discountedSpot, density), sqrtT);
+		reg rho = V::mul(V::mul(terms.phi, terms.discountedStrike),
+			V::mul(terms.t, nd2));
+		reg dividendRho = V::neg(V::mul(V::mul(terms.phi, terms.discountedSpot),
+			V::mul(terms.t, nd1)));
+
+		// From the Black-Scholes PDE, as BlackCalculator::theta
+		reg theta = V::mul(terms.r, value);
+		theta = V::sub(theta,
+			V::mul(V::sub(terms.r, terms.q), V::mul(terms.spot, delta)));
+		theta = V::sub(theta, V::mul(V::set1(0.5),
+			V::mul(V::mul(terms.vol, terms.vol),
+			V::mul(V::mul(terms.spot, terms.spot), gamma))));
+
+		reg vanna = V::neg(V::div(
+			V::mul(V::mul(terms.dividendDiscount, density), terms.d2), terms.vol));
+		reg volga = V::div(V::mul(vega, V::mul(terms.d1, terms.d2)), terms.vol);
+		vanna = V::select(terms.degenerate, zero, vanna);
+		volga = V::select(terms.degenerate, zero, volga);
+
+		V::store(out.npv + i, terms.unlessExpired(value));
+		V::store(out.delta + i, terms.unlessExpired(delta));
+		V::store(out.gamma + i, terms.unlessExpired(gamma));
+		V::store(out.vega + i, terms.unlessExpired(vega));
+		V::store(out.theta + i, terms.unlessExpired(theta));
+		V::store(out.rho + i, terms.unlessExpired(rho));
+		V::store(out.dividendRho + i, terms.unlessExpired(dividendRho));
+		V::store(out.vanna + i, terms.unlessExpired(vanna));
+		V::store(out.volga + i, terms.unlessExpired(volga));
+	}
+
+}
+
+void BlackScholesKernel(const OptionArrays & in,
+	Real * npvs)
+{
+	typedef simd::Native V;
+
+	const Size n = in.size();
+	Size i = 0;
+
+	for (; i + V::width <= n; i += V::width)
+		BlackScholesBlock<V>(in, i, npvs);
+
+	for (; i < n; ++i)
+		BlackScholesBlock<simd::Scalar>(in, i, npvs);
+}
+
+void BlackScholesGreeksKernel(const OptionArrays & in,
+	OptionResults & out)
+{
+	out.resize(in.size());
+	if (in.size() > 0)
+		BlackScholesGreeksKernel(in, out.columns());
+}
+
+void BlackScholesGreeksKernel(const OptionArrays & in,
+	const OptionResultColumns & out)
+{
+	typedef simd::Native V;
+
+	const Size n = in.size();
+	Size i = 0;
+
+	for (; i + V::width <= n; i += V::width)
+		BlackScholesGreeksBlock<V>(in, i, out);
+
+	for (; i < n; ++i)
+		BlackScholesGreeksBlock<simd::Scalar>(in, i, out);
+}
@@ -0,0 +1,108 @@
+/* -*- mode: c++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+// QuantLib Black-Scholes-Merton test - structure-of-arrays closed-form kernel
+
+#ifndef quantlibtest3_black_scholes_kernel_hpp
+#define quantlibtest3_black_scholes_kernel_hpp
+
+#include "OptionInputs.hpp"
+#include <vector>
+
+/** Option data laid out as one array per field.
+
+phi is +1 for calls and -1 for puts (the values of Option::Type);
+time is the year fraction from the settlement date to maturity
+under the option's day counter, which is the time the flat curves
+and the constant vol of EquityOption() use.
+
+expired is 1 for options maturing on or before the evaluation date
+and 0 for the others. Every kernel prices expired options at zero,
+as BatchPricer and Instrument::NPV() do; the others have time >= 0,
+and at time 0 are worth their payoff.
+*/
+struct OptionArrays {
+	std::vector<QuantLib::Real> phi;
+	std::vector<QuantLib::Real> spot;
+	std::vector<QuantLib::Real> strike;
+	std::vector<QuantLib::Rate> rate;
+	std::vector<QuantLib::Spread> dividend;
+	std::vector<QuantLib::Volatility> volatility;
+	std::vector<QuantLib::Time> time;
+	std::vector<QuantLib::Real> expired;
+
+	QuantLib::Size size() const { return spot.size(); }
+	void resize(QuantLib::Size n);
+};
+
+/* Destination of the price and greeks, one pointer per result in
+OptionResults order, so the kernel can write into storage it does
+not own, such as a memory-mapped results file.
+*/
+struct OptionResultColumns {
+	QuantLib::Real * npv;
+	QuantLib::Real * delta;
+	QuantLib::Real * gamma;
+	QuantLib::Real * vega;
+	QuantLib::Real * theta;
+	QuantLib::Real * rho;
+	QuantLib::Real * dividendRho;
+	QuantLib::Real * vanna;
+	QuantLib::Real * volga;
+
+	// The same columns from row rows on
+	OptionResultColumns offset(QuantLib::Size rows) const;
+};
+
+/** Price and greeks, one array per result.
+
+Theta is per year and, like rho, dividendRho and vega, follows the
+AnalyticEuropeanEngine conventions. Vanna is d(delta)/d(vol) and
+volga is d(vega)/d(vol).
+*/
+struct OptionResults {
+	std::vector<QuantLib::Real> npv;
+	std::vector<QuantLib::Real> delta;
+	std::vector<QuantLib::Real> gamma;
+	std::vector<QuantLib::Real> vega;
+	std::vector<QuantLib::Real> theta;
+	std::vector<QuantLib::Real> rho;
+	std::vector<QuantLib::Real> dividendRho;
+	std::vector<QuantLib::Real> vanna;
+	std::vector<QuantLib::Real> volga;
+
+	QuantLib::Size size() const { return npv.size(); }
+	void resize(QuantLib::Size n);
+
+	// Pointers to row first of every array
+	OptionResultColumns columns(QuantLib::Size first = 0);
+};
+
+// Scatter n OptionInputs into the arrays, their times from a
+// YearFractionTable and their expiry from the evaluation date.
+// Throws, as AnalyticEuropeanEngine does, for live options maturing
+// before the settlement date.
+void LoadOptionArrays(const OptionInputs * inputs,
+	QuantLib::Size n,
+	const QuantLib::Date & settlementDate,
+	OptionArrays & out);
+
+/* Black-Scholes-Merton prices for every option in the arrays,
+written to npvs[0..size). Uses the widest SIMD pack the build
+targets and no QuantLib objects; agrees with AnalyticEuropeanEngine
+to within 1e-12 on the same inputs. Expired options price at 0, as
+in BatchPricer; so do their greeks.
+*/
+void BlackScholesKernel(const OptionArrays & in,
+	QuantLib::Real * npvs);
+
+/* Price and every greek of OptionResults in a single pass, reusing
+d1, d2, N(d1), N(d2) and n(d1) across all of them.
+*/
+void BlackScholesGreeksKernel(const OptionArrays & in,
+	OptionResults & out);
+
+// The same, writing rows [0, in.size()) through out
+void BlackScholesGreeksKernel(const OptionArrays & in,
+	const OptionResultColumns & out);
+
+#endif
@@ -0,0 +1,83 @@
+/* -*- mode: c++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+// QuantLib Black-Scholes-Merton test - terms shared by the closed-form kernels
+
+#ifndef quantlibtest3_black_scholes_terms_hpp
+#define quantlibtest3_black_scholes_terms_hpp
+
+#include "BlackScholesKernel.hpp"
+#include "FastMath.hpp"
+
+/** Discounting, d1 and d2 of V::width options of the arrays starting
+at i, the part of the Black-Scholes-Merton formula every payoff and
+greek shares. phi is passed in rather than loaded, so kernels
+specialized on the option type give a constant the compiler folds.
+
+Expired options, those flagged in OptionArrays::expired, may have a
+negative time: it is taken as zero so the terms stay finite, and
+unlessExpired() zeroes what the kernels write for them.
+
+At zero variance, stdDev below QL_EPSILON, the option is on the
+intrinsic value of its forward: probability() gives 1 where the
+forward is in the money and 0 elsewhere in place of N(phi d).
+Everything is defined inline so that the terms live in registers.
+*/
+template <class V>
+struct BlackScholesTerms
+{
+	typedef typename V::reg reg;
+
+	reg phi, spot, r, q, vol, t;
+	reg riskFreeDiscount, dividendDiscount;
+	reg discountedSpot, discountedStrike;
+	reg stdDev, d1, d2;
+	reg exercised;
+	typename V::mask degenerate, expired;
+
+	BlackScholesTerms(const OptionArrays & in,
+		QuantLib::Size i,
+		reg optionPhi) :
+		phi(optionPhi)
+	{
+		spot = V::load(&in.spot[i]);
+		reg strike = V::load(&in.strike[i]);
+		r = V::load(&in.rate[i]);
+		q = V::load(&in.dividend[i]);
+		vol = V::load(&in.volatility[i]);
+		t = V::max(V::load(&in.time[i]), V::set1(0.0));
+		expired = V::gt(V::load(&in.expired[i]), V::set1(0.0));
+
+		riskFreeDiscount = simd::Exp<V>(V::neg(V::mul(r, t)));
+		dividendDiscount = simd::Exp<V>(V::neg(V::mul(q, t)));
+		discountedSpot = V::mul(spot, dividendDiscount);
+		discountedStrike = V::mul(strike, riskFreeDiscount);
+
+		stdDev = V::mul(vol, V::sqrt(t));
+		degenerate = V::lt(stdDev, V::set1(QL_EPSILON));
+		stdDev = V::max(stdDev, V::set1(QL_EPSILON));
+		reg zero = V::set1(0.0);
+		exercised = V::select(
+			V::gt(V::mul(phi, V::sub(discountedSpot, discountedStrike)), zero),
+			V::set1(1.0), zero);
+
+		reg logMoneyness = V::fmadd(V::sub(r, q), t,
+			simd::Log<V>(V::div(spot, strike)));
+		d1 = V::fmadd(stdDev, V::set1(0.5), V::div(logMoneyness, stdDev));
+		d2 = V::sub(d1, stdDev);
+	}
+
+	// N(phi d) for d = d1 or d2
+	reg probability(reg d) const
+	{
+		return V::select(degenerate, exercised,
+			simd::NormalCdf<V>(V::mul(phi, d)));
+	}
+
+	// x, or 0 for expired options
+	reg unlessExpired(reg x) const
+	{
+		return V::select(expired, V::set1(0.0), x);
+	}
+};
+
+#endif
@@ -0,0 +1,124 @@
+/* -*- mode: c++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+// QuantLib Black-Scholes-Merton test - command line
+
+#include "CommandLine.hpp"
+
+#include <cstdlib>
+
+using namespace QuantLib;
+
+namespace {
+
+	Size ParseCount(const std::string & option,
+		const std::string & value)
+	{
+		char * end;
+		long n = std::strtol(value.c_str(), &end, 10);
+		QL_REQUIRE(!value.empty() && *end == '\0' && n >= 0,
+			option << " expects a non-negative integer, not '" << value << "'");
+		return Size(n);
+	}
+
+}
+
+CommandLine::CommandLine() :
+	mode(BenchmarkSuite),
+	threads(0),
+	chunkSize(65536),
+	repetitions(10),
+	help(false)
+{
+}
+
+CommandLine ParseCommandLine(int argc,
+	char * argv[])
+{
+	CommandLine cl;
+
+	int i = 1;
+	if (i < argc && argv[i][0] != '-') {
+		std::string mode = argv[i++];
+		if (mode == "single")
+			cl.mode = CommandLine::Single;
+		else if (mode == "batch")
+			cl.mode = CommandLine::Batch;
+		else if (mode == "benchmark")
+			cl.mode = CommandLine::BenchmarkSuite;
+		else if (mode == "server")
+			cl.mode = CommandLine::Server;
+		else
+			QL_FAIL("unknown mode '" << mode << "'");
+	}
+
+	bool threadsGiven = false;
+	for (; i < argc; ++i) {
+		std::string option = argv[i];
+		if (option == "-h" || option == "--help") {
+			cl.help = true;
+			continue;
+		}
+
+		QL_REQUIRE(i + 1 < argc, option << " expects a value");
+		std::string value = argv[++i];
+
+		if (option == "-t" || option == "--threads") {
+			cl.threads = ParseCount(option, value);
+			threadsGiven = true;
+		}
+		else if (option == "-i" || option == "--input")
+			cl.input = value;
+		else if (option == "-o" || option == "--output")
+			cl.output = value;
+		else if (option == "--curve")
+			cl.curve = value;
+		else if (option == "--surface")
+			cl.surface = value;
+		else if (option == "--chunk")
+			cl.chunkSize = ParseCount(option, value);
+		else if (option == "--repetitions")
+			cl.repetitions = ParseCount(option, value);
+		else
+			QL_FAIL("unknown option '" << option << "'");
+	}
+
+	// Each option is answered as its line arrives, on one thread
+	QL_REQUIRE(!(threadsGiven && cl.mode == CommandLine::Server),
+		"--threads does not apply to server mode");
+	QL_REQUIRE(cl.chunkSize > 0, "--chunk must be positive");
+	QL_REQUIRE(cl.repetitions > 0, "--repetitions must be positive");
+
+	return cl;
+}
+
+void PrintUsage(std::ostream & os)
+{
+	os << "usage: QuantLibTest3 [single|batch|benchmark|server] [options]\n"
+		<< "\n"
+		<< "modes:\n"
+		<< "  single     price one option, the first of --input if given\n"
+		<< "  batch      price the --input portfolio into --output\n"
+		<< "  benchmark  run the benchmark suite (default)\n"
+		<< "  server     price options as they arrive on --input, one CSV\n"
+		<< "             line each after a header, until the input ends\n"
+		<< "\n"
+		<< "options:\n"
+		<< "  -t, --threads N    pricing threads of batch and benchmark runs,\n"
+		<< "                     0 for one per core (default); server runs\n"
+		<< "                     price on one thread and reject it\n"
+		<< "  -i, --input PATH   CSV or binary portfolio, - for standard input\n"
+		<< "  -o, --output PATH  results: - or *.txt for a table, otherwise a\n"
+		<< "                     mapped columnar file; benchmark mode writes\n"
+		<< "                     its results as CSV, its report going to\n"
+		<< "                     standard error when that is -\n"
+		<< "  --curve PATH       rate curve instruments CSV for single and\n"
+		<< "                     benchmark runs, bootstrapped: a header,\n"
+		<< "                     then deposit,3M,rate or future,YYYY-MM-DD,\n"
+		<< "                     price or swap,5Y,rate per line\n"
+		<< "  --surface PATH     volatility surface CSV for single and\n"
+		<< "                     benchmark runs: strike,YYYY-MM-DD,... then\n"
+		<< "                     a strike and its vols per line\n"
+		<< "  --chunk N          options per batch chunk (default 65536)\n"
+		<< "  --repetitions N    timed repetitions per benchmark (default 10)\n"
+		<< "  -h, --help         print this message\n";
+}
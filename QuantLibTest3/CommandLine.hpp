@@ -0,0 +1,43 @@
+/* -*- mode: c++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+// QuantLib Black-Scholes-Merton test - command line
+
+#ifndef quantlibtest3_command_line_hpp
+#define quantlibtest3_command_line_hpp
+
+#include <ql/quantlib.hpp>
+#include <ostream>
+#include <string>
+
+/** Options of a run.
+
+    QuantLibTest3 [single|batch|benchmark|server] [options]
+
+single prices one option and prints it, batch prices a portfolio
+file into a results file, benchmark runs the benchmark suite
+(the default) and server prices options read one per line until the
+input ends. No mode waits for the console.
+*/
+struct CommandLine {
+	enum Mode { Single, Batch, BenchmarkSuite, Server };
+
+	Mode mode;
+	QuantLib::Size threads;      // 0 for one per core
+	std::string input;           // portfolio file, "-" for std::cin
+	std::string output;          // results file, "-" for std::cout
+	std::string curve;           // curve instruments CSV, empty for flat
+	std::string surface;         // volatility surface CSV, empty for flat
+	QuantLib::Size chunkSize;    // options per batch chunk
+	QuantLib::Size repetitions;  // timed repetitions per benchmark
+	bool help;
+
+	CommandLine();
+};
+
+// Parse argv; throws on unknown modes and options
+CommandLine ParseCommandLine(int argc,
+	char * argv[]);
+
+void PrintUsage(std::ostream & os);
+
+#endif
@@ -0,0 +1,48 @@
+/* -*- mode: c++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+// QuantLib Black-Scholes-Merton test - CSV field parsing
+
+#include "CsvParsing.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <sstream>
+
+using namespace QuantLib;
+
+std::vector<std::string> SplitCsv(const std::string & line)
+{
+	std::vector<std::string> fields;
+	std::istringstream stream(line);
+	std::string field;
+	while (std::getline(stream, field, ','))
+		fields.push_back(field);
+	return fields;
+}
+
+Real ParseReal(const char * field, Size lineNumber)
+{
+	char * end;
+	Real value = std::strtod(field, &end);
+	QL_REQUIRE(end != field && *end == '\0',
+		"invalid number '" << field << "' on line " << lineNumber);
+	return value;
+}
+
+Real ParseReal(const std::string & field, Size lineNumber)
+{
+	return ParseReal(field.c_str(), lineNumber);
+}
+
+Date ParseIsoDate(const char * field, Size lineNumber)
+{
+	int y, m, d;
+	QL_REQUIRE(std::sscanf(field, "%4d-%2d-%2d", &y, &m, &d) == 3,
+		"invalid date '" << field << "' on line " << lineNumber);
+	return Date(Day(d), Month(m), Year(y));
+}
+
+Date ParseIsoDate(const std::string & field, Size lineNumber)
+{
+	return ParseIsoDate(field.c_str(), lineNumber);
+}
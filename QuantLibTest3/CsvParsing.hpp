@@ -0,0 +1,32 @@
+/* -*- mode: c++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+// QuantLib Black-Scholes-Merton test - CSV field parsing
+
+#ifndef quantlibtest3_csv_parsing_hpp
+#define quantlibtest3_csv_parsing_hpp
+
+#include <ql/quantlib.hpp>
+
+#include <string>
+#include <vector>
+
+/* Fields of the CSV inputs: portfolios, vol surfaces and curve
+quotes. The parsers take the whole field and throw, naming the field
+and the line, unless all of it is consumed.
+*/
+
+// The comma-separated fields of a line
+std::vector<std::string> SplitCsv(const std::string & line);
+
+QuantLib::Real ParseReal(const char * field,
+	QuantLib::Size lineNumber);
+QuantLib::Real ParseReal(const std::string & field,
+	QuantLib::Size lineNumber);
+
+// YYYY-MM-DD
+QuantLib::Date ParseIsoDate(const char * field,
+	QuantLib::Size lineNumber);
+QuantLib::Date ParseIsoDate(const std::string & field,
+	QuantLib::Size lineNumber);
+
+#endif
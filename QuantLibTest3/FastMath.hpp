@@ -0,0 +1,288 @@
+/* -*- mode: c++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+// QuantLib Black-Scholes-Merton test - vectorized elementary functions
+
+#ifndef quantlibtest3_fast_math_hpp
+#define quantlibtest3_fast_math_hpp
+
+#include "SimdPack.hpp"
+
+/** exp, log, the normal density and distribution and its inverse
+written against the simd packs, so a single definition serves the
+scalar, AVX2 and AVX-512 kernels in double and in float. The float
+instantiations use shorter polynomials where the double ones would
+be wasted. VectorMath.hpp gives the measured errors and array
+versions of each.
+*/
+
+namespace simd {
+
+	// True for the float packs
+	template <class V>
+	struct IsFloat {
+		enum { value = sizeof(typename V::value_type) == sizeof(float) };
+	};
+
+	/* ln 2 split in two so that k times the high part is exact for
+	every exponent k of the precision
+	*/
+	template <class V>
+	inline typename V::reg Ln2High()
+	{
+		return V::set1(IsFloat<V>::value ? 0.693359375 : 6.93147180369123816490e-01);
+	}
+
+	template <class V>
+	inline typename V::reg Ln2Low()
+	{
+		return V::set1(IsFloat<V>::value ? -2.12194440e-4 : 1.90821492927058770002e-10);
+	}
+
+	// e^x, flushed to the smallest normal / largest finite result
+	template <class V>
+	inline typename V::reg Exp(typename V::reg x)
+	{
+		typedef typename V::reg reg;
+		const bool single = IsFloat<V>::value;
+
+		x = V::max(V::min(x, V::set1(single ? 88.0 : 709.0)),
+			V::set1(single ? -87.0 : -708.0));
+
+		// x = k ln2 + r, |r| <= ln2/2
+		reg k = V::round(V::mul(x, V::set1(1.4426950408889634)));
+		reg minusK = V::neg(k);
+		reg r = V::fmadd(minusK, Ln2High<V>(), x);
+		r = V::fmadd(minusK, Ln2Low<V>(), r);
+
+		// Taylor series of e^r to degree 7 in float
+		if (single) {
+			reg p = V::set1(1.0 / 5040.0);
+			p = V::fmadd(p, r, V::set1(1.0 / 720.0));
+			p = V::fmadd(p, r, V::set1(1.0 / 120.0));
+			p = V::fmadd(p, r, V::set1(1.0 / 24.0));
+			p = V::fmadd(p, r, V::set1(1.0 / 6.0));
+			p = V::fmadd(p, r, V::set1(0.5));
+			p = V::fmadd(p, r, V::set1(1.0));
+			p = V::fmadd(p, r, V::set1(1.0));
+			return V::mul(p, V::pow2n(k));
+		}
+
+		// and to degree 13 in double
+		reg p = V::set1(1.0 / 6227020800.0);
+		p = V::fmadd(p, r, V::set1(1.0 / 479001600.0));
+		p = V::fmadd(p, r, V::set1(1.0 / 39916800.0));
+		p = V::fmadd(p, r, V::set1(1.0 / 3628800.0));
+		p = V::fmadd(p, r, V::set1(1.0 / 362880.0));
+		p = V::fmadd(p, r, V::set1(1.0 / 40320.0));
+		p = V::fmadd(p, r, V::set1(1.0 / 5040.0));
+		p = V::fmadd(p, r, V::set1(1.0 / 720.0));
+		p = V::fmadd(p, r, V::set1(1.0 / 120.0));
+		p = V::fmadd(p, r, V::set1(1.0 / 24.0));
+		p = V::fmadd(p, r, V::set1(1.0 / 6.0));
+		p = V::fmadd(p, r, V::set1(0.5));
+		p = V::fmadd(p, r, V::set1(1.0));
+		p = V::fmadd(p, r, V::set1(1.0));
+
+		return V::mul(p, V::pow2n(k));
+	}
+
+	// Natural logarithm of a positive normal number
+	template <class V>
+	inline typename V::reg Log(typename V::reg x)
+	{
+		typedef typename V::reg reg;
+
+		// x = 2^e m with m in [sqrt(1/2), sqrt(2))
+		reg e = V::exponent(x);
+		reg m = V::mantissa(x);
+		typename V::mask big = V::gt(m, V::set1(1.4142135623730951));
+		m = V::select(big, V::mul(m, V::set1(0.5)), m);
+		e = V::select(big, V::add(e, V::set1(1.0)), e);
+
+		// log m = 2 atanh(s), s = (m-1)/(m+1), |s| < 0.1716, to s^21 in
+		// double and s^9 in float
+		reg s = V::div(V::sub(m, V::set1(1.0)), V::add(m, V::set1(1.0)));
+		reg z = V::mul(s, s);
+		reg p = V::set1(1.0 / 9.0);
+		if (!IsFloat<V>::value) {
+			p = V::set1(1.0 / 21.0);
+			p = V::fmadd(p, z, V::set1(1.0 / 19.0));
+			p = V::fmadd(p, z, V::set1(1.0 / 17.0));
+			p = V::fmadd(p, z, V::set1(1.0 / 15.0));
+			p = V::fmadd(p, z, V::set1(1.0 / 13.0));
+			p = V::fmadd(p, z, V::set1(1.0 / 11.0));
+			p = V::fmadd(p, z, V::set1(1.0 / 9.0));
+		}
+		p = V::fmadd(p, z, V::set1(1.0 / 7.0));
+		p = V::fmadd(p, z, V::set1(1.0 / 5.0));
+		p = V::fmadd(p, z, V::set1(1.0 / 3.0));
+		reg logM = V::fmadd(V::mul(s, z), V::mul(p, V::set1(2.0)), V::add(s, s));
+
+		return V::fmadd(e, Ln2High<V>(), V::fmadd(e, Ln2Low<V>(), logM));
+	}
+
+	// Standard normal density
+	template <class V>
+	inline typename V::reg NormalPdf(typename V::reg x)
+	{
+		return V::mul(V::set1(0.39894228040143268),
+			Exp<V>(V::mul(V::set1(-0.5), V::mul(x, x))));
+	}
+
+	/* Standard normal distribution, Hart (1968) algorithm 5666 as given
+	by G. West, "Better approximations to cumulative normal functions".
+	Both branches are evaluated and blended so that lanes never diverge.
+	*/
+	template <class V>
+	inline typename V::reg NormalCdf(typename V::reg z)
+	{
+		typedef typename V::reg reg;
+
+		reg x = V::abs(z);
+		reg e = Exp<V>(V::mul(V::set1(-0.5), V::mul(x, x)));
+
+		// Rational approximation for |z| < 7.07
+		reg a = V::set1(0.0352624965998911);
+		a = V::fmadd(a, x, V::set1(0.700383064443688));
+		a = V::fmadd(a, x, V::set1(6.37396220353165));
+		a = V::fmadd(a, x, V::set1(33.912866078383));
+		a = V::fmadd(a, x, V::set1(112.079291497871));
+		a = V::fmadd(a, x, V::set1(221.213596169931));
+		a = V::fmadd(a, x, V::set1(220.206867912376));
+		reg b = V::set1(0.0883883476483184);
+		b = V::fmadd(b, x, V::set1(1.75566716318264));
+		b = V::fmadd(b, x, V::set1(16.064177579207));
+		b = V::fmadd(b, x, V::set1(86.7807322029461));
+		b = V::fmadd(b, x, V::set1(296.564248779674));
+		b = V::fmadd(b, x, V::set1(637.333633378831));
+		b = V::fmadd(b, x, V::set1(793.826512519948));
+		b = V::fmadd(b, x, V::set1(440.413735824752));
+		reg inner = V::div(V::mul(e, a), b);
+
+		// Continued fraction for the tail
+		reg c = V::add(x, V::set1(0.65));
+		c = V::add(x, V::div(V::set1(4.0), c));
+		c = V::add(x, V::div(V::set1(3.0), c));
+		c = V::add(x, V::div(V::set1(2.0), c));
+		c = V::add(x, V::div(V::set1(1.0), c));
+		reg tail = V::div(e, V::mul(c, V::set1(2.506628274631)));
+
+		// Zero where e^(-x^2/2) underflows the precision
+		reg lower = V::select(V::lt(x, V::set1(7.07106781186547)), inner, tail);
+		lower = V::select(V::gt(x, V::set1(IsFloat<V>::value ? 13.0 : 37.0)),
+			V::set1(0.0), lower);
+
+		return V::select(V::gt(z, V::set1(0.0)),
+			V::sub(V::set1(1.0), lower), lower);
+	}
+
+	/* Inverse of the standard normal distribution for p in (0, 1).
+	Double uses P. J. Acklam's rational approximations, relative error
+	below 1.15e-9, refined above p = 1e-12 by one step of Halley's
+	method on NormalCdf(); float uses M. J. Wichura's PPND7 from algorithm AS 241,
+	whose coefficients are small enough not to cancel in single
+	precision, accurate to about 1e-7. Computed on the lower half,
+	min(p, 1 - p), and reflected, so the upper tail loses nothing to
+	1 - p; p at or beyond 0 and 1 is clamped to the smallest normal
+	number from either end.
+	*/
+	template <class V>
+	inline typename V::reg InverseNormalCdf(typename V::reg p)
+	{
+		typedef typename V::reg reg;
+		const bool single = IsFloat<V>::value;
+
+		typename V::mask upper = V::gt(p, V::set1(0.5));
+		reg lower = V::select(upper, V::sub(V::set1(1.0), p), p);
+		lower = V::max(lower, V::set1(single ? 1.1754943508222875e-38
+			: 2.2250738585072014e-308));
+		reg q = V::sub(lower, V::set1(0.5));
+		reg x;
+
+		if (single) {
+			// Central region, lower >= 0.075
+			reg r = V::sub(V::set1(0.180625), V::mul(q, q));
+			reg a = V::set1(5.9109374720e+01);
+			a = V::fmadd(a, r, V::set1(1.5929113202e+02));
+			a = V::fmadd(a, r, V::set1(5.0434271938e+01));
+			a = V::fmadd(a, r, V::set1(3.3871327179e+00));
+			reg b = V::set1(6.7187563600e+01);
+			b = V::fmadd(b, r, V::set1(7.8757757664e+01));
+			b = V::fmadd(b, r, V::set1(1.7895169469e+01));
+			b = V::fmadd(b, r, V::set1(1.0));
+			reg central = V::div(V::mul(a, q), b);
+
+			// Tails, split at sqrt(-log lower) = 5
+			reg s = V::sqrt(V::neg(Log<V>(lower)));
+			reg s1 = V::sub(s, V::set1(1.6));
+			reg c = V::set1(1.7023821103e-01);
+			c = V::fmadd(c, s1, V::set1(1.3067284816e+00));
+			c = V::fmadd(c, s1, V::set1(2.7568153900e+00));
+			c = V::fmadd(c, s1, V::set1(1.4234372777e+00));
+			reg d = V::set1(1.2021132975e-01);
+			d = V::fmadd(d, s1, V::set1(7.3700164250e-01));
+			d = V::fmadd(d, s1, V::set1(1.0));
+			reg s2 = V::sub(s, V::set1(5.0));
+			reg e = V::set1(1.7337203997e-02);
+			e = V::fmadd(e, s2, V::set1(4.2868294337e-01));
+			e = V::fmadd(e, s2, V::set1(3.0812263860e+00));
+			e = V::fmadd(e, s2, V::set1(6.6579051150e+00));
+			reg f = V::set1(1.2258202635e-02);
+			f = V::fmadd(f, s2, V::set1(2.4197894225e-01));
+			f = V::fmadd(f, s2, V::set1(1.0));
+			reg tail = V::neg(V::select(V::gt(s, V::set1(5.0)),
+				V::div(e, f), V::div(c, d)));
+
+			x = V::select(V::lt(lower, V::set1(0.075)), tail, central);
+		} else {
+			// Central region, lower >= 0.02425
+			reg r = V::mul(q, q);
+			reg a = V::set1(-3.969683028665376e+01);
+			a = V::fmadd(a, r, V::set1(2.209460984245205e+02));
+			a = V::fmadd(a, r, V::set1(-2.759285104469687e+02));
+			a = V::fmadd(a, r, V::set1(1.383577518672690e+02));
+			a = V::fmadd(a, r, V::set1(-3.066479806614716e+01));
+			a = V::fmadd(a, r, V::set1(2.506628277459239e+00));
+			reg b = V::set1(-5.447609879822406e+01);
+			b = V::fmadd(b, r, V::set1(1.615858368580409e+02));
+			b = V::fmadd(b, r, V::set1(-1.556989798598866e+02));
+			b = V::fmadd(b, r, V::set1(6.680131188771972e+01));
+			b = V::fmadd(b, r, V::set1(-1.328068155288572e+01));
+			b = V::fmadd(b, r, V::set1(1.0));
+			reg central = V::div(V::mul(a, q), b);
+
+			// Tail
+			reg t = V::sqrt(V::mul(V::set1(-2.0), Log<V>(lower)));
+			reg c = V::set1(-7.784894002430293e-03);
+			c = V::fmadd(c, t, V::set1(-3.223964580411365e-01));
+			c = V::fmadd(c, t, V::set1(-2.400758277161838e+00));
+			c = V::fmadd(c, t, V::set1(-2.549732539343734e+00));
+			c = V::fmadd(c, t, V::set1(4.374664141464968e+00));
+			c = V::fmadd(c, t, V::set1(2.938163982698783e+00));
+			reg d = V::set1(7.784695709041462e-03);
+			d = V::fmadd(d, t, V::set1(3.224671290700398e-01));
+			d = V::fmadd(d, t, V::set1(2.445134137142996e+00));
+			d = V::fmadd(d, t, V::set1(3.754408661907416e+00));
+			d = V::fmadd(d, t, V::set1(1.0));
+			reg tail = V::div(c, d);
+
+			x = V::select(V::lt(lower, V::set1(0.02425)), tail, central);
+
+			// u = (N(x) - p) / n(x); x -= u / (1 + x u / 2). Only above
+			// 1e-12, x > -7.03, where NormalCdf() is Hart's rational
+			// function: its continued fraction beyond is less accurate in
+			// relative terms than the approximation it would refine
+			reg u = V::mul(V::sub(NormalCdf<V>(x), lower),
+				V::mul(V::set1(2.5066282746310002),
+				Exp<V>(V::mul(V::set1(0.5), V::mul(x, x)))));
+			reg refined = V::sub(x, V::div(u, V::fmadd(V::mul(V::set1(0.5), x), u,
+				V::set1(1.0))));
+			x = V::select(V::lt(lower, V::set1(1e-12)), x, refined);
+		}
+
+		return V::select(upper, V::neg(x), x);
+	}
+
+}
+
+#endif
@@ -0,0 +1,353 @@
+/* -*- mode: c++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+// QuantLib Black-Scholes-Merton test - Crank-Nicolson finite differences
+
+#include "FiniteDifferenceEngine.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace QuantLib;
+
+namespace {
+
+	// Value and first two derivatives at x of the parabola through
+	// three nodes
+	struct Parabola {
+		Real value, first, second;
+	};
+
+	Parabola Interpolate(const Real * x,
+		const Real * v,
+		Real at)
+	{
+		Real h0 = x[1] - x[0], h1 = x[2] - x[1];
+		Real s0 = (v[1] - v[0]) / h0, s1 = (v[2] - v[1]) / h1;
+		Parabola p;
+		p.second = 2.0 * (s1 - s0) / (h0 + h1);
+		p.first = s0 + p.second * (at - 0.5 * (x[0] + x[1]));
+		p.value = v[0] + (at - x[0]) * (s0 + 0.5 * p.second * (at - x[1]));
+		return p;
+	}
+
+	bool Same(Real x,
+		Real y)
+	{
+		return std::fabs(x - y) <= 1.0e-10 * std::max(std::fabs(x), std::fabs(y));
+	}
+
+}
+
+FdCrankNicolsonEngine::FdCrankNicolsonEngine(
+	const boost::shared_ptr<GeneralizedBlackScholesProcess> & process,
+	Size timeSteps,
+	Size gridPoints,
+	Real density,
+	Size dampingSteps) :
+	process_(process),
+	timeSteps_(timeSteps),
+	gridPoints_(gridPoints),
+	density_(density),
+	dampingSteps_(dampingSteps)
+{
+	QL_REQUIRE(timeSteps_ > 0, "at least one time step is needed");
+	QL_REQUIRE(gridPoints_ >= 4, "at least four grid points are needed");
+	QL_REQUIRE(density_ > 0.0, "non-positive grid density " << density_);
+	QL_REQUIRE(dampingSteps_ <= timeSteps_,
+		"more damping steps (" << dampingSteps_ << ") than time steps ("
+		<< timeSteps_ << ")");
+
+	registerWith(process_);
+}
+
+// Equal up to the rounding in rates and variances taken from flat
+// curves, which would otherwise trigger a factorization every step
+bool FdCrankNicolsonEngine::Step::operator==(const Step & other) const
+{
+	return Same(dt, other.dt) && theta == other.theta && sameOperator(other);
+}
+
+bool FdCrankNicolsonEngine::Step::sameOperator(const Step & other) const
+{
+	return Same(variance, other.variance) && Same(rate, other.rate)
+		&& Same(dividend, other.dividend);
+}
+
+void FdCrankNicolsonEngine::discretize(const Step & step) const
+{
+	const Real halfVariance = 0.5 * step.variance;
+	const Real drift = step.rate - step.dividend - halfVariance;
+	for (Size i = 1; i < gridPoints_ - 1; ++i) {
+		operatorLower_[i] = halfVariance * d2Lower_[i] + drift * d1Lower_[i];
+		operatorDiag_[i] = halfVariance * d2Diag_[i] + drift * d1Diag_[i]
+			- step.rate;
+		operatorUpper_[i] = halfVariance * d2Upper_[i] + drift * d1Upper_[i];
+	}
+
+	discretized_ = step;
+	isDiscretized_ = true;
+}
+
+void FdCrankNicolsonEngine::factorize(const Step & step,
+	bool lowExercise) const
+{
+	if (!isDiscretized_ || !step.sameOperator(discretized_))
+		discretize(step);
+
+	const Size n = gridPoints_;
+	const Real implicitDt = step.theta * step.dt;
+	const Real explicitDt = (1.0 - step.theta) * step.dt;
+
+	// Boundary rows hold their values
+	explicitLower_[0] = explicitUpper_[0] = 0.0;
+	explicitLower_[n - 1] = explicitUpper_[n - 1] = 0.0;
+	lower_[0] = upper_[0] = 0.0;
+	lower_[n - 1] = upper_[n - 1] = 0.0;
+	std::vector<Real> & diag = inversePivot_;
+	diag[0] = diag[n - 1] = 1.0;
+
+	for (Size i = 1; i < n - 1; ++i) {
+		Real a = operatorLower_[i], b = operatorDiag_[i], c = operatorUpper_[i];
+		explicitLower_[i] = explicitDt * a;
+		explicitDiag_[i] = 1.0 + explicitDt * b;
+		explicitUpper_[i] = explicitDt * c;
+		lower_[i] = -implicitDt * a;
+		diag[i] = 1.0 - implicitDt * b;
+		upper_[i] = -implicitDt * c;
+	}
+
+	// Thomas elimination towards the exercise region, in place of
+	// the diagonal
+	if (lowExercise) {
+		multiplier_[n - 1] = 0.0;
+		diag[n - 1] = 1.0 / diag[n - 1];
+		for (Size i = n - 1; i-- > 0;) {
+			multiplier_[i] = upper_[i] * diag[i + 1];
+			diag[i] = 1.0 / (diag[i] - multiplier_[i] * lower_[i + 1]);
+		}
+	} else {
+		multiplier_[0] = 0.0;
+		diag[0] = 1.0 / diag[0];
+		for (Size i = 1; i < n; ++i) {
+			multiplier_[i] = lower_[i] * diag[i - 1];
+			diag[i] = 1.0 / (diag[i] - multiplier_[i] * upper_[i - 1]);
+		}
+	}
+
+	factorized_ = step;
+	isFactorized_ = true;
+}
+
+void FdCrankNicolsonEngine::rollback(const Step & step,
+	Real lowerBoundary,
+	Real upperBoundary,
+	bool american,
+	bool lowExercise) const
+{
+	if (!isFactorized_ || !(step == factorized_))
+		factorize(step, lowExercise);
+
+	const Size n = gridPoints_;
+	const Real * v = &values_[0];
+
+	// The explicit part and the elimination of the right-hand side
+	// in one pass, then back substitution with the projection
+	if (lowExercise) {
+		work_[n - 1] = upperBoundary;
+		for (Size i = n - 2; i > 0; --i)
+			work_[i] = explicitLower_[i] * v[i - 1] + explicitDiag_[i] * v[i]
+			+ explicitUpper_[i] * v[i + 1] - multiplier_[i] * work_[i + 1];
+		work_[0] = lowerBoundary - multiplier_[0] * work_[1];
+
+		values_[0] = work_[0] * inversePivot_[0];
+		if (american)
+			values_[0] = std::max(values_[0], exercise_[0]);
+		for (Size i = 1; i < n; ++i) {
+			values_[i] = (work_[i] - lower_[i] * values_[i - 1]) * inversePivot_[i];
+			if (american)
+				values_[i] = std::max(values_[i], exercise_[i]);
+		}
+	} else {
+		work_[0] = lowerBoundary;
+		for (Size i = 1; i < n - 1; ++i)
+			work_[i] = explicitLower_[i] * v[i - 1] + explicitDiag_[i] * v[i]
+			+ explicitUpper_[i] * v[i + 1] - multiplier_[i] * work_[i - 1];
+		work_[n - 1] = upperBoundary - multiplier_[n - 1] * work_[n - 2];
+
+		values_[n - 1] = work_[n - 1] * inversePivot_[n - 1];
+		if (american)
+			values_[n - 1] = std::max(values_[n - 1], exercise_[n - 1]);
+		for (Size i = n - 1; i-- > 0;) {
+			values_[i] = (work_[i] - upper_[i] * values_[i + 1]) * inversePivot_[i];
+			if (american)
+				values_[i] = std::max(values_[i], exercise_[i]);
+		}
+	}
+}
+
+void FdCrankNicolsonEngine::calculate() const
+{
+	const Exercise::Type exerciseType = arguments_.exercise->type();
+	QL_REQUIRE(exerciseType == Exercise::American
+		|| exerciseType == Exercise::European,
+		"only American and European exercise are supported");
+	const bool american = exerciseType == Exercise::American;
+
+	boost::shared_ptr<StrikedTypePayoff> payoff =
+		boost::dynamic_pointer_cast<StrikedTypePayoff>(arguments_.payoff);
+	QL_REQUIRE(payoff, "non-striked payoff given");
+	const bool lowExercise = payoff->optionType() == Option::Put;
+
+	const Time maturity = process_->time(arguments_.exercise->lastDate());
+	QL_REQUIRE(maturity > 0.0, "option expired");
+
+	const Real spot = process_->x0();
+	const Real strike = payoff->strike();
+	QL_REQUIRE(spot > 0.0, "non-positive spot " << spot);
+	QL_REQUIRE(strike > 0.0, "non-positive strike " << strike);
+
+	const Handle<YieldTermStructure> & riskFree = process_->riskFreeRate();
+	const Handle<YieldTermStructure> & dividend = process_->dividendYield();
+	const Handle<BlackVolTermStructure> & vol = process_->blackVolatility();
+
+	// Grid spanning spot, forward and strike, concentrated at the
+	// strike by a sinh mapping and with a node on it, so the payoff
+	// kink doesn't fall between nodes
+	const Size n = gridPoints_;
+	const Real xSpot = std::log(spot);
+	const Real xStrike = std::log(strike);
+	const Real xForward = xSpot + std::log(dividend->discount(maturity)
+		/ riskFree->discount(maturity));
+	const Real span = gridStdDevs * std::sqrt(vol->blackVariance(maturity, strike));
+	const Real xMin = std::min(std::min(xSpot, xForward), xStrike) - span;
+	const Real xMax = std::max(std::max(xSpot, xForward), xStrike) + span;
+	const Real alpha = density_ * (xMax - xMin);
+	const Real c0 = std::asinh((xMin - xStrike) / alpha);
+	Real c1 = std::asinh((xMax - xStrike) / alpha);
+	{
+		// Stretch the upper end so that the strike falls on a node
+		Size strikeNode = Size(-c0 / (c1 - c0) * (n - 1) + 0.5);
+		strikeNode = std::min(std::max<Size>(strikeNode, 1), n - 2);
+		c1 = c0 - c0 * (n - 1) / strikeNode;
+	}
+
+	x_.resize(n);
+	exercise_.resize(n);
+	values_.resize(n);
+	d1Lower_.resize(n);
+	d1Diag_.resize(n);
+	d1Upper_.resize(n);
+	d2Lower_.resize(n);
+	d2Diag_.resize(n);
+	d2Upper_.resize(n);
+	operatorLower_.resize(n);
+	operatorDiag_.resize(n);
+	operatorUpper_.resize(n);
+	explicitLower_.resize(n);
+	explicitDiag_.resize(n);
+	explicitUpper_.resize(n);
+	lower_.resize(n);
+	upper_.resize(n);
+	multiplier_.resize(n);
+	inversePivot_.resize(n);
+	work_.resize(n);
+	isDiscretized_ = false;
+	isFactorized_ = false;
+
+	for (Size i = 0; i < n; ++i)
+		x_[i] = xStrike + alpha * std::sinh(c0 + (c1 - c0) * i / (n - 1));
+
+	// Three-point stencils on the non-uniform grid
+	for (Size i = 1; i < n - 1; ++i) {
+		Real hm = x_[i] - x_[i - 1], hp = x_[i + 1] - x_[i];
+		d1Lower_[i] = -hp / (hm * (hm + hp));
+		d1Diag_[i] = (hp - hm) / (hm * hp);
+		d1Upper_[i] = hm / (hp * (hm + hp));
+		d2Lower_[i] = 2.0 / (hm * (hm + hp));
+		d2Diag_[i] = -2.0 / (hm * hp);
+		d2Upper_[i] = 2.0 / (hp * (hm + hp));
+	}
+
+	for (Size i = 0; i < n; ++i) {
+		exercise_[i] = (*payoff)(std::exp(x_[i]));
+		values_[i] = exercise_[i];
+	}
+
+	const Real sLow = std::exp(x_[0]), sHigh = std::exp(x_[n - 1]);
+	const DiscountFactor riskFreeT = riskFree->discount(maturity);
+	const DiscountFactor dividendT = dividend->discount(maturity);
+
+	// Boundary value at time t: the discounted payoff at the forward,
+	// or the payoff itself if exercising is worth more
+	struct Boundaries {
+		Real lower, upper;
+	};
+	const StrikedTypePayoff & f = *payoff;
+	auto boundaries = [&](Time t) -> Boundaries {
+		DiscountFactor r = riskFreeT / riskFree->discount(t);
+		DiscountFactor q = dividendT / dividend->discount(t);
+		Boundaries b = { r * f(sLow * q / r), r * f(sHigh * q / r) };
+		if (american) {
+			b.lower = std::max(b.lower, f(sLow));
+			b.upper = std::max(b.upper, f(sHigh));
+		}
+		return b;
+	};
+
+	// Parabola through the three nodes nearest the spot
+	Size j = std::upper_bound(x_.begin(), x_.end(), xSpot) - x_.begin();
+	if (j < n && xSpot - x_[j - 1] < x_[j] - xSpot)
+		--j;
+	j = std::min(std::max<Size>(j, 1), n - 2);
+	const Real * nodes = &x_[j - 1];
+	const Real * values = &values_[j - 1];
+
+	// Time steps are equal for European options; for American ones
+	// they shrink quadratically towards maturity, where the exercise
+	// boundary moves fastest
+	auto timeAt = [&](Size k) -> Time {
+		Real remaining = 1.0 - Real(k) / timeSteps_;
+		return maturity * (1.0 - (american ? remaining * remaining : remaining));
+	};
+
+	// Step back from maturity; the value one step from today is kept
+	// for theta
+	Real variance1 = vol->blackVariance(maturity, strike);
+	Real valueAtDt = Null<Real>();
+	Real dt = 0.0;
+	for (Size k = timeSteps_; k-- > 0;) {
+		Time t0 = timeAt(k);
+		Time t1 = timeAt(k + 1);
+		dt = t1 - t0;
+		Real variance0 = vol->blackVariance(t0, strike);
+		QL_REQUIRE(variance1 >= variance0, "negative forward variance between "
+			<< t0 << " and " << t1);
+		Real sigma2 = (variance1 - variance0) / dt;
+		Rate r = std::log(riskFree->discount(t0) / riskFree->discount(t1)) / dt;
+		Rate q = std::log(dividend->discount(t0) / dividend->discount(t1)) / dt;
+
+		if (timeSteps_ - k <= dampingSteps_) {
+			Step half = { 0.5 * dt, 1.0, sigma2, r, q };
+			Boundaries b = boundaries(0.5 * (t0 + t1));
+			rollback(half, b.lower, b.upper, american, lowExercise);
+			b = boundaries(t0);
+			rollback(half, b.lower, b.upper, american, lowExercise);
+		} else {
+			Step full = { dt, 0.5, sigma2, r, q };
+			Boundaries b = boundaries(t0);
+			rollback(full, b.lower, b.upper, american, lowExercise);
+		}
+		variance1 = variance0;
+
+		if (k == 1)
+			valueAtDt = Interpolate(nodes, values, xSpot).value;
+	}
+
+	Parabola p = Interpolate(nodes, values, xSpot);
+
+	results_.value = p.value;
+	results_.delta = p.first / spot;
+	results_.gamma = (p.second - p.first) / (spot * spot);
+	if (valueAtDt != Null<Real>())
+		results_.theta = (valueAtDt - p.value) / dt;
+}
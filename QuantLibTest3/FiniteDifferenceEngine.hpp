@@ -0,0 +1,122 @@
+/* -*- mode: c++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+// QuantLib Black-Scholes-Merton test - Crank-Nicolson finite differences
+
+#ifndef quantlibtest3_finite_difference_engine_hpp
+#define quantlibtest3_finite_difference_engine_hpp
+
+#include <ql/quantlib.hpp>
+
+#include <vector>
+
+/** Crank-Nicolson finite-difference engine for American and European
+options on a Black-Scholes process.
+
+The pricing PDE is solved in log(S) on gridPoints nodes spread by a
+sinh mapping, which puts most of them around the strike where the
+payoff has its kink and the exercise boundary lies, with one node on
+the strike itself; density is the width of that concentration as a
+fraction of the grid span. Rate, dividend yield and volatility (at
+the strike) are constant over each of timeSteps steps and taken from
+the process's curves. Steps are equal for European exercise and
+shrink quadratically towards maturity for American exercise, as the
+exercise boundary moves like the square root of the time left. The
+far boundaries hold the discounted payoff at the forward.
+
+The first dampingSteps steps are each taken as two implicit Euler
+half-steps (Rannacher smoothing), which keeps the payoff kink from
+ringing through the Crank-Nicolson steps into delta and gamma.
+
+Early exercise is enforced inside the tridiagonal solve: the Thomas
+algorithm eliminates towards the exercise side and projects on the
+payoff while substituting back (Brennan-Schwartz), which solves the
+discrete problem exactly for payoffs with a single exercise region,
+puts at low spots and calls at high ones. The space operator depends
+only on the rate, dividend yield and variance of a step and is kept
+while they don't change, as on flat curves. The elimination also
+depends on dt: European steps are equal, so it is kept too and they
+have no divisions in them, while American steps change dt every time
+and redo it, one division per node, from the kept operator.
+
+The grid, coefficients and solver work arrays are allocated on the
+first calculation and reused by the next ones, so an engine must not
+be shared by options priced on different threads at the same time.
+
+Results are value, delta and gamma from the grid at the spot and
+theta from the last time step.
+*/
+class FdCrankNicolsonEngine :
+	public QuantLib::VanillaOption::engine
+{
+
+public:
+
+	FdCrankNicolsonEngine(
+		const boost::shared_ptr<QuantLib::GeneralizedBlackScholesProcess> & process,
+		QuantLib::Size timeSteps = 100,
+		QuantLib::Size gridPoints = 100,
+		QuantLib::Real density = 0.05,
+		QuantLib::Size dampingSteps = 2);
+
+	void calculate() const;
+
+	// Standard deviations of log(S) spanned beyond spot and strike
+	enum { gridStdDevs = 5 };
+
+private:
+
+	// Coefficients of one step back in time of length dt, implicit
+	// with weight theta
+	struct Step {
+		QuantLib::Real dt, theta, variance, rate, dividend;
+		bool operator==(const Step & other) const;
+		bool sameOperator(const Step & other) const;
+	};
+
+	// Space operator of the step's rate, dividend yield and variance
+	void discretize(const Step & step) const;
+
+	// Explicit and implicit parts and factorization of the step's
+	// tridiagonal system
+	void factorize(const Step & step,
+		bool lowExercise) const;
+
+	// Values of one step back, holding the boundaries at the given
+	// values and projecting American ones on the payoff
+	void rollback(const Step & step,
+		QuantLib::Real lowerBoundary,
+		QuantLib::Real upperBoundary,
+		bool american,
+		bool lowExercise) const;
+
+	boost::shared_ptr<QuantLib::GeneralizedBlackScholesProcess> process_;
+	QuantLib::Size timeSteps_;
+	QuantLib::Size gridPoints_;
+	QuantLib::Real density_;
+	QuantLib::Size dampingSteps_;
+
+	// Grid nodes in log(S), the payoff on them and the solution
+	mutable std::vector<QuantLib::Real> x_;
+	mutable std::vector<QuantLib::Real> exercise_;
+	mutable std::vector<QuantLib::Real> values_;
+
+	// First and second derivative stencils of every inner node
+	mutable std::vector<QuantLib::Real> d1Lower_, d1Diag_, d1Upper_;
+	mutable std::vector<QuantLib::Real> d2Lower_, d2Diag_, d2Upper_;
+
+	// Space operator, kept while the coefficients repeat
+	mutable std::vector<QuantLib::Real> operatorLower_, operatorDiag_, operatorUpper_;
+	mutable Step discretized_;
+	mutable bool isDiscretized_;
+
+	// Explicit and implicit parts of the step and the Thomas
+	// elimination of the implicit one, kept while steps repeat
+	mutable std::vector<QuantLib::Real> explicitLower_, explicitDiag_, explicitUpper_;
+	mutable std::vector<QuantLib::Real> lower_, upper_;
+	mutable std::vector<QuantLib::Real> multiplier_, inversePivot_, work_;
+	mutable Step factorized_;
+	mutable bool isFactorized_;
+
+};
+
+#endif
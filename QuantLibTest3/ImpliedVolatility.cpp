@@ -0,0 +1,153 @@
+/* -*- mode: c++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+// QuantLib Black-Scholes-Merton test - batch implied volatility
+
+#include "ImpliedVolatility.hpp"
+#include "FastMath.hpp"
+#include <limits>
+
+using namespace QuantLib;
+
+namespace {
+
+	// Solve V::width quotes starting at i
+	template <class V>
+	inline void ImpliedVolatilityBlock(const OptionArrays & in,
+		const Real * prices,
+		Size i,
+		Size iterations,
+		Volatility * vols)
+	{
+		typedef typename V::reg reg;
+		typedef typename V::mask mask;
+
+		const reg zero = V::set1(0.0), one = V::set1(1.0), half = V::set1(0.5);
+
+		reg theta = V::load(&in.phi[i]);
+		reg spot = V::load(&in.spot[i]);
+		reg strike = V::load(&in.strike[i]);
+		reg r = V::load(&in.rate[i]);
+		reg q = V::load(&in.dividend[i]);
+		reg t = V::load(&in.time[i]);
+
+		// Undiscounted price and log-moneyness
+		reg forward = V::mul(spot, simd::Exp<V>(V::mul(V::sub(r, q), t)));
+		reg price = V::mul(V::load(prices + i), simd::Exp<V>(V::mul(r, t)));
+		reg x = simd::Log<V>(V::div(forward, strike));
+
+		// Work with the out-of-the-money option
+		mask itm = V::gt(V::mul(theta, x), zero);
+		price = V::select(itm,
+			V::sub(price, V::mul(theta, V::sub(forward, strike))), price);
+		theta = V::select(itm, V::neg(theta), theta);
+
+		// Out of bounds quotes: below zero time value or above the
+		// price at infinite volatility
+		reg upper = V::select(V::gt(theta, zero), forward, strike);
+		mask invalid = V::maskOr(V::lt(price, V::set1(QL_MIN_POSITIVE_REAL)),
+			V::ge(price, upper));
+		price = V::select(invalid, V::mul(half, upper), price);
+
+		// Black price at the inflection point
+		reg sc = V::max(V::sqrt(V::add(V::abs(x), V::abs(x))), V::set1(1.0e-8));
+		reg dc = V::fmadd(half, sc, V::div(x, sc));
+		reg bc = V::mul(theta,
+			V::sub(V::mul(forward, simd::NormalCdf<V>(V::mul(theta, dc))),
+			V::mul(strike, simd::NormalCdf<V>(V::mul(theta, V::sub(dc, sc))))));
+		mask low = V::lt(price, bc);
+
+		// Lower branch guess
+		reg logPrice = simd::Log<V>(price);
+		reg u = V::add(V::div(one, V::mul(sc, sc)),
+			V::div(V::add(V::sub(simd::Log<V>(bc), logPrice),
+			V::sub(simd::Log<V>(bc), logPrice)), V::mul(x, x)));
+		reg lowGuess = V::max(V::div(one, V::sqrt(u)),
+			V::div(V::mul(sc, price), bc));
+		lowGuess = V::min(lowGuess, sc);
+
+		// Upper branch guess (Corrado-Miller)
+		reg cm = V::fmadd(V::mul(theta, half), V::sub(strike, forward), price);
+		reg disc = V::sub(V::mul(cm, cm),
+			V::mul(V::set1(1.0 / M_PI),
+			V::mul(V::sub(forward, strike), V::sub(forward, strike))));
+		reg highGuess = V::mul(
+			V::div(V::set1(2.5066282746310002), V::add(forward, strike)),
+			V::add(cm, V::sqrt(V::max(disc, zero))));
+		highGuess = V::max(highGuess, sc);
+
+		reg s = V::select(low, lowGuess, highGuess);
+		reg lo = V::select(low, zero, sc);
+		reg hi = V::select(low, sc, V::set1(QL_MAX_REAL));
+
+		for (Size k = 0; k < iterations; ++k) {
+			reg d1 = V::fmadd(half, s, V::div(x, s));
+			reg d2 = V::sub(d1, s);
+			reg b = V::mul(theta,
+				V::sub(V::mul(forward, simd::NormalCdf<V>(V::mul(theta, d1))),
+				V::mul(strike, simd::NormalCdf<V>(V::mul(theta, d2)))));
+
+			// Derivatives of B with respect to s
+			reg g = V::mul(d1, d2);
+			reg invS = V::div(one, s);
+			reg b1 = V::mul(forward, simd::NormalPdf<V>(d1));
+			reg b2 = V::mul(V::mul(b1, g), invS);
+			reg b3 = V::mul(V::mul(b1, V::mul(invS, invS)),
+				V::sub(V::sub(V::mul(g, g),
+				V::mul(V::set1(3.0), V::mul(V::mul(x, x), V::mul(invS, invS)))),
+				V::mul(V::set1(0.25), V::mul(s, s))));
+
+			// Lower branch objective ln B - ln price
+			reg r1 = V::div(b1, b);
+			reg r2 = V::div(b2, b);
+			reg r3 = V::div(b3, b);
+			reg lf = V::sub(simd::Log<V>(b), logPrice);
+			reg lf2 = V::sub(r2, V::mul(r1, r1));
+			reg lf3 = V::add(V::sub(r3, V::mul(V::set1(3.0), V::mul(r2, r1))),
+				V::mul(V::set1(2.0), V::mul(r1, V::mul(r1, r1))));
+
+			reg f = V::select(low, lf, V::sub(b, price));
+			reg f1 = V::select(low, r1, b1);
+			reg f2 = V::select(low, lf2, b2);
+			reg f3 = V::select(low, lf3, b3);
+
+			// Both objectives increase with s
+			hi = V::select(V::gt(f, zero), V::min(hi, s), hi);
+			lo = V::select(V::lt(f, zero), V::max(lo, s), lo);
+
+			// Householder step of order three
+			reg nu = V::neg(V::div(f, f1));
+			reg h2 = V::div(f2, f1);
+			reg h3 = V::div(f3, f1);
+			reg step = V::div(V::mul(nu, V::fmadd(V::mul(half, h2), nu, one)),
+				V::add(V::fmadd(h2, nu, one),
+				V::mul(V::set1(1.0 / 6.0), V::mul(h3, V::mul(nu, nu)))));
+			reg next = V::add(s, step);
+
+			// Bisect when the step leaves the bracket or is not a number
+			mask inside = V::maskAnd(V::ge(next, lo), V::le(next, hi));
+			s = V::select(inside, next, V::mul(half, V::add(lo, hi)));
+		}
+
+		reg vol = V::div(s, V::sqrt(t));
+		V::store(vols + i, V::select(invalid,
+			V::set1(std::numeric_limits<Real>::quiet_NaN()), vol));
+	}
+
+}
+
+void ImpliedVolatilityKernel(const OptionArrays & in,
+	const Real * prices,
+	Volatility * vols,
+	Size iterations)
+{
+	typedef simd::Native V;
+
+	const Size n = in.size();
+	Size i = 0;
+
+	for (; i + V::width <= n; i += V::width)
+		ImpliedVolatilityBlock<V>(in, prices, i, iterations, vols);
+
+	for (; i < n; ++i)
+		ImpliedVolatilityBlock<simd::Scalar>(in, prices, i, iterations, vols);
+}
@@ -0,0 +1,107 @@
+/* -*- mode: c++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+// QuantLib Black-Scholes-Merton test - live repricing on spot ticks
+
+#include "LiveRepricer.hpp"
+#include "BatchPricer.hpp"
+
+using namespace QuantLib;
+
+namespace {
+
+	// A vanilla option that counts its recalculations
+	class CountingOption :
+		public VanillaOption
+	{
+
+	public:
+
+		CountingOption(const boost::shared_ptr<StrikedTypePayoff> & payoff,
+			const boost::shared_ptr<Exercise> & exercise,
+			const boost::shared_ptr<Size> & counter) :
+			VanillaOption(payoff, exercise),
+			counter_(counter)
+		{
+		}
+
+	protected:
+
+		void performCalculations() const
+		{
+			++*counter_;
+			VanillaOption::performCalculations();
+		}
+
+	private:
+
+		boost::shared_ptr<Size> counter_;
+
+	};
+
+}
+
+LiveRepricer::LiveRepricer(const Date & settlementDate,
+	const Calendar & calendar) :
+	settlementDate_(settlementDate),
+	calendar_(calendar),
+	recalculations_(new Size(0))
+{
+}
+
+Size LiveRepricer::addUnderlying(const OptionInputs & market)
+{
+	Underlying underlying;
+	underlying.spot = boost::shared_ptr<SimpleQuote>(
+		new SimpleQuote(market.underlying));
+
+	boost::shared_ptr<BlackScholesMertonProcess> process =
+		MakeProcess(Handle<Quote>(underlying.spot),
+		market,
+		settlementDate_,
+		calendar_);
+
+	underlying.engine = boost::shared_ptr<PricingEngine>(
+		new AnalyticEuropeanEngine(process));
+
+	underlyings_.push_back(underlying);
+	return underlyings_.size() - 1;
+}
+
+Size LiveRepricer::addOption(Size underlying,
+	const OptionInputs & in)
+{
+	QL_REQUIRE(underlying < underlyings_.size(),
+		"unknown underlying " << underlying);
+
+	boost::shared_ptr<VanillaOption> option(
+		new CountingOption(
+		boost::shared_ptr<StrikedTypePayoff>(
+		new PlainVanillaPayoff(in.type, in.strike)),
+		boost::shared_ptr<Exercise>(
+		new EuropeanExercise(in.maturity)),
+		recalculations_));
+	option->setPricingEngine(underlyings_[underlying].engine);
+
+	options_.push_back(option);
+	underlyings_[underlying].options.push_back(options_.size() - 1);
+	return options_.size() - 1;
+}
+
+void LiveRepricer::setSpot(Size underlying,
+	Real spot)
+{
+	underlyings_[underlying].spot->setValue(spot);
+}
+
+Real LiveRepricer::NPV(Size option) const
+{
+	return options_[option]->NPV();
+}
+
+void LiveRepricer::NPVs(Size underlying,
+	Real * npvs) const
+{
+	const std::vector<Size> & options = underlyings_[underlying].options;
+	for (Size i = 0; i < options.size(); ++i)
+		npvs[i] = options_[options[i]]->NPV();
+}
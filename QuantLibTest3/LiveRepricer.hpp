@@ -0,0 +1,70 @@
+/* -*- mode: c++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+// QuantLib Black-Scholes-Merton test - live repricing on spot ticks
+
+#ifndef quantlibtest3_live_repricer_hpp
+#define quantlibtest3_live_repricer_hpp
+
+#include "OptionInputs.hpp"
+#include <vector>
+
+/** Keeps options alive between spot ticks.
+
+Each underlying holds the SimpleQuote behind its process and a
+single engine shared by the options written on it. A tick sets the
+quote; the notification travels through the process and the engine
+to the options of that underlying only, which the LazyObject
+machinery marks for recalculation. Nothing is rebuilt, and options
+on other underlyings keep their cached NPVs.
+*/
+class LiveRepricer
+{
+
+public:
+
+	LiveRepricer(const QuantLib::Date & settlementDate,
+		const QuantLib::Calendar & calendar);
+
+	// Add an underlying with the market of the given inputs
+	QuantLib::Size addUnderlying(const OptionInputs & market);
+
+	// Add a European option on an underlying; market fields are ignored
+	QuantLib::Size addOption(QuantLib::Size underlying,
+		const OptionInputs & in);
+
+	// Push a spot tick into an underlying's quote
+	void setSpot(QuantLib::Size underlying,
+		QuantLib::Real spot);
+
+	// NPV of one option, recalculated only if its inputs changed
+	QuantLib::Real NPV(QuantLib::Size option) const;
+
+	// NPVs of all the options on one underlying
+	void NPVs(QuantLib::Size underlying,
+		QuantLib::Real * npvs) const;
+
+	QuantLib::Size options(QuantLib::Size underlying) const
+	{
+		return underlyings_[underlying].options.size();
+	}
+
+	// Option recalculations since construction
+	QuantLib::Size recalculations() const { return *recalculations_; }
+
+private:
+
+	struct Underlying {
+		boost::shared_ptr<QuantLib::SimpleQuote> spot;
+		boost::shared_ptr<QuantLib::PricingEngine> engine;
+		std::vector<QuantLib::Size> options;
+	};
+
+	QuantLib::Date settlementDate_;
+	QuantLib::Calendar calendar_;
+	std::vector<Underlying> underlyings_;
+	std::vector<boost::shared_ptr<QuantLib::VanillaOption> > options_;
+	boost::shared_ptr<QuantLib::Size> recalculations_;
+
+};
+
+#endif
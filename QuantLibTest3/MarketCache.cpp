@@ -0,0 +1,129 @@
+/* -*- mode: c++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+// QuantLib Black-Scholes-Merton test - shared market objects
+
+#include "MarketCache.hpp"
+
+using namespace QuantLib;
+
+bool MarketCache::RateKey::operator<(const RateKey & other) const
+{
+	if (rate != other.rate)
+		return rate < other.rate;
+	return dayCounter < other.dayCounter;
+}
+
+bool MarketCache::MarketKey::operator<(const MarketKey & other) const
+{
+	if (underlying != other.underlying)
+		return underlying < other.underlying;
+	if (dividendYield != other.dividendYield)
+		return dividendYield < other.dividendYield;
+	if (riskFreeRate != other.riskFreeRate)
+		return riskFreeRate < other.riskFreeRate;
+	if (volatility != other.volatility)
+		return volatility < other.volatility;
+	return dayCounter < other.dayCounter;
+}
+
+MarketCache::MarketCache(const Date & settlementDate,
+	const Calendar & calendar,
+	Size maxMarkets) :
+	settlementDate_(settlementDate),
+	calendar_(calendar),
+	maxMarkets_(maxMarkets),
+	marketsBuilt_(0)
+{
+	QL_REQUIRE(maxMarkets > 0, "a market cache needs room for a market");
+}
+
+void MarketCache::clear()
+{
+	dayCounters_.clear();
+	quotes_.clear();
+	curves_.clear();
+	vols_.clear();
+	markets_.clear();
+}
+
+Size MarketCache::dayCounterKey(const DayCounter & dayCounter)
+{
+	for (Size i = 0; i < dayCounters_.size(); ++i)
+		if (dayCounters_[i] == dayCounter)
+			return i;
+	dayCounters_.push_back(dayCounter);
+	return dayCounters_.size() - 1;
+}
+
+Handle<Quote> MarketCache::quote(Real value)
+{
+	std::map<Real, Handle<Quote> >::iterator i = quotes_.find(value);
+	if (i == quotes_.end())
+		i = quotes_.insert(std::make_pair(value, Handle<Quote>(
+			boost::shared_ptr<Quote>(new SimpleQuote(value))))).first;
+	return i->second;
+}
+
+Handle<YieldTermStructure> MarketCache::flatCurve(Rate rate,
+	const DayCounter & dayCounter)
+{
+	RateKey key = { rate, dayCounterKey(dayCounter) };
+	std::map<RateKey, Handle<YieldTermStructure> >::iterator i = curves_.find(key);
+	if (i == curves_.end())
+		i = curves_.insert(std::make_pair(key, Handle<YieldTermStructure>(
+			boost::shared_ptr<YieldTermStructure>(
+			new FlatForward(settlementDate_, rate, dayCounter))))).first;
+	return i->second;
+}
+
+Handle<BlackVolTermStructure> MarketCache::flatVol(Volatility volatility,
+	const DayCounter & dayCounter)
+{
+	RateKey key = { volatility, dayCounterKey(dayCounter) };
+	std::map<RateKey, Handle<BlackVolTermStructure> >::iterator i = vols_.find(key);
+	if (i == vols_.end())
+		i = vols_.insert(std::make_pair(key, Handle<BlackVolTermStructure>(
+			boost::shared_ptr<BlackVolTermStructure>(
+			new BlackConstantVol(settlementDate_, calendar_, volatility,
+			dayCounter))))).first;
+	return i->second;
+}
+
+MarketCache::Market & MarketCache::market(const OptionInputs & in)
+{
+	MarketKey key = { in.underlying, in.dividendYield, in.riskFreeRate,
+		in.volatility, dayCounterKey(in.dayCounter) };
+	std::map<MarketKey, Market>::iterator i = markets_.find(key);
+	if (i == markets_.end()) {
+		if (markets_.size() == maxMarkets_) {
+			clear();
+			key.dayCounter = dayCounterKey(in.dayCounter);
+		}
+
+		Market m;
+		m.process = boost::shared_ptr<BlackScholesMertonProcess>(
+			new BlackScholesMertonProcess(quote(in.underlying),
+			flatCurve(in.dividendYield, in.dayCounter),
+			flatCurve(in.riskFreeRate, in.dayCounter),
+			flatVol(in.volatility, in.dayCounter)));
+		i = markets_.insert(std::make_pair(key, m)).first;
+		++marketsBuilt_;
+	}
+	return i->second;
+}
+
+const boost::shared_ptr<BlackScholesMertonProcess> & MarketCache::process(
+	const OptionInputs & in)
+{
+	return market(in).process;
+}
+
+const boost::shared_ptr<PricingEngine> & MarketCache::analyticEngine(
+	const OptionInputs & in)
+{
+	Market & m = market(in);
+	if (!m.engine)
+		m.engine = boost::shared_ptr<PricingEngine>(
+			new AnalyticEuropeanEngine(m.process));
+	return m.engine;
+}
@@ -0,0 +1,113 @@
+/* -*- mode: c++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+// QuantLib Black-Scholes-Merton test - shared market objects
+
+#ifndef quantlibtest3_market_cache_hpp
+#define quantlibtest3_market_cache_hpp
+
+#include "OptionInputs.hpp"
+
+#include <map>
+#include <vector>
+
+/** Interns the market objects of a book on one settlement date and
+calendar.
+
+Quotes are keyed by value, flat curves by rate and day counter (the
+risk-free and dividend curves share one map), flat volatilities by
+volatility and day counter, and processes and their analytic engines
+by the whole market of an option: underlying, dividend yield,
+risk-free rate, volatility and day counter. Each object is built the
+first time its key is asked for and handed out again afterwards, so
+a book on 50 underlyings builds 50 processes however its options are
+ordered.
+
+The cache holds at most maxMarkets markets. Building one more first
+empties it, quotes, curves and vols included, which each market adds
+at most four of; objects already handed out live on through their
+holders. Books with fewer markets than that intern all of them,
+while a long-lived cache fed a market per option, as a streamed file
+or a server may, stays bounded and rebuilds as the pricer did before
+interning.
+
+Objects are shared by everything keyed the same: setting the value
+of a quote moves every market on that spot. Day counters are kept in
+a short list and keyed by their position in it, which saves building
+their names on every lookup. A cache is not thread safe; use one per
+thread.
+*/
+class MarketCache
+{
+
+public:
+
+	MarketCache(const QuantLib::Date & settlementDate,
+		const QuantLib::Calendar & calendar,
+		QuantLib::Size maxMarkets = 4096);
+
+	QuantLib::Handle<QuantLib::Quote> quote(QuantLib::Real value);
+
+	QuantLib::Handle<QuantLib::YieldTermStructure> flatCurve(QuantLib::Rate rate,
+		const QuantLib::DayCounter & dayCounter);
+
+	QuantLib::Handle<QuantLib::BlackVolTermStructure> flatVol(
+		QuantLib::Volatility volatility,
+		const QuantLib::DayCounter & dayCounter);
+
+	// The Black-Scholes-Merton process of the option's market
+	const boost::shared_ptr<QuantLib::BlackScholesMertonProcess> & process(
+		const OptionInputs & in);
+
+	// An AnalyticEuropeanEngine on the option's market process
+	const boost::shared_ptr<QuantLib::PricingEngine> & analyticEngine(
+		const OptionInputs & in);
+
+	// Drop every object
+	void clear();
+
+	// Distinct objects held
+	QuantLib::Size quotes() const { return quotes_.size(); }
+	QuantLib::Size curves() const { return curves_.size(); }
+	QuantLib::Size vols() const { return vols_.size(); }
+	QuantLib::Size processes() const { return markets_.size(); }
+
+	// Markets built over the cache's life, counting those rebuilt
+	// after it was emptied
+	QuantLib::Size marketsBuilt() const { return marketsBuilt_; }
+
+private:
+
+	struct RateKey {
+		QuantLib::Real rate;
+		QuantLib::Size dayCounter;
+		bool operator<(const RateKey & other) const;
+	};
+
+	struct MarketKey {
+		QuantLib::Real underlying, dividendYield, riskFreeRate, volatility;
+		QuantLib::Size dayCounter;
+		bool operator<(const MarketKey & other) const;
+	};
+
+	struct Market {
+		boost::shared_ptr<QuantLib::BlackScholesMertonProcess> process;
+		boost::shared_ptr<QuantLib::PricingEngine> engine;
+	};
+
+	QuantLib::Size dayCounterKey(const QuantLib::DayCounter & dayCounter);
+	Market & market(const OptionInputs & in);
+
+	QuantLib::Date settlementDate_;
+	QuantLib::Calendar calendar_;
+	QuantLib::Size maxMarkets_;
+	QuantLib::Size marketsBuilt_;
+
+	std::vector<QuantLib::DayCounter> dayCounters_;
+	std::map<QuantLib::Real, QuantLib::Handle<QuantLib::Quote> > quotes_;
+	std::map<RateKey, QuantLib::Handle<QuantLib::YieldTermStructure> > curves_;
+	std::map<RateKey, QuantLib::Handle<QuantLib::BlackVolTermStructure> > vols_;
+	std::map<MarketKey, Market> markets_;
+
+};
+
+#endif
@@ -0,0 +1,402 @@
+/* -*- mode: c++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+// QuantLib Black-Scholes-Merton test - parallel Monte Carlo engine
+
+#include "MonteCarloEngine.hpp"
+#include "Philox.hpp"
+#include "VectorMath.hpp"
+
+#include <boost/scoped_ptr.hpp>
+
+#include <atomic>
+#include <exception>
+#include <functional>
+#include <thread>
+#include <vector>
+
+using namespace QuantLib;
+
+namespace {
+
+	// Sums over the samples of one block
+	struct BlockSums {
+		Real n, y, yy, x, xx, xy;
+	};
+
+	// Log-spot drift and standard deviation of every time step
+	struct PathGrid {
+		Real logSpot;
+		std::vector<Real> drift;
+		std::vector<Real> stdDev;
+	};
+
+	// Source of the standard normals driving a block of paths
+	class NormalGenerator
+	{
+
+	public:
+
+		virtual ~NormalGenerator() {}
+
+		/* Normals of paths [firstPath, firstPath + paths), one row
+		of paths per step
+		*/
+		virtual void generate(Size firstPath,
+			Size paths,
+			Real * z) = 0;
+
+	};
+
+	/* Draw (path, step) comes from Philox counter (path, step / 2)
+	and two of its four words. The uniforms of the block are mapped to
+	normals in one batch.
+	*/
+	class PhiloxNormals :
+		public NormalGenerator
+	{
+
+	public:
+
+		PhiloxNormals(BigNatural seed,
+			Size steps) :
+			rng_(seed),
+			steps_(steps)
+		{
+		}
+
+		void generate(Size firstPath,
+			Size paths,
+			Real * z)
+		{
+			for (Size p = 0; p < paths; ++p) {
+				boost::uint64_t path = firstPath + p;
+				for (Size s = 0; s < steps_; s += 2) {
+					Philox4x32::Block b = rng_(Philox4x32::word(path),
+						Philox4x32::word(path >> 32), Philox4x32::word(s / 2), 0);
+					z[s * paths + p] = Philox4x32::uniform(b.v[0], b.v[1]);
+					if (s + 1 < steps_)
+						z[(s + 1) * paths + p] = Philox4x32::uniform(b.v[2], b.v[3]);
+				}
+			}
+			BatchInverseNormalCdf(z, steps_ * paths, z);
+		}
+
+	private:
+
+		Philox4x32 rng_;
+		Size steps_;
+
+	};
+
+	/* Path i of replication r is Sobol point i digitally shifted by
+	Philox words keyed by the seed and indexed by (r, dimension), then
+	mapped to step normals through the Brownian bridge.
+	*/
+	class SobolNormals :
+		public NormalGenerator
+	{
+
+	public:
+
+		SobolNormals(BigNatural seed,
+			const BrownianBridge & bridge,
+			Size pathsPerReplication) :
+			rng_(seed),
+			bridge_(bridge),
+			pathsPerReplication_(pathsPerReplication),
+			sobol_(bridge.size()),
+			replication_(Size(-1)),
+			shifts_(bridge.size()),
+			points_(bridge.size()),
+			normals_(bridge.size())
+		{
+			// Past the precomputed first draw, so that skipTo() and
+			// nextInt32Sequence() always move in step
+			sobol_.nextInt32Sequence();
+		}
+
+		void generate(Size firstPath,
+			Size paths,
+			Real * z)
+		{
+			const Size steps = bridge_.size();
+
+			// Blocks never straddle replications
+			Size replication = firstPath / pathsPerReplication_;
+			if (replication != replication_) {
+				for (Size d = 0; d < steps; ++d)
+					shifts_[d] = rng_(Philox4x32::word(replication),
+					Philox4x32::word(d), 1, 0).v[0];
+				replication_ = replication;
+			}
+
+			// Path i of a replication is Sobol point i + 1, skipping
+			// the origin
+			const std::vector<unsigned long> * point =
+				&sobol_.skipTo((unsigned long)(firstPath % pathsPerReplication_));
+			for (Size p = 0; p < paths; ++p) {
+				if (p > 0)
+					point = &sobol_.nextInt32Sequence();
+				for (Size d = 0; d < steps; ++d)
+					z[d * paths + p] = ((Philox4x32::word((*point)[d]) ^ shifts_[d])
+					+ 0.5) * (1.0 / 4294967296.0);
+			}
+
+			// The whole block's uniforms to normals in one batch, then
+			// each path through the bridge in place
+			BatchInverseNormalCdf(z, steps * paths, z);
+			for (Size p = 0; p < paths; ++p) {
+				for (Size d = 0; d < steps; ++d)
+					points_[d] = z[d * paths + p];
+				bridge_.transform(points_.begin(), points_.end(), normals_.begin());
+				for (Size s = 0; s < steps; ++s)
+					z[s * paths + p] = normals_[s];
+			}
+		}
+
+	private:
+
+		Philox4x32 rng_;
+		const BrownianBridge & bridge_;
+		Size pathsPerReplication_;
+		SobolRsg sobol_;
+		Size replication_;
+		std::vector<Philox4x32::word> shifts_;
+		std::vector<Real> points_;
+		std::vector<Real> normals_;
+
+	};
+
+	// Terminal spots of the paths driven by sign * z
+	void TerminalSpots(const PathGrid & grid,
+		const Real * z,
+		Size paths,
+		Real sign,
+		Real * spots)
+	{
+		const Size steps = grid.drift.size();
+		for (Size p = 0; p < paths; ++p)
+			spots[p] = grid.logSpot;
+		for (Size s = 0; s < steps; ++s) {
+			const Real drift = grid.drift[s];
+			const Real stdDev = sign * grid.stdDev[s];
+			const Real * zs = z + s * paths;
+			for (Size p = 0; p < paths; ++p)
+				spots[p] += drift + stdDev * zs[p];
+		}
+		BatchExp(spots, paths, spots);
+	}
+
+}
+
+ParallelMcEuropeanEngine::ParallelMcEuropeanEngine(
+	const boost::shared_ptr<GeneralizedBlackScholesProcess> & process,
+	Size samples,
+	Size timeSteps,
+	bool antitheticVariate,
+	bool controlVariate,
+	Size threads,
+	BigNatural seed,
+	Sequence sequence) :
+	process_(process),
+	samples_(samples),
+	timeSteps_(timeSteps),
+	antitheticVariate_(antitheticVariate),
+	controlVariate_(controlVariate),
+	threads_(threads),
+	seed_(seed),
+	sequence_(sequence)
+{
+	QL_REQUIRE(samples_ > 1, "at least two samples are needed");
+	QL_REQUIRE(timeSteps_ > 0, "at least one time step is needed");
+
+	if (threads_ == 0)
+		threads_ = std::max<Size>(std::thread::hardware_concurrency(), 1);
+
+	registerWith(process_);
+}
+
+void ParallelMcEuropeanEngine::calculate() const
+{
+	QL_REQUIRE(arguments_.exercise->type() == Exercise::European,
+		"not an European option");
+
+	boost::shared_ptr<StrikedTypePayoff> payoff =
+		boost::dynamic_pointer_cast<StrikedTypePayoff>(arguments_.payoff);
+	QL_REQUIRE(payoff, "non-striked payoff given");
+
+	const Time maturity = process_->time(arguments_.exercise->lastDate());
+	QL_REQUIRE(maturity > 0.0, "option expired");
+
+	// Step drifts and deviations from the curves, at the strike
+	const Real spot = process_->x0();
+	const Real strike = payoff->strike();
+	PathGrid grid;
+	grid.logSpot = std::log(spot);
+	grid.drift.resize(timeSteps_);
+	grid.stdDev.resize(timeSteps_);
+	std::vector<Real> variances(timeSteps_);
+	bool increasing = true;
+
+	Time t0 = 0.0;
+	Real variance0 = 0.0;
+	DiscountFactor riskFree0 = 1.0, dividend0 = 1.0;
+	for (Size s = 0; s < timeSteps_; ++s) {
+		Time t1 = maturity * (s + 1) / timeSteps_;
+		Real variance1 = process_->blackVolatility()->blackVariance(t1, strike);
+		DiscountFactor riskFree1 = process_->riskFreeRate()->discount(t1);
+		DiscountFactor dividend1 = process_->dividendYield()->discount(t1);
+		Real variance = variance1 - variance0;
+		QL_REQUIRE(variance >= 0.0, "negative forward variance between "
+			<< t0 << " and " << t1);
+		grid.drift[s] = std::log(dividend1 / dividend0)
+			- std::log(riskFree1 / riskFree0) - 0.5 * variance;
+		grid.stdDev[s] = std::sqrt(variance);
+		variances[s] = variance1;
+		increasing = increasing && variance > 0.0;
+		t0 = t1;
+		variance0 = variance1;
+		riskFree0 = riskFree1;
+		dividend0 = dividend1;
+	}
+	const DiscountFactor discount = riskFree0;
+	const Real forward = spot * dividend0 / riskFree0;
+
+	// Sobol replications are whole numbers of blocks
+	Size samples = samples_;
+	Size pathsPerReplication = samples_;
+	if (sequence_ == Sobol) {
+		Size blocksPerReplication =
+			(samples_ + sobolReplications * blockSize - 1)
+			/ (sobolReplications * blockSize);
+		pathsPerReplication = blocksPerReplication * blockSize;
+		samples = sobolReplications * pathsPerReplication;
+	}
+
+	// The bridge runs on the variance grid when it is strictly
+	// increasing, otherwise on the time steps
+	boost::scoped_ptr<BrownianBridge> bridge;
+	if (sequence_ == Sobol)
+		bridge.reset(increasing
+		? new BrownianBridge(variances)
+		: new BrownianBridge(timeSteps_));
+
+	const Size blocks = (samples + blockSize - 1) / blockSize;
+	const Size workers = std::max<Size>(std::min(threads_, blocks), 1);
+	const StrikedTypePayoff & f = *payoff;
+
+	std::vector<BlockSums> sums(blocks);
+	std::atomic<Size> next(0);
+	std::vector<std::exception_ptr> errors(workers);
+
+	std::function<void(Size)> work = [&](Size w) {
+		try {
+			boost::scoped_ptr<NormalGenerator> normals(sequence_ == Sobol
+				? static_cast<NormalGenerator *>(
+				new SobolNormals(seed_, *bridge, pathsPerReplication))
+				: new PhiloxNormals(seed_, timeSteps_));
+			std::vector<Real> z(blockSize * timeSteps_);
+			std::vector<Real> up(blockSize), down(blockSize);
+
+			for (Size b = next++; b < blocks; b = next++) {
+				Size first = b * blockSize;
+				Size paths = std::min<Size>(blockSize, samples - first);
+
+				normals->generate(first, paths, &z[0]);
+				TerminalSpots(grid, &z[0], paths, 1.0, &up[0]);
+				if (antitheticVariate_)
+					TerminalSpots(grid, &z[0], paths, -1.0, &down[0]);
+
+				BlockSums s = { Real(paths), 0.0, 0.0, 0.0, 0.0, 0.0 };
+				for (Size p = 0; p < paths; ++p) {
+					Real x = up[p], y = f(up[p]);
+					if (antitheticVariate_) {
+						x = 0.5 * (x + down[p]);
+						y = 0.5 * (y + f(down[p]));
+					}
+					x -= forward;
+					s.y += y;
+					s.yy += y * y;
+					s.x += x;
+					s.xx += x * x;
+					s.xy += x * y;
+				}
+				sums[b] = s;
+			}
+		}
+		catch (...) {
+			errors[w] = std::current_exception();
+		}
+	};
+
+	std::vector<std::thread> pool;
+	for (Size w = 1; w < workers; ++w)
+		pool.push_back(std::thread(work, w));
+
+	// The calling thread is worker 0
+	work(0);
+
+	for (Size w = 0; w < pool.size(); ++w)
+		pool[w].join();
+
+	for (Size w = 0; w < workers; ++w)
+		if (errors[w])
+			std::rethrow_exception(errors[w]);
+
+	// Combine in block order, whatever thread computed each block
+	BlockSums total = { 0.0, 0.0, 0.0, 0.0, 0.0, 0.0 };
+	for (Size b = 0; b < blocks; ++b) {
+		total.n += sums[b].n;
+		total.y += sums[b].y;
+		total.yy += sums[b].yy;
+		total.x += sums[b].x;
+		total.xx += sums[b].xx;
+		total.xy += sums[b].xy;
+	}
+
+	const Real n = total.n;
+	Real mean = total.y / n;
+	Real variance = (total.yy - n * mean * mean) / (n - 1.0);
+	Real meanX = total.x / n;
+	Real beta = 0.0;
+
+	if (controlVariate_) {
+		// The control x = S(T) - forward has zero mean
+		Real varianceX = (total.xx - n * meanX * meanX) / (n - 1.0);
+		Real covariance = (total.xy - n * meanX * mean) / (n - 1.0);
+		if (varianceX > 0.0) {
+			beta = covariance / varianceX;
+			mean -= beta * meanX;
+			variance -= beta * covariance;
+		}
+	}
+
+	Real error = std::sqrt(std::max(variance, 0.0) / n);
+
+	if (sequence_ == Sobol) {
+		// Quasi-random points are not independent: the error comes
+		// from the spread of the replication estimates
+		const Size blocksPerReplication = pathsPerReplication / blockSize;
+		Real sum = 0.0, sumSquares = 0.0;
+		for (Size r = 0; r < sobolReplications; ++r) {
+			BlockSums replication = { 0.0, 0.0, 0.0, 0.0, 0.0, 0.0 };
+			for (Size b = r * blocksPerReplication;
+				b < (r + 1) * blocksPerReplication; ++b) {
+				replication.n += sums[b].n;
+				replication.y += sums[b].y;
+				replication.x += sums[b].x;
+			}
+			Real estimate = (replication.y - beta * replication.x) / replication.n;
+			sum += estimate;
+			sumSquares += estimate * estimate;
+		}
+		const Real m = sobolReplications;
+		Real spread = (sumSquares - sum * sum / m) / (m - 1.0);
+		error = std::sqrt(std::max(spread, 0.0) / m);
+	}
+
+	results_.value = discount * mean;
+	results_.errorEstimate = discount * error;
+	results_.additionalResults["paths"] =
+		Real(antitheticVariate_ ? 2 * samples : samples);
+}
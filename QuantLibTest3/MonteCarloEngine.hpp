@@ -0,0 +1,77 @@
+/* -*- mode: c++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+// QuantLib Black-Scholes-Merton test - parallel Monte Carlo engine
+
+#ifndef quantlibtest3_monte_carlo_engine_hpp
+#define quantlibtest3_monte_carlo_engine_hpp
+
+#include <ql/quantlib.hpp>
+
+/** Monte Carlo engine for European options on a Black-Scholes process.
+
+Paths of log(S) are simulated over timeSteps equal steps with the
+exact lognormal transition between the process's curves and vol at
+the option's strike, and the payoff is applied to the terminal value,
+so any StrikedTypePayoff can be priced.
+
+Paths are generated in fixed blocks, spread over the threads, from a
+Philox counter-based generator keyed by the seed and indexed by path
+and step. Block sums are combined in block order, so the price and
+error are bit-for-bit the same at any thread count.
+
+samples counts independent draws; with antitheticVariate each is a
+pair of mirrored paths. With controlVariate the terminal spot, whose
+expectation is the forward, is used as control with the regression
+coefficient estimated from the same paths.
+
+With the Sobol sequence the normals come instead from Sobol points
+(QuantLib's SobolRsg, one dimension per time step) through a
+Brownian bridge built on the variance grid, so the first and best
+distributed dimension sets the terminal value. The points are
+randomized by Philox-drawn digital shifts in independent
+replications, whose spread gives the error estimate; samples are
+rounded up to whole blocks per replication.
+
+Besides value and errorEstimate the results carry "paths", the
+number of paths simulated, as an additional result.
+*/
+class ParallelMcEuropeanEngine :
+	public QuantLib::VanillaOption::engine
+{
+
+public:
+
+	enum Sequence { PseudoRandom, Sobol };
+
+	ParallelMcEuropeanEngine(
+		const boost::shared_ptr<QuantLib::GeneralizedBlackScholesProcess> & process,
+		QuantLib::Size samples,
+		QuantLib::Size timeSteps = 1,
+		bool antitheticVariate = true,
+		bool controlVariate = true,
+		QuantLib::Size threads = 0,
+		QuantLib::BigNatural seed = 42,
+		Sequence sequence = PseudoRandom);
+
+	void calculate() const;
+
+	// Paths per block, the unit of work shared between threads
+	enum { blockSize = 1024 };
+
+	// Independently shifted Sobol replications behind the error estimate
+	enum { sobolReplications = 16 };
+
+private:
+
+	boost::shared_ptr<QuantLib::GeneralizedBlackScholesProcess> process_;
+	QuantLib::Size samples_;
+	QuantLib::Size timeSteps_;
+	bool antitheticVariate_;
+	bool controlVariate_;
+	QuantLib::Size threads_;
+	QuantLib::BigNatural seed_;
+	Sequence sequence_;
+
+};
+
+#endif
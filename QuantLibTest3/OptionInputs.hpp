@@ -0,0 +1,22 @@
+/* -*- mode: c++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+// QuantLib Black-Scholes-Merton test - option input data
+
+#ifndef quantlibtest3_option_inputs_hpp
+#define quantlibtest3_option_inputs_hpp
+
+#include <ql/quantlib.hpp>
+
+// Input data
+struct OptionInputs {
+	QuantLib::Option::Type type;
+	QuantLib::Real underlying;
+	QuantLib::Real strike;
+	QuantLib::Spread dividendYield;
+	QuantLib::Rate riskFreeRate;
+	QuantLib::Volatility volatility;
+	QuantLib::Date maturity;
+	QuantLib::DayCounter dayCounter;
+};
+
+#endif
@@ -0,0 +1,157 @@
+/* -*- mode: c++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+// QuantLib Black-Scholes-Merton test - multithreaded book pricing
+
+#include "ParallelPricer.hpp"
+#include "BatchPricer.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace QuantLib;
+
+#if defined(QL_ENABLE_SESSIONS)
+namespace QuantLib {
+
+	// Every thread is its own session, so each worker gets its own Settings
+	Integer sessionId()
+	{
+		return Integer(std::hash<std::thread::id>()(std::this_thread::get_id()));
+	}
+
+}
+#endif
+
+namespace {
+
+	// Chunks owned by one worker; the owner pops from the front and
+	// thieves take from the back
+	class ChunkQueue
+	{
+
+	public:
+
+		void push(Size chunk)
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			chunks_.push_back(chunk);
+		}
+
+		bool pop(Size & chunk)
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			if (chunks_.empty())
+				return false;
+			chunk = chunks_.front();
+			chunks_.pop_front();
+			return true;
+		}
+
+		bool steal(Size & chunk)
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			if (chunks_.empty())
+				return false;
+			chunk = chunks_.back();
+			chunks_.pop_back();
+			return true;
+		}
+
+	private:
+
+		std::mutex mutex_;
+		std::deque<Size> chunks_;
+
+	};
+
+}
+
+ParallelPricer::ParallelPricer(const Date & evaluationDate,
+	const Date & settlementDate,
+	const Calendar & calendar,
+	Size threads,
+	Size chunkSize) :
+	evaluationDate_(evaluationDate),
+	settlementDate_(settlementDate),
+	calendar_(calendar),
+	threads_(threads),
+	chunkSize_(chunkSize),
+	stolenChunks_(0)
+{
+	QL_REQUIRE(chunkSize_ > 0, "chunk size must be positive");
+
+	if (threads_ == 0)
+		threads_ = std::max<Size>(std::thread::hardware_concurrency(), 1);
+}
+
+void ParallelPricer::price(const OptionInputs * inputs,
+	Size n,
+	Real * npvs)
+{
+	const Size chunks = (n + chunkSize_ - 1) / chunkSize_;
+	const Size workers = std::max<Size>(std::min(threads_, chunks), 1);
+
+#if !defined(QL_ENABLE_SESSIONS)
+	// One global evaluation date, written before any worker reads it
+	Settings::instance().evaluationDate() = evaluationDate_;
+#endif
+
+	// Deal the chunks out in contiguous runs
+	std::vector<ChunkQueue> queues(workers);
+	for (Size w = 0; w < workers; ++w)
+		for (Size c = w * chunks / workers; c < (w + 1) * chunks / workers; ++c)
+			queues[w].push(c);
+
+	std::atomic<Size> stolen(0);
+	std::vector<std::exception_ptr> errors(workers);
+
+	std::function<void(Size)> work = [&](Size w) {
+		try {
+#if defined(QL_ENABLE_SESSIONS)
+			Settings::instance().evaluationDate() = evaluationDate_;
+#endif
+			BatchPricer pricer(settlementDate_, calendar_);
+
+			Size chunk;
+			for (;;) {
+				if (!queues[w].pop(chunk)) {
+					bool found = false;
+					for (Size k = 1; k < workers && !found; ++k)
+						found = queues[(w + k) % workers].steal(chunk);
+					if (!found)
+						break;
+					++stolen;
+				}
+
+				Size begin = chunk * chunkSize_;
+				Size end = std::min(begin + chunkSize_, n);
+				pricer.price(inputs + begin, end - begin, npvs + begin);
+			}
+		}
+		catch (...) {
+			errors[w] = std::current_exception();
+		}
+	};
+
+	std::vector<std::thread> pool;
+	for (Size w = 1; w < workers; ++w)
+		pool.push_back(std::thread(work, w));
+
+	// The calling thread is worker 0
+	work(0);
+
+	for (Size w = 0; w < pool.size(); ++w)
+		pool[w].join();
+
+	stolenChunks_ = stolen;
+
+	for (Size w = 0; w < workers; ++w)
+		if (errors[w])
+			std::rethrow_exception(errors[w]);
+}
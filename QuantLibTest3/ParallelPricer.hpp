@@ -0,0 +1,58 @@
+/* -*- mode: c++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+// QuantLib Black-Scholes-Merton test - multithreaded book pricing
+
+#ifndef quantlibtest3_parallel_pricer_hpp
+#define quantlibtest3_parallel_pricer_hpp
+
+#include "OptionInputs.hpp"
+
+/** Prices a book of options on several threads.
+
+The book is split into fixed-size chunks that are dealt out to the
+workers in contiguous runs. A worker takes chunks from the front of
+its own queue and, once that is empty, steals from the back of the
+other workers' queues, so threads that hit cheap chunks pick up the
+slack of slower ones.
+
+Every worker owns its own BatchPricer and so its own quotes, curves,
+processes and engines; nothing that registers observers is shared
+between threads. When QuantLib is built with QL_ENABLE_SESSIONS each
+worker thread is a separate session and sets its own evaluation
+date; otherwise the date is set once by the calling thread before
+the workers start and is only read by them.
+*/
+class ParallelPricer
+{
+
+public:
+
+	// threads == 0 uses one worker per hardware thread
+	ParallelPricer(const QuantLib::Date & evaluationDate,
+		const QuantLib::Date & settlementDate,
+		const QuantLib::Calendar & calendar,
+		QuantLib::Size threads = 0,
+		QuantLib::Size chunkSize = 1024);
+
+	// Price n options from inputs into npvs[0..n)
+	void price(const OptionInputs * inputs,
+		QuantLib::Size n,
+		QuantLib::Real * npvs);
+
+	QuantLib::Size threads() const { return threads_; }
+
+	// Chunks taken from another worker's queue in the last price() call
+	QuantLib::Size stolenChunks() const { return stolenChunks_; }
+
+private:
+
+	QuantLib::Date evaluationDate_;
+	QuantLib::Date settlementDate_;
+	QuantLib::Calendar calendar_;
+	QuantLib::Size threads_;
+	QuantLib::Size chunkSize_;
+	QuantLib::Size stolenChunks_;
+
+};
+
+#endif
@@ -0,0 +1,138 @@
+/* -*- mode: c++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+// QuantLib Black-Scholes-Merton test - closed-form kernel specialized on type and payoff
+
+#include "PayoffKernel.hpp"
+#include "BlackScholesTerms.hpp"
+
+using namespace QuantLib;
+
+namespace {
+
+	// phi N(phi x) times the legs' discounted amounts, given the
+	// distributions the payoff needs
+	template <class V>
+	inline typename V::reg Value(const payoff::PlainVanilla &,
+		typename V::reg phi,
+		typename V::reg discountedSpot,
+		typename V::reg discountedStrike,
+		typename V::reg,
+		typename V::reg nd1,
+		typename V::reg nd2)
+	{
+		return V::mul(phi, V::sub(V::mul(discountedSpot, nd1),
+			V::mul(discountedStrike, nd2)));
+	}
+
+	template <class V>
+	inline typename V::reg Value(const payoff::CashOrNothing & payoff,
+		typename V::reg,
+		typename V::reg,
+		typename V::reg,
+		typename V::reg riskFreeDiscount,
+		typename V::reg,
+		typename V::reg nd2)
+	{
+		return V::mul(V::mul(V::set1(payoff.cash), riskFreeDiscount), nd2);
+	}
+
+	template <class V>
+	inline typename V::reg Value(const payoff::AssetOrNothing &,
+		typename V::reg,
+		typename V::reg discountedSpot,
+		typename V::reg,
+		typename V::reg,
+		typename V::reg nd1,
+		typename V::reg)
+	{
+		return V::mul(discountedSpot, nd1);
+	}
+
+	// Price V::width options starting at i. phi and the payoff's legs
+	// are constants of the instantiation, so the multiplications by
+	// phi fold and the unused distribution is never computed.
+	template <class V, Option::Type Type, class Payoff>
+	inline void PayoffBlock(const OptionArrays & in,
+		Size i,
+		const Payoff & payoff,
+		Real * npvs)
+	{
+		typedef typename V::reg reg;
+
+		BlackScholesTerms<V> terms(in, i, V::set1(Real(Type)));
+		reg nd1 = V::set1(0.0), nd2 = V::set1(0.0);
+		if (Payoff::assetLeg)
+			nd1 = terms.probability(terms.d1);
+		if (Payoff::cashLeg)
+			nd2 = terms.probability(terms.d2);
+
+		V::store(npvs + i, terms.unlessExpired(Value<V>(payoff, terms.phi,
+			terms.discountedSpot, terms.discountedStrike, terms.riskFreeDiscount,
+			nd1, nd2)));
+	}
+
+}
+
+template <Option::Type Type, class Payoff>
+void BlackScholesKernel(const OptionArrays & in,
+	Size first,
+	Size n,
+	const Payoff & payoff,
+	Real * npvs)
+{
+	typedef simd::Native V;
+
+	QL_REQUIRE(first + n <= in.size(),
+		"options [" << first << ", " << first + n << ") beyond the "
+		<< in.size() << " in the arrays");
+
+	const Size end = first + n;
+	Size i = first;
+
+	for (; i + V::width <= end; i += V::width)
+		PayoffBlock<V, Type>(in, i, payoff, npvs);
+
+	for (; i < end; ++i)
+		PayoffBlock<simd::Scalar, Type>(in, i, payoff, npvs);
+}
+
+template <class Payoff>
+void BlackScholesKernel(const OptionArrays & in,
+	const Payoff & payoff,
+	Real * npvs)
+{
+	const Size n = in.size();
+	Size first = 0;
+	while (first < n) {
+		const Real phi = in.phi[first];
+		Size end = first + 1;
+		while (end < n && in.phi[end] == phi)
+			++end;
+
+		if (phi > 0.0)
+			BlackScholesKernel<Option::Call>(in, first, end - first, payoff, npvs);
+		else
+			BlackScholesKernel<Option::Put>(in, first, end - first, payoff, npvs);
+		first = end;
+	}
+}
+
+template void BlackScholesKernel<Option::Call>(const OptionArrays &, Size, Size,
+	const payoff::PlainVanilla &, Real *);
+template void BlackScholesKernel<Option::Put>(const OptionArrays &, Size, Size,
+	const payoff::PlainVanilla &, Real *);
+template void BlackScholesKernel<Option::Call>(const OptionArrays &, Size, Size,
+	const payoff::CashOrNothing &, Real *);
+template void BlackScholesKernel<Option::Put>(const OptionArrays &, Size, Size,
+	const payoff::CashOrNothing &, Real *);
+template void BlackScholesKernel<Option::Call>(const OptionArrays &, Size, Size,
+	const payoff::AssetOrNothing &, Real *);
+template void BlackScholesKernel<Option::Put>(const OptionArrays &, Size, Size,
+	const payoff::AssetOrNothing &, Real *);
+
+template void BlackScholesKernel(const OptionArrays &,
+	const payoff::PlainVanilla &, Real *);
+template void BlackScholesKernel(const OptionArrays &,
+	const payoff::CashOrNothing &, Real *);
+template void BlackScholesKernel(const OptionArrays &,
+	const payoff::AssetOrNothing &, Real *);
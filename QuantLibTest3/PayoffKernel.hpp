@@ -0,0 +1,58 @@
+/* -*- mode: c++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+// QuantLib Black-Scholes-Merton test - closed-form kernel specialized on type and payoff
+
+#ifndef quantlibtest3_payoff_kernel_hpp
+#define quantlibtest3_payoff_kernel_hpp
+
+#include "BlackScholesKernel.hpp"
+
+/* Payoff kinds of the specialized kernel, standing in for QuantLib's
+PlainVanillaPayoff, CashOrNothingPayoff and AssetOrNothingPayoff
+without their virtual calls. assetLeg and cashLeg say which of
+N(phi d1) and N(phi d2) the price needs.
+*/
+namespace payoff {
+
+	struct PlainVanilla {
+		enum { assetLeg = 1, cashLeg = 1 };
+	};
+
+	struct CashOrNothing {
+		enum { assetLeg = 0, cashLeg = 1 };
+		QuantLib::Real cash;
+	};
+
+	struct AssetOrNothing {
+		enum { assetLeg = 1, cashLeg = 0 };
+	};
+
+}
+
+/* Black-Scholes-Merton prices of options [first, first + n) of the
+arrays, all of them of the given type and payoff; their phi is not
+read. The type and payoff are template parameters, so each
+instantiation is a straight-line loop with no per-option branching
+on either, and the digital payoffs skip the distribution they don't
+need. Instantiated for Option::Call and Option::Put with each payoff
+kind.
+*/
+template <QuantLib::Option::Type Type, class Payoff>
+void BlackScholesKernel(const OptionArrays & in,
+	QuantLib::Size first,
+	QuantLib::Size n,
+	const Payoff & payoff,
+	QuantLib::Real * npvs);
+
+/* Prices of every option in the arrays with the given payoff, written
+to npvs[0..size). The options are split into runs of consecutive
+calls and puts and each run goes to the matching instantiation
+above, so books grouped by type dispatch a handful of times rather
+than once per option. Instantiated for each payoff kind.
+*/
+template <class Payoff>
+void BlackScholesKernel(const OptionArrays & in,
+	const Payoff & payoff,
+	QuantLib::Real * npvs);
+
+#endif
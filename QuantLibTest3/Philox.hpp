@@ -0,0 +1,71 @@
+/* -*- mode: c++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+// QuantLib Black-Scholes-Merton test - counter-based random numbers
+
+#ifndef quantlibtest3_philox_hpp
+#define quantlibtest3_philox_hpp
+
+#include <boost/cstdint.hpp>
+
+/** Philox4x32-10 counter-based generator.
+
+From J. Salmon et al., "Parallel random numbers: as easy as 1, 2,
+3" (SC11). The output is a pure function of a 128-bit counter and a
+64-bit key, so any draw can be computed directly from its indices:
+simulations give the same numbers whatever the number of threads
+and whichever thread handles which paths.
+*/
+class Philox4x32
+{
+
+public:
+
+	typedef boost::uint32_t word;
+
+	struct Block {
+		word v[4];
+	};
+
+	explicit Philox4x32(boost::uint64_t seed) :
+		key0_(word(seed)),
+		key1_(word(seed >> 32))
+	{
+	}
+
+	// Four random words for the counter (c0, c1, c2, c3)
+	Block operator()(word c0, word c1, word c2, word c3) const
+	{
+		Block x = { { c0, c1, c2, c3 } };
+		word k0 = key0_, k1 = key1_;
+		for (int round = 0; round < 10; ++round) {
+			if (round > 0) {
+				k0 += 0x9E3779B9;
+				k1 += 0xBB67AE85;
+			}
+			boost::uint64_t p0 = boost::uint64_t(0xD2511F53) * x.v[0];
+			boost::uint64_t p1 = boost::uint64_t(0xCD9E8D57) * x.v[2];
+			word y0 = word(p1 >> 32) ^ x.v[1] ^ k0;
+			word y2 = word(p0 >> 32) ^ x.v[3] ^ k1;
+			x.v[1] = word(p1);
+			x.v[3] = word(p0);
+			x.v[0] = y0;
+			x.v[2] = y2;
+		}
+		return x;
+	}
+
+	// Uniform in (0, 1) with 53 random bits from two words
+	static double uniform(word lo, word hi)
+	{
+		boost::uint64_t bits = (boost::uint64_t(hi) << 32 | lo) >> 11;
+		return (bits + 0.5) * (1.0 / 9007199254740992.0);
+	}
+
+private:
+
+	word key0_;
+	word key1_;
+
+};
+
+#endif
@@ -0,0 +1,509 @@
+/* -*- mode: c++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+// QuantLib Black-Scholes-Merton test - streaming portfolio input
+
+#include "PortfolioLoader.hpp"
+#include "CsvParsing.hpp"
+
+#include <boost/static_assert.hpp>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <exception>
+#include <iomanip>
+#include <limits>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace QuantLib;
+
+BOOST_STATIC_ASSERT(sizeof(OptionRecord) == 48);
+
+namespace {
+
+	const char binaryMagic[8] = { 'Q', 'L', 'O', 'P', 'T', 'V', '0', '1' };
+	const Size binaryHeaderSize = 16;
+
+	// Day counters that can be named in a portfolio file
+	const DayCounter supportedDayCounters[] = {
+		Actual365Fixed(), Actual360(), Thirty360(), ActualActual()
+	};
+
+	Size DayCounterIndex(const DayCounter & dayCounter)
+	{
+		for (Size i = 0; i < LENGTH(supportedDayCounters); ++i)
+			if (supportedDayCounters[i] == dayCounter)
+				return i;
+		QL_FAIL("unsupported day counter " << dayCounter);
+	}
+
+	const DayCounter & DayCounterByName(const char * begin, const char * end)
+	{
+		for (Size i = 0; i < LENGTH(supportedDayCounters); ++i) {
+			const std::string & name = supportedDayCounters[i].name();
+			if (name.size() == Size(end - begin)
+				&& std::equal(name.begin(), name.end(), begin))
+				return supportedDayCounters[i];
+		}
+		QL_FAIL("unsupported day counter " << std::string(begin, end));
+	}
+
+	// Split a CSV line in place; returns the number of fields, or
+	// maxFields + 1 if there are more
+	Size SplitFields(std::string & line,
+		const char * fields[],
+		const char * ends[],
+		Size maxFields)
+	{
+		Size n = 0;
+		char * p = &line[0];
+		char * end = p + line.size();
+		for (;;) {
+			if (n == maxFields)
+				return maxFields + 1;
+			fields[n] = p;
+			while (p != end && *p != ',' && *p != '\r')
+				++p;
+			ends[n++] = p;
+			if (p == end || *p == '\r')
+				break;
+			*p++ = '\0';
+		}
+		if (ends[n - 1] != end)
+			*const_cast<char *>(ends[n - 1]) = '\0';
+		return n;
+	}
+
+	Option::Type ParseType(const char * field, Size lineNumber)
+	{
+		if (std::strcmp(field, "Call") == 0 || std::strcmp(field, "C") == 0)
+			return Option::Call;
+		if (std::strcmp(field, "Put") == 0 || std::strcmp(field, "P") == 0)
+			return Option::Put;
+		QL_FAIL("invalid option type '" << field << "' on line " << lineNumber);
+	}
+
+}
+
+// CSV
+
+CsvPortfolioReader::CsvPortfolioReader(const std::string & path) :
+	file_(path.c_str()),
+	stream_(file_),
+	lineNumber_(1)
+{
+	QL_REQUIRE(file_, "cannot open " << path);
+
+	// Skip the header
+	std::getline(stream_, line_);
+}
+
+CsvPortfolioReader::CsvPortfolioReader(std::istream & stream) :
+	stream_(stream),
+	lineNumber_(1)
+{
+	std::getline(stream_, line_);
+}
+
+Size CsvPortfolioReader::read(OptionInputs * out,
+	Size maxOptions)
+{
+	const Size fieldCount = 8;
+	const char * fields[fieldCount];
+	const char * ends[fieldCount];
+
+	Size n = 0;
+	while (n < maxOptions && std::getline(stream_, line_)) {
+		++lineNumber_;
+		if (line_.empty() || line_[0] == '\r')
+			continue;
+
+		QL_REQUIRE(SplitFields(line_, fields, ends, fieldCount) == fieldCount,
+			"expected " << fieldCount << " fields on line " << lineNumber_);
+
+		OptionInputs & in = out[n++];
+		in.type = ParseType(fields[0], lineNumber_);
+		in.underlying = ParseReal(fields[1], lineNumber_);
+		in.strike = ParseReal(fields[2], lineNumber_);
+		in.dividendYield = ParseReal(fields[3], lineNumber_);
+		in.riskFreeRate = ParseReal(fields[4], lineNumber_);
+		in.volatility = ParseReal(fields[5], lineNumber_);
+		in.maturity = ParseIsoDate(fields[6], lineNumber_);
+		in.dayCounter = DayCounterByName(fields[7], ends[7]);
+	}
+	return n;
+}
+
+void WritePortfolioCsv(const std::string & path,
+	const OptionInputs * inputs,
+	Size n)
+{
+	std::ofstream file(path.c_str());
+	QL_REQUIRE(file, "cannot create " << path);
+
+	file << "type,underlying,strike,dividendYield,riskFreeRate,"
+		<< "volatility,maturity,dayCounter\n";
+	file << std::setprecision(17);
+
+	for (Size i = 0; i < n; ++i) {
+		const OptionInputs & in = inputs[i];
+		DayCounterIndex(in.dayCounter);
+		file << (in.type == Option::Call ? "Call" : "Put") << ','
+			<< in.underlying << ','
+			<< in.strike << ','
+			<< in.dividendYield << ','
+			<< in.riskFreeRate << ','
+			<< in.volatility << ','
+			<< in.maturity.year() << '-'
+			<< std::setw(2) << std::setfill('0') << int(in.maturity.month()) << '-'
+			<< std::setw(2) << in.maturity.dayOfMonth() << std::setfill(' ') << ','
+			<< in.dayCounter.name() << '\n';
+	}
+
+	QL_REQUIRE(file, "error writing " << path);
+}
+
+// Binary
+
+// Read-only file with one mapped window at a time
+class BinaryPortfolioReader::MappedFile
+{
+
+public:
+
+	explicit MappedFile(const std::string & path) :
+		view_(0),
+		viewSize_(0)
+	{
+#if defined(_WIN32)
+		file_ = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, 0,
+			OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, 0);
+		QL_REQUIRE(file_ != INVALID_HANDLE_VALUE, "cannot open " << path);
+		LARGE_INTEGER size;
+		if (!GetFileSizeEx(file_, &size)) {
+			CloseHandle(file_);
+			QL_FAIL("cannot get the size of " << path);
+		}
+		size_ = size.QuadPart;
+		mapping_ = CreateFileMappingA(file_, 0, PAGE_READONLY, 0, 0, 0);
+		if (mapping_ == 0) {
+			CloseHandle(file_);
+			QL_FAIL("cannot map " << path);
+		}
+		SYSTEM_INFO info;
+		GetSystemInfo(&info);
+		granularity_ = info.dwAllocationGranularity;
+#else
+		fd_ = ::open(path.c_str(), O_RDONLY);
+		QL_REQUIRE(fd_ >= 0, "cannot open " << path);
+		struct stat st;
+		if (::fstat(fd_, &st) != 0) {
+			::close(fd_);
+			QL_FAIL("cannot get the size of " << path);
+		}
+		size_ = st.st_size;
+		granularity_ = ::sysconf(_SC_PAGESIZE);
+#endif
+	}
+
+	~MappedFile()
+	{
+		unmap();
+#if defined(_WIN32)
+		CloseHandle(mapping_);
+		CloseHandle(file_);
+#else
+		::close(fd_);
+#endif
+	}
+
+	boost::uint64_t size() const { return size_; }
+
+	// Map [offset, offset + length) and return a pointer to offset
+	const char * view(boost::uint64_t offset, Size length)
+	{
+		unmap();
+
+		boost::uint64_t base = offset - offset % granularity_;
+		viewSize_ = Size(offset - base) + length;
+#if defined(_WIN32)
+		view_ = MapViewOfFile(mapping_, FILE_MAP_READ,
+			DWORD(base >> 32), DWORD(base & 0xffffffff), viewSize_);
+		QL_REQUIRE(view_ != 0, "cannot map view at " << base);
+#else
+		view_ = ::mmap(0, viewSize_, PROT_READ, MAP_PRIVATE, fd_, off_t(base));
+		QL_REQUIRE(view_ != MAP_FAILED, "cannot map view at " << base);
+		::madvise(view_, viewSize_, MADV_SEQUENTIAL);
+#endif
+		return static_cast<const char *>(view_) + (offset - base);
+	}
+
+private:
+
+	void unmap()
+	{
+		if (view_ == 0)
+			return;
+#if defined(_WIN32)
+		UnmapViewOfFile(view_);
+#else
+		::munmap(view_, viewSize_);
+#endif
+		view_ = 0;
+	}
+
+#if defined(_WIN32)
+	HANDLE file_;
+	HANDLE mapping_;
+#else
+	int fd_;
+#endif
+	boost::uint64_t size_;
+	boost::uint64_t granularity_;
+	void * view_;
+	Size viewSize_;
+
+};
+
+BinaryPortfolioReader::BinaryPortfolioReader(const std::string & path) :
+	file_(new MappedFile(path)),
+	count_(0),
+	position_(0)
+{
+	try {
+		QL_REQUIRE(file_->size() >= binaryHeaderSize,
+			path << " is too short for a portfolio header");
+
+		const char * header = file_->view(0, binaryHeaderSize);
+		QL_REQUIRE(std::memcmp(header, binaryMagic, sizeof(binaryMagic)) == 0,
+			path << " is not a binary portfolio");
+
+		// Against the file size by division, as count * sizeof(OptionRecord)
+		// can wrap around for a corrupt count
+		boost::uint64_t count;
+		std::memcpy(&count, header + sizeof(binaryMagic), sizeof(count));
+		const boost::uint64_t recordBytes = file_->size() - binaryHeaderSize;
+		QL_REQUIRE(recordBytes % sizeof(OptionRecord) == 0
+			&& count == recordBytes / sizeof(OptionRecord),
+			path << " holds " << recordBytes / sizeof(OptionRecord)
+			<< " options but its header gives " << count);
+		QL_REQUIRE(count <= std::numeric_limits<Size>::max(),
+			path << " has too many options for this platform");
+		count_ = Size(count);
+	}
+	catch (...) {
+		delete file_;
+		throw;
+	}
+}
+
+BinaryPortfolioReader::~BinaryPortfolioReader()
+{
+	delete file_;
+}
+
+Size BinaryPortfolioReader::read(OptionInputs * out,
+	Size maxOptions)
+{
+	Size n = std::min(maxOptions, count_ - position_);
+	if (n == 0)
+		return 0;
+
+	const char * records = file_->view(
+		binaryHeaderSize + boost::uint64_t(position_) * sizeof(OptionRecord),
+		n * sizeof(OptionRecord));
+
+	for (Size i = 0; i < n; ++i) {
+		OptionRecord record;
+		std::memcpy(&record, records + i * sizeof(OptionRecord), sizeof(record));
+
+		QL_REQUIRE(record.dayCounter < LENGTH(supportedDayCounters),
+			"invalid day counter in record " << position_ + i);
+
+		OptionInputs & in = out[i];
+		in.type = record.type > 0 ? Option::Call : Option::Put;
+		in.underlying = record.underlying;
+		in.strike = record.strike;
+		in.dividendYield = record.dividendYield;
+		in.riskFreeRate = record.riskFreeRate;
+		in.volatility = record.volatility;
+		in.maturity = Date(BigInteger(record.maturity));
+		in.dayCounter = supportedDayCounters[record.dayCounter];
+	}
+
+	position_ += n;
+	return n;
+}
+
+void WritePortfolioBinary(const std::string & path,
+	const OptionInputs * inputs,
+	Size n)
+{
+	std::ofstream file(path.c_str(), std::ios::binary);
+	QL_REQUIRE(file, "cannot create " << path);
+
+	boost::uint64_t count = n;
+	file.write(binaryMagic, sizeof(binaryMagic));
+	file.write(reinterpret_cast<const char *>(&count), sizeof(count));
+
+	for (Size i = 0; i < n; ++i) {
+		const OptionInputs & in = inputs[i];
+		OptionRecord record;
+		std::memset(&record, 0, sizeof(record));
+		record.underlying = in.underlying;
+		record.strike = in.strike;
+		record.dividendYield = in.dividendYield;
+		record.riskFreeRate = in.riskFreeRate;
+		record.volatility = in.volatility;
+		record.maturity = boost::int32_t(in.maturity.serialNumber());
+		record.type = boost::int8_t(in.type == Option::Call ? 1 : -1);
+		record.dayCounter = boost::uint8_t(DayCounterIndex(in.dayCounter));
+		file.write(reinterpret_cast<const char *>(&record), sizeof(record));
+	}
+
+	QL_REQUIRE(file, "error writing " << path);
+}
+
+// Either format
+
+namespace {
+
+	bool IsBinaryPortfolio(const std::string & path)
+	{
+		std::ifstream file(path.c_str(), std::ios::binary);
+		QL_REQUIRE(file, "cannot open " << path);
+
+		char magic[sizeof(binaryMagic)];
+		return file.read(magic, sizeof(magic))
+			&& std::memcmp(magic, binaryMagic, sizeof(magic)) == 0;
+	}
+
+}
+
+PortfolioReader * OpenPortfolio(const std::string & path)
+{
+	if (IsBinaryPortfolio(path))
+		return new BinaryPortfolioReader(path);
+	return new CsvPortfolioReader(path);
+}
+
+Size PortfolioSize(const std::string & path)
+{
+	if (IsBinaryPortfolio(path))
+		return BinaryPortfolioReader(path).size();
+
+	std::ifstream file(path.c_str());
+	std::string line;
+	std::getline(file, line);
+
+	Size n = 0;
+	while (std::getline(file, line))
+		if (!line.empty() && line[0] != '\r')
+			++n;
+	return n;
+}
+
+// Streaming
+
+Size StreamPortfolio(PortfolioReader & reader,
+	Size chunkSize,
+	const std::function<void(const OptionInputs *, Size)> & consume,
+	Size depth)
+{
+	QL_REQUIRE(chunkSize > 0, "chunk size must be positive");
+
+	// depth buffers can be filled ahead of the one being consumed
+	std::vector<std::vector<OptionInputs> > buffers(depth + 1,
+		std::vector<OptionInputs>(chunkSize));
+
+	std::mutex mutex;
+	std::condition_variable changed;
+	std::deque<Size> free, ready;
+	std::vector<Size> filled(buffers.size());
+	bool finished = false, aborted = false;
+	std::exception_ptr loaderError;
+
+	for (Size b = 0; b < buffers.size(); ++b)
+		free.push_back(b);
+
+	std::thread loader([&]() {
+		try {
+			for (;;) {
+				Size b;
+				{
+					std::unique_lock<std::mutex> lock(mutex);
+					changed.wait(lock, [&]() { return aborted || !free.empty(); });
+					if (aborted)
+						return;
+					b = free.front();
+					free.pop_front();
+				}
+
+				Size n = reader.read(&buffers[b][0], chunkSize);
+
+				std::lock_guard<std::mutex> lock(mutex);
+				if (n == 0) {
+					finished = true;
+					changed.notify_all();
+					return;
+				}
+				filled[b] = n;
+				ready.push_back(b);
+				changed.notify_all();
+			}
+		}
+		catch (...) {
+			std::lock_guard<std::mutex> lock(mutex);
+			loaderError = std::current_exception();
+			finished = true;
+			changed.notify_all();
+		}
+	});
+
+	Size total = 0;
+	try {
+		for (;;) {
+			Size b;
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				changed.wait(lock, [&]() { return finished || !ready.empty(); });
+				if (ready.empty())
+					break;
+				b = ready.front();
+				ready.pop_front();
+			}
+
+			consume(&buffers[b][0], filled[b]);
+			total += filled[b];
+
+			std::lock_guard<std::mutex> lock(mutex);
+			free.push_back(b);
+			changed.notify_all();
+		}
+	}
+	catch (...) {
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			aborted = true;
+			changed.notify_all();
+		}
+		loader.join();
+		throw;
+	}
+
+	loader.join();
+	if (loaderError)
+		std::rethrow_exception(loaderError);
+
+	return total;
+}
@@ -0,0 +1,145 @@
+/* -*- mode: c++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+// QuantLib Black-Scholes-Merton test - streaming portfolio input
+
+#ifndef quantlibtest3_portfolio_loader_hpp
+#define quantlibtest3_portfolio_loader_hpp
+
+#include "OptionInputs.hpp"
+#include <boost/cstdint.hpp>
+#include <fstream>
+#include <functional>
+#include <istream>
+#include <string>
+
+/* Portfolio file formats
+
+CSV: a header line followed by one option per line,
+
+    type,underlying,strike,dividendYield,riskFreeRate,volatility,maturity,dayCounter
+    Put,36,40,0,0.06,0.2,1999-05-17,Actual/365 (Fixed)
+
+with type Call/Put (or C/P), the maturity as an ISO date and the
+day counter by its QuantLib name.
+
+Binary: a 16-byte header (the magic "QLOPTV01" and a little-endian
+64-bit record count) followed by fixed-width OptionRecords.
+
+Supported day counters are Actual/365 (Fixed), Actual/360,
+30/360 (Bond Basis) and Actual/Actual (ISDA).
+*/
+
+// Fixed-width binary record, little-endian, 48 bytes
+struct OptionRecord {
+	double underlying;
+	double strike;
+	double dividendYield;
+	double riskFreeRate;
+	double volatility;
+	boost::int32_t maturity; // Date serial number
+	boost::int8_t type; // +1 call, -1 put
+	boost::uint8_t dayCounter; // index of a supported day counter
+	boost::uint8_t reserved[2];
+};
+
+// Source of options, read a chunk at a time
+class PortfolioReader
+{
+
+public:
+
+	virtual ~PortfolioReader() {}
+
+	// Read up to maxOptions into out; returns 0 at the end of the portfolio
+	virtual QuantLib::Size read(OptionInputs * out,
+		QuantLib::Size maxOptions) = 0;
+
+};
+
+// Reads the CSV format line by line
+class CsvPortfolioReader :
+	public PortfolioReader
+{
+
+public:
+
+	explicit CsvPortfolioReader(const std::string & path);
+
+	// Read from an open stream, such as std::cin; each read() returns
+	// as soon as maxOptions lines have arrived
+	explicit CsvPortfolioReader(std::istream & stream);
+
+	QuantLib::Size read(OptionInputs * out,
+		QuantLib::Size maxOptions);
+
+private:
+
+	std::ifstream file_;
+	std::istream & stream_;
+	std::string line_;
+	QuantLib::Size lineNumber_;
+
+};
+
+/** Reads the binary format through a sliding memory-mapped view.
+
+Only a window of the file is mapped at any time, so arbitrarily
+large portfolios are read with bounded memory and address space.
+*/
+class BinaryPortfolioReader :
+	public PortfolioReader
+{
+
+public:
+
+	explicit BinaryPortfolioReader(const std::string & path);
+	~BinaryPortfolioReader();
+
+	QuantLib::Size read(OptionInputs * out,
+		QuantLib::Size maxOptions);
+
+	QuantLib::Size size() const { return count_; }
+
+private:
+
+	class MappedFile;
+
+	MappedFile * file_;
+	QuantLib::Size count_;
+	QuantLib::Size position_;
+
+	BinaryPortfolioReader(const BinaryPortfolioReader &);
+	BinaryPortfolioReader & operator=(const BinaryPortfolioReader &);
+
+};
+
+// Open a portfolio file, telling the binary format by its magic
+PortfolioReader * OpenPortfolio(const std::string & path);
+
+// Number of options in a portfolio file
+QuantLib::Size PortfolioSize(const std::string & path);
+
+void WritePortfolioCsv(const std::string & path,
+	const OptionInputs * inputs,
+	QuantLib::Size n);
+
+void WritePortfolioBinary(const std::string & path,
+	const OptionInputs * inputs,
+	QuantLib::Size n);
+
+/** Streams a portfolio into a consumer chunk by chunk.
+
+A loader thread fills up to depth chunk buffers ahead of the
+consumer, which runs on the calling thread; reading and parsing thus
+overlap with pricing, and memory stays bounded by
+(depth + 1) * chunkSize options whatever the size of the portfolio.
+Exceptions from either side are rethrown to the caller.
+
+Returns the number of options streamed.
+*/
+QuantLib::Size StreamPortfolio(PortfolioReader & reader,
+	QuantLib::Size chunkSize,
+	const std::function<void(const OptionInputs *, QuantLib::Size)> & consume,
+	QuantLib::Size depth = 2);
+
+#endif
@@ -1,4 +1,4 @@
-/* -*- mode: c++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+﻿/* -*- mode: c++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
 
 // QuantLib Black-Scholes-Merton test
 
@@ -29,24 +29,46 @@ FOR A PARTICULAR PURPOSE.  See the license for more details.
 #include <ql/quantlib.hpp>
 
 // Boost and other headers
-#include <boost/timer.hpp>
 #include <boost/variant.hpp>
+#include <boost/scoped_ptr.hpp>
 #include <iostream>
 #include <iomanip>
+#include <vector>
+#include <algorithm>
+#include <random>
+#include <cstdio>
+#include <sstream>
+#include <fstream>
+#include <thread>
+#include <exception>
 
-using namespace QuantLib;
+// Local headers
+#include "OptionInputs.hpp"
+#include "BatchPricer.hpp"
+#include "BlackScholesKernel.hpp"
+#include "ParallelPricer.hpp"
+#include "ImpliedVolatility.hpp"
+#include "LiveRepricer.hpp"
+#include "Benchmark.hpp"
+#include "PortfolioLoader.hpp"
+#include "ResultsSink.hpp"
+#include "CommandLine.hpp"
+#include "MonteCarloEngine.hpp"
+#include "FiniteDifferenceEngine.hpp"
+#include "AmericanApproximations.hpp"
+#include "TreeEngine.hpp"
+#include "Adjoint.hpp"
+#include "VolSurface.hpp"
+#include "YieldCurve.hpp"
+#include "MarketCache.hpp"
+#include "AllocationCounter.hpp"
+#include "ArenaPricer.hpp"
+#include "SnapshotPricer.hpp"
+#include "PayoffKernel.hpp"
+#include "YearFraction.hpp"
+#include "VectorMath.hpp"
 
-// Input data
-struct OptionInputs {
-	Option::Type type;
-	Real underlying;
-	Real strike;
-	Spread dividendYield;
-	Rate riskFreeRate;
-	Volatility volatility;
-	Date maturity;
-	DayCounter dayCounter;
-};
+using namespace QuantLib;
 
 // Print the input values
 void PrintInputs(std::ostream & os,
@@ -104,13 +126,6 @@ public:
 };
 
 
-// Ask the user to press <Enter> to continue program flow
-void PressEnter()
-{
-	std::cout << "\nPress <Enter> to continue...";
-	std::cin.ignore();
-}
-
 // Print a row of output data
 void PrintResRow(const std::string & method,
 	OutputEl Euro)
@@ -124,6 +139,16 @@ void PrintResRow(const std::string & method,
 	std::cout << std::endl;
 }
 
+// Print a row of heap allocation counts, which builds without the
+// counting allocator do not have
+void PrintAllocationRow(const std::string & method, Real count)
+{
+	if (AllocationsCounted())
+		PrintResRow(method, count);
+	else
+		PrintResRow(method, "not counted");
+}
+
 // Set up the pricing engine
 void BlackScholes(VanillaOption & euro,
 	boost::shared_ptr<BlackScholesMertonProcess> bsmProcess)
@@ -137,19 +162,1566 @@ void BlackScholes(VanillaOption & euro,
 		euro.NPV());
 }
 
-// Set up the option parameters
-void EquityOption(void)
+// The input option with American exercise by each closed-form
+// approximation, from the same arrays as the SoA kernel
+void AmericanApproximations(const OptionInputs & in,
+	const Date & settlementDate)
 {
+	OptionArrays arrays;
+	LoadOptionArrays(&in, 1, settlementDate, arrays);
 
-	std::cout << std::endl;
+	const AmericanApproximation methods[] = {
+		BaroneAdesiWhaley, BjerksundStensland, QdPlus };
+	const char * names[] = {
+		"Barone-Adesi/Whaley (American)",
+		"Bjerksund/Stensland (American)",
+		"QD+ (American)" };
+	for (Size i = 0; i < LENGTH(methods); ++i) {
+		Real npv;
+		AmericanApproximationKernel(arrays, methods[i], &npv);
+		PrintResRow(names[i],
+			npv);
+	}
+}
+
+// A ladder of strikes on the input option's market, with the input
+// option itself at the front of the book
+std::vector<OptionInputs> StrikeLadder(const OptionInputs & in,
+	Size bookSize)
+{
+	std::vector<OptionInputs> book(bookSize, in);
+	for (Size i = 1; i < bookSize; ++i)
+		book[i].strike = in.strike * (0.5 + Real(i) / bookSize);
+	return book;
+}
+
+// Price a book of options built around the input option in one call
+void BatchEquityOption(const OptionInputs & in,
+	const Date & settlementDate,
+	const Calendar & calendar)
+{
+	const Size bookSize = 1000;
+	std::vector<OptionInputs> book = StrikeLadder(in, bookSize);
+	std::vector<Real> npvs(bookSize);
+
+	BatchPricer pricer(settlementDate, calendar);
+	pricer.price(&book[0], bookSize, &npvs[0]);
+
+	PrintResRow("Black-Scholes (batch)",
+		npvs[0]);
+}
+
+// Time each stage of the EquityOption() pipeline separately over a book
+void StagesEquityOption(const OptionInputs & in,
+	const Date & settlementDate,
+	const Calendar & calendar,
+	Benchmark & bench)
+{
+	const Size bookSize = 10000;
+	std::vector<OptionInputs> book = StrikeLadder(in, bookSize);
+
+	std::vector<boost::shared_ptr<Exercise> > exercises(bookSize);
+	std::vector<boost::shared_ptr<StrikedTypePayoff> > payoffs(bookSize);
+	std::vector<Handle<Quote> > quotes(bookSize);
+	std::vector<Handle<YieldTermStructure> > rates(bookSize), dividends(bookSize);
+	std::vector<Handle<BlackVolTermStructure> > vols(bookSize);
+	std::vector<boost::shared_ptr<VanillaOption> > options(bookSize);
+	std::vector<Real> npvs(bookSize);
+
+	bench.run("stage: setup", bookSize, [&]() {
+		for (Size i = 0; i < bookSize; ++i) {
+			exercises[i] = boost::shared_ptr<Exercise>(
+				new EuropeanExercise(book[i].maturity));
+			payoffs[i] = boost::shared_ptr<StrikedTypePayoff>(
+				new PlainVanillaPayoff(book[i].type, book[i].strike));
+			quotes[i] = Handle<Quote>(
+				boost::shared_ptr<Quote>(new SimpleQuote(book[i].underlying)));
+		}
+	});
+
+	bench.run("stage: curve construction", bookSize, [&]() {
+		for (Size i = 0; i < bookSize; ++i) {
+			rates[i] = Handle<YieldTermStructure>(
+				boost::shared_ptr<YieldTermStructure>(
+				new FlatForward(settlementDate,
+				book[i].riskFreeRate,
+				book[i].dayCounter)));
+			dividends[i] = Handle<YieldTermStructure>(
+				boost::shared_ptr<YieldTermStructure>(
+				new FlatForward(settlementDate,
+				book[i].dividendYield,
+				book[i].dayCounter)));
+			vols[i] = Handle<BlackVolTermStructure>(
+				boost::shared_ptr<BlackVolTermStructure>(
+				new BlackConstantVol(settlementDate,
+				calendar,
+				book[i].volatility,
+				book[i].dayCounter)));
+		}
+	});
+
+	bench.run("stage: engine creation", bookSize, [&]() {
+		for (Size i = 0; i < bookSize; ++i) {
+			boost::shared_ptr<BlackScholesMertonProcess> process(
+				new BlackScholesMertonProcess(quotes[i],
+				dividends[i],
+				rates[i],
+				vols[i]));
+			options[i] = boost::shared_ptr<VanillaOption>(
+				new VanillaOption(payoffs[i], exercises[i]));
+			options[i]->setPricingEngine(boost::shared_ptr<PricingEngine>(
+				new AnalyticEuropeanEngine(process)));
+		}
+	});
+
+	bench.run("stage: NPV", bookSize, [&]() {
+		for (Size i = 0; i < bookSize; ++i) {
+			options[i]->recalculate();
+			npvs[i] = options[i]->NPV();
+		}
+	});
+
+	PrintResRow("Black-Scholes (staged pipeline)",
+		npvs[0]);
+}
+
+// Price the same book with the SoA kernel and check it against the
+// AnalyticEuropeanEngine
+void KernelEquityOption(const OptionInputs & in,
+	const Date & settlementDate,
+	const Calendar & calendar,
+	Benchmark & bench)
+{
+	const Size bookSize = 100000;
+	std::vector<OptionInputs> book = StrikeLadder(in, bookSize);
+	std::vector<Real> engineNpvs(bookSize), kernelNpvs(bookSize);
+
+	bench.run("batch engine", bookSize, [&]() {
+		BatchPricer pricer(settlementDate, calendar);
+		pricer.price(&book[0], bookSize, &engineNpvs[0]);
+	});
+
+	bench.run("SoA kernel (incl. load)", bookSize, [&]() {
+		OptionArrays arrays;
+		LoadOptionArrays(&book[0], bookSize, settlementDate, arrays);
+		BlackScholesKernel(arrays, &kernelNpvs[0]);
+	});
+
+	Real maxError = 0.0;
+	for (Size i = 0; i < bookSize; ++i)
+		maxError = std::max(maxError,
+		std::fabs(kernelNpvs[i] - engineNpvs[i]));
+
+	QL_ENSURE(maxError < 1.0e-12,
+		"SoA kernel differs from AnalyticEuropeanEngine by " << maxError);
+
+	PrintResRow("Black-Scholes (SoA kernel)",
+		kernelNpvs[0]);
+	PrintResRow("  max |kernel - engine|",
+		maxError);
+}
+
+// The book as a block of calls and a block of puts through the SoA
+// kernel and through its instantiations for each type and payoff,
+// checked against AnalyticEuropeanEngine with QuantLib's payoffs
+void PayoffKernelEquityOption(const OptionInputs & in,
+	const Date & settlementDate,
+	const Calendar & calendar,
+	Benchmark & bench)
+{
+	const Size bookSize = 100000;
+	std::vector<OptionInputs> book = StrikeLadder(in, bookSize);
+	for (Size i = 0; i < bookSize; ++i)
+		book[i].type = i < bookSize / 2 ? Option::Call : Option::Put;
+	OptionArrays arrays;
+	LoadOptionArrays(&book[0], bookSize, settlementDate, arrays);
+
+	const payoff::CashOrNothing cash = { 10.0 };
+	std::vector<Real> vanillaNpvs(bookSize), cashNpvs(bookSize), assetNpvs(bookSize);
+
+	Real genericNs = bench.run("SoA kernel, run-time type", bookSize, [&]() {
+		BlackScholesKernel(arrays, &vanillaNpvs[0]);
+	}).p50;
+	Real vanillaNs = bench.run("SoA kernel, plain vanilla", bookSize, [&]() {
+		BlackScholesKernel(arrays, payoff::PlainVanilla(), &vanillaNpvs[0]);
+	}).p50;
+	Real cashNs = bench.run("SoA kernel, cash-or-nothing", bookSize, [&]() {
+		BlackScholesKernel(arrays, cash, &cashNpvs[0]);
+	}).p50;
+	Real assetNs = bench.run("SoA kernel, asset-or-nothing", bookSize, [&]() {
+		BlackScholesKernel(arrays, payoff::AssetOrNothing(), &assetNpvs[0]);
+	}).p50;
+
+	// A sample across both blocks through the engine and virtual payoffs
+	Real maxError = 0.0;
+	boost::shared_ptr<Exercise> exercise(new EuropeanExercise(in.maturity));
+	for (Size i = 0; i < bookSize; i += 97) {
+		const OptionInputs & option = book[i];
+		Handle<Quote> underlyingH(
+			boost::shared_ptr<Quote>(new SimpleQuote(option.underlying)));
+		boost::shared_ptr<PricingEngine> engine(new AnalyticEuropeanEngine(
+			MakeProcess(underlyingH, option, settlementDate, calendar)));
+
+		VanillaOption vanilla(boost::shared_ptr<StrikedTypePayoff>(
+			new PlainVanillaPayoff(option.type, option.strike)), exercise);
+		VanillaOption cashDigital(boost::shared_ptr<StrikedTypePayoff>(
+			new CashOrNothingPayoff(option.type, option.strike, cash.cash)), exercise);
+		VanillaOption assetDigital(boost::shared_ptr<StrikedTypePayoff>(
+			new AssetOrNothingPayoff(option.type, option.strike)), exercise);
+		vanilla.setPricingEngine(engine);
+		cashDigital.setPricingEngine(engine);
+		assetDigital.setPricingEngine(engine);
+
+		maxError = std::max(maxError, std::fabs(vanillaNpvs[i] - vanilla.NPV()));
+		maxError = std::max(maxError, std::fabs(cashNpvs[i] - cashDigital.NPV()));
+		maxError = std::max(maxError, std::fabs(assetNpvs[i] - assetDigital.NPV()));
+	}
+	QL_ENSURE(maxError < 1.0e-11,
+		"specialized kernel differs from AnalyticEuropeanEngine by " << maxError);
+
+	PrintResRow("Black-Scholes (specialized kernel)",
+		vanillaNpvs[0]);
+	PrintResRow("  cash-or-nothing",
+		cashNpvs[0]);
+	PrintResRow("  asset-or-nothing",
+		assetNpvs[0]);
+	PrintResRow("  max |kernel - engine|",
+		maxError);
+	PrintResRow("  ns/option, run-time type",
+		genericNs);
+	PrintResRow("  ns/option, plain vanilla",
+		vanillaNs);
+	PrintResRow("  ns/option, cash-or-nothing",
+		cashNs);
+	PrintResRow("  ns/option, asset-or-nothing",
+		assetNs);
+}
+
+// exp, log, n(x), N(x) and N^-1(p) over a million values, one at a
+// time through QuantLib and the standard library and in batches in
+// double and in float, checked against QuantLib's
+void VectorMathEquityOption(Benchmark & bench)
+{
+	const Size n = 1000000;
+
+	// Arguments spanning what the pricers feed each function: log
+	// moneyness, discount exponents and the uniforms of Monte Carlo
+	std::vector<Real> x(n), positive(n), p(n), out(n);
+	for (Size i = 0; i < n; ++i) {
+		x[i] = -8.0 + 16.0 * (i + 0.5) / n;
+		positive[i] = 0.01 + 10.0 * (i + 0.5) / n;
+		p[i] = (i + 0.5) / n;
+	}
+	std::vector<float> xf(x.begin(), x.end()), positivef(positive.begin(), positive.end()),
+		pf(p.begin(), p.end()), outf(n);
+
+	CumulativeNormalDistribution cdf;
+	NormalDistribution pdf;
+	InverseCumulativeNormal inverse;
+
+	// QuantLib or the standard library one value at a time, then the
+	// batches in double and in float
+	Real scalarNs[5], doubleNs[5], floatNs[5];
+	scalarNs[0] = bench.run("exp, std::exp", n, [&]() {
+		for (Size i = 0; i < n; ++i)
+			out[i] = std::exp(x[i]);
+	}).p50;
+	doubleNs[0] = bench.run("exp, batch double", n, [&]() {
+		BatchExp(&x[0], n, &out[0]);
+	}).p50;
+	floatNs[0] = bench.run("exp, batch float", n, [&]() {
+		BatchExp(&xf[0], n, &outf[0]);
+	}).p50;
+	scalarNs[1] = bench.run("log, std::log", n, [&]() {
+		for (Size i = 0; i < n; ++i)
+			out[i] = std::log(positive[i]);
+	}).p50;
+	doubleNs[1] = bench.run("log, batch double", n, [&]() {
+		BatchLog(&positive[0], n, &out[0]);
+	}).p50;
+	floatNs[1] = bench.run("log, batch float", n, [&]() {
+		BatchLog(&positivef[0], n, &outf[0]);
+	}).p50;
+	scalarNs[2] = bench.run("n(x), NormalDistribution", n, [&]() {
+		for (Size i = 0; i < n; ++i)
+			out[i] = pdf(x[i]);
+	}).p50;
+	doubleNs[2] = bench.run("n(x), batch double", n, [&]() {
+		BatchNormalPdf(&x[0], n, &out[0]);
+	}).p50;
+	floatNs[2] = bench.run("n(x), batch float", n, [&]() {
+		BatchNormalPdf(&xf[0], n, &outf[0]);
+	}).p50;
+	scalarNs[3] = bench.run("N(x), CumulativeNormalDistribution", n, [&]() {
+		for (Size i = 0; i < n; ++i)
+			out[i] = cdf(x[i]);
+	}).p50;
+	doubleNs[3] = bench.run("N(x), batch double", n, [&]() {
+		BatchNormalCdf(&x[0], n, &out[0]);
+	}).p50;
+	floatNs[3] = bench.run("N(x), batch float", n, [&]() {
+		BatchNormalCdf(&xf[0], n, &outf[0]);
+	}).p50;
+	scalarNs[4] = bench.run("N^-1(p), InverseCumulativeNormal", n, [&]() {
+		for (Size i = 0; i < n; ++i)
+			out[i] = inverse(p[i]);
+	}).p50;
+	doubleNs[4] = bench.run("N^-1(p), batch double", n, [&]() {
+		BatchInverseNormalCdf(&p[0], n, &out[0]);
+	}).p50;
+	floatNs[4] = bench.run("N^-1(p), batch float", n, [&]() {
+		BatchInverseNormalCdf(&pf[0], n, &outf[0]);
+	}).p50;
+
+	// Agreement with QuantLib, to within its own accuracy
+	Real cdfError = 0.0, inverseError = 0.0;
+	BatchNormalCdf(&x[0], n, &out[0]);
+	for (Size i = 0; i < n; ++i)
+		cdfError = std::max(cdfError, std::fabs(out[i] - cdf(x[i])));
+	BatchInverseNormalCdf(&p[0], n, &out[0]);
+	for (Size i = 0; i < n; ++i)
+		inverseError = std::max(inverseError, std::fabs(out[i] - inverse(p[i])));
+	QL_ENSURE(cdfError < 1.0e-12,
+		"batch N(x) differs from QuantLib by " << cdfError);
+	QL_ENSURE(inverseError < 1.0e-7,
+		"batch N^-1(p) differs from QuantLib by " << inverseError);
+
+	const char * names[] = { "exp", "log", "n(x)", "N(x)", "N^-1(p)" };
+	PrintResRow("Vectorized math, max |N(x) - QuantLib|",
+		cdfError);
+	PrintResRow("  max |N^-1(p) - QuantLib|",
+		inverseError);
+	for (Size f = 0; f < LENGTH(names); ++f) {
+		PrintResRow(std::string("  ns/value, ") + names[f] + ", scalar",
+			scalarNs[f]);
+		PrintResRow(std::string("  ns/value, ") + names[f] + ", batch double",
+			doubleNs[f]);
+		PrintResRow(std::string("  ns/value, ") + names[f] + ", batch float",
+			floatNs[f]);
+	}
+}
+
+// Greeks of the input option in the same pass as its price, checked
+// against the AnalyticEuropeanEngine greeks of the priced option
+void GreeksEquityOption(const OptionInputs & in,
+	const VanillaOption & euro,
+	const Date & settlementDate,
+	Benchmark & bench)
+{
+	const Size bookSize = 100000;
+	std::vector<OptionInputs> book = StrikeLadder(in, bookSize);
+	OptionArrays arrays;
+	LoadOptionArrays(&book[0], bookSize, settlementDate, arrays);
+
+	std::vector<Real> npvs(bookSize);
+	bench.run("SoA kernel", bookSize, [&]() {
+		BlackScholesKernel(arrays, &npvs[0]);
+	});
+
+	OptionResults results;
+	bench.run("SoA kernel + greeks", bookSize, [&]() {
+		BlackScholesGreeksKernel(arrays, results);
+	});
+
+	const Real engineGreeks[] = { euro.delta(), euro.gamma(), euro.vega(),
+		euro.theta(), euro.rho(), euro.dividendRho() };
+	const Real kernelGreeks[] = { results.delta[0], results.gamma[0],
+		results.vega[0], results.theta[0], results.rho[0],
+		results.dividendRho[0] };
+	for (Size i = 0; i < LENGTH(engineGreeks); ++i)
+		QL_ENSURE(std::fabs(kernelGreeks[i] - engineGreeks[i]) < 1.0e-10,
+		"SoA greek " << i << " differs from AnalyticEuropeanEngine: "
+		<< kernelGreeks[i] << " vs " << engineGreeks[i]);
+
+	PrintResRow("Black-Scholes + greeks (SoA kernel)",
+		results.npv[0]);
+	PrintResRow("  delta", results.delta[0]);
+	PrintResRow("  gamma", results.gamma[0]);
+	PrintResRow("  vega", results.vega[0]);
+	PrintResRow("  theta", results.theta[0]);
+	PrintResRow("  rho", results.rho[0]);
+	PrintResRow("  dividend rho", results.dividendRho[0]);
+	PrintResRow("  vanna", results.vanna[0]);
+	PrintResRow("  volga", results.volga[0]);
+}
+
+// Sensitivities to every input from one forward and one reverse pass
+// on a tape, checked against central differences of BlackScholes()
+// bumping the same inputs, then timed against the price alone and
+// against the 2N + 1 bumped prices
+void AdjointEquityOption(const OptionInputs & in,
+	const Date & settlementDate,
+	const Calendar & calendar,
+	Benchmark & bench)
+{
+	ad::Tape tape;
+	OptionSensitivities adjoint = AdjointBlackScholes(in, settlementDate, tape);
+
+	// The EquityOption() market with every input behind a quote
+	boost::shared_ptr<SimpleQuote> spot(new SimpleQuote(in.underlying));
+	boost::shared_ptr<SimpleQuote> rate(new SimpleQuote(in.riskFreeRate));
+	boost::shared_ptr<SimpleQuote> dividend(new SimpleQuote(in.dividendYield));
+	boost::shared_ptr<SimpleQuote> vol(new SimpleQuote(in.volatility));
+	boost::shared_ptr<BlackScholesMertonProcess> process(
+		new BlackScholesMertonProcess(Handle<Quote>(spot),
+		Handle<YieldTermStructure>(boost::shared_ptr<YieldTermStructure>(
+		new FlatForward(settlementDate, Handle<Quote>(dividend), in.dayCounter))),
+		Handle<YieldTermStructure>(boost::shared_ptr<YieldTermStructure>(
+		new FlatForward(settlementDate, Handle<Quote>(rate), in.dayCounter))),
+		Handle<BlackVolTermStructure>(boost::shared_ptr<BlackVolTermStructure>(
+		new BlackConstantVol(settlementDate, calendar, Handle<Quote>(vol),
+		in.dayCounter)))));
+	boost::shared_ptr<PricingEngine> engine(new AnalyticEuropeanEngine(process));
+	boost::shared_ptr<Exercise> exercise(new EuropeanExercise(in.maturity));
+
+	auto price = [&](Real strike) {
+		VanillaOption option(boost::shared_ptr<StrikedTypePayoff>(
+			new PlainVanillaPayoff(in.type, strike)), exercise);
+		option.setPricingEngine(engine);
+		return option.NPV();
+	};
+
+	const Real h = 1.0e-5;
+	auto bumped = [&](const boost::shared_ptr<SimpleQuote> & quote) {
+		Real value = quote->value();
+		Real step = h * std::max(std::fabs(value), 1.0);
+		quote->setValue(value + step);
+		Real up = price(in.strike);
+		quote->setValue(value - step);
+		Real down = price(in.strike);
+		quote->setValue(value);
+		return (up - down) / (2.0 * step);
+	};
+
+	const Real strikeStep = h * in.strike;
+	const char * names[] = { "spot", "strike", "rate", "dividend", "vol" };
+	const Real adjoints[] = { adjoint.underlying, adjoint.strike,
+		adjoint.riskFreeRate, adjoint.dividendYield, adjoint.volatility };
+	const Real differences[] = { bumped(spot),
+		(price(in.strike + strikeStep) - price(in.strike - strikeStep))
+		/ (2.0 * strikeStep),
+		bumped(rate), bumped(dividend), bumped(vol) };
+
+	Real npv = price(in.strike);
+	QL_ENSURE(std::fabs(adjoint.npv - npv) < 1.0e-12,
+		"adjoint price differs from AnalyticEuropeanEngine: "
+		<< adjoint.npv << " vs " << npv);
+	Real maxError = 0.0;
+	for (Size i = 0; i < LENGTH(adjoints); ++i) {
+		Real error = std::fabs(adjoints[i] - differences[i]);
+		QL_ENSURE(error < 1.0e-6 * std::max(std::fabs(differences[i]), 1.0),
+			"adjoint d/d" << names[i] << " differs from finite differences: "
+			<< adjoints[i] << " vs " << differences[i]);
+		maxError = std::max(maxError, error);
+	}
+
+	const Size bookSize = 10000;
+	std::vector<OptionInputs> book = StrikeLadder(in, bookSize);
+	OptionArrays arrays;
+	LoadOptionArrays(&book[0], bookSize, settlementDate, arrays);
+	std::vector<Real> npvs(bookSize);
+	std::vector<OptionSensitivities> sensitivities(bookSize);
+
+	Real priceNs = bench.run("taped model, price only", bookSize, [&]() {
+		for (Size i = 0; i < bookSize; ++i)
+			npvs[i] = ad::BlackScholesPrice(arrays.phi[i], arrays.spot[i],
+			arrays.strike[i], arrays.rate[i], arrays.dividend[i],
+			arrays.volatility[i], arrays.time[i]);
+	}).p50;
+	Real adjointNs = bench.run("adjoint price + sensitivities", bookSize, [&]() {
+		for (Size i = 0; i < bookSize; ++i)
+			sensitivities[i] = AdjointBlackScholes(book[i], settlementDate, tape);
+	}).p50;
+
+	PrintResRow("Black-Scholes (adjoint)",
+		adjoint.npv);
+	PrintResRow("  d/dspot", adjoint.underlying);
+	PrintResRow("  d/dstrike", adjoint.strike);
+	PrintResRow("  d/drate", adjoint.riskFreeRate);
+	PrintResRow("  d/ddividend", adjoint.dividendYield);
+	PrintResRow("  d/dvol", adjoint.volatility);
+	PrintResRow("  d/dmaturity", adjoint.maturity);
+	PrintResRow("  max |adjoint - FD|",
+		maxError);
+	PrintResRow("  tape nodes",
+		Real(tape.size()));
+	PrintResRow("  cost / price cost",
+		adjointNs / priceNs);
+	PrintResRow("  cost / 2N+1 prices",
+		adjointNs / ((2 * LENGTH(adjoints) + 1) * priceNs));
+}
+
+// Recover the volatilities of a book of quotes with the batch solver and
+// with VanillaOption::impliedVolatility, comparing accuracy and speed
+void ImpliedVolEquityOption(const OptionInputs & in,
+	const Date & settlementDate,
+	const Calendar & calendar,
+	Benchmark & bench)
+{
+	// Quotes across strikes and volatilities, all with enough time value
+	// for the volatility to be well defined
+	const Size bookSize = 100000;
+	std::vector<OptionInputs> book(bookSize, in);
+	for (Size i = 1; i < bookSize; ++i) {
+		book[i].strike = in.strike * (0.8 + 0.45 * i / bookSize);
+		book[i].volatility = in.volatility
+			* (0.5 + 2.0 * ((i * 7919) % bookSize) / bookSize);
+	}
+
+	OptionArrays arrays;
+	LoadOptionArrays(&book[0], bookSize, settlementDate, arrays);
+	std::vector<Real> prices(bookSize), vols(bookSize);
+	BlackScholesKernel(arrays, &prices[0]);
+
+	BenchmarkResult batch = bench.run("implied vol (batch solver)",
+		bookSize, [&]() {
+		ImpliedVolatilityKernel(arrays, &prices[0], &vols[0]);
+	});
+	Real batchThroughput = batch.throughput();
+
+	Real kernelError = 0.0;
+	for (Size i = 0; i < bookSize; ++i)
+		kernelError = std::max(kernelError,
+		std::fabs(vols[i] - book[i].volatility));
+	QL_ENSURE(kernelError < 1.0e-10,
+		"implied vols are off the quoted ones by " << kernelError);
+
+	// QuantLib's solver on a sample of the same quotes
+	const Size sampleSize = 1000, stride = bookSize / sampleSize;
+	BatchPricer pricer(settlementDate, calendar);
+	Real npv;
+	pricer.price(&in, 1, &npv);
+	boost::shared_ptr<GeneralizedBlackScholesProcess> process =
+		pricer.process();
+
+	Real quantLibError = 0.0;
+	bench.run("implied vol (QuantLib)", sampleSize, [&]() {
+		for (Size i = 0; i < sampleSize; ++i) {
+			const OptionInputs & quote = book[i * stride];
+			VanillaOption option(
+				boost::shared_ptr<StrikedTypePayoff>(
+				new PlainVanillaPayoff(quote.type, quote.strike)),
+				boost::shared_ptr<Exercise>(
+				new EuropeanExercise(quote.maturity)));
+			Volatility vol = option.impliedVolatility(
+				prices[i * stride], process, 1.0e-10, 100);
+			quantLibError = std::max(quantLibError,
+				std::fabs(vol - quote.volatility));
+		}
+	});
+
+	PrintResRow("Implied vol (batch solver)",
+		vols[0]);
+	PrintResRow("  max |vol error| batch",
+		kernelError);
+	PrintResRow("  max |vol error| QuantLib",
+		quantLibError);
+	PrintResRow("  batch quotes/second",
+		batchThroughput);
+}
+
+// Push random-walk spot ticks into live options and time each tick
+// until the options on the ticked underlying are repriced
+void LiveEquityOption(const OptionInputs & in,
+	const Date & settlementDate,
+	const Calendar & calendar,
+	Benchmark & bench)
+{
+	const Size underlyings = 50, optionsPerUnderlying = 20, ticks = 100000;
+
+	LiveRepricer repricer(settlementDate, calendar);
+	std::vector<OptionInputs> ladder = StrikeLadder(in, optionsPerUnderlying);
+	for (Size u = 0; u < underlyings; ++u) {
+		Size underlying = repricer.addUnderlying(in);
+		for (Size i = 0; i < optionsPerUnderlying; ++i)
+			repricer.addOption(underlying, ladder[i]);
+	}
+
+	std::vector<Real> npvs(optionsPerUnderlying);
+	for (Size u = 0; u < underlyings; ++u)
+		repricer.NPVs(u, &npvs[0]);
+	Size initialCalculations = repricer.recalculations();
+
+	std::mt19937 rng(42);
+	std::uniform_int_distribution<Size> pick(0, underlyings - 1);
+	std::normal_distribution<Real> move(0.0, 0.001);
+	std::vector<Real> spots(underlyings, in.underlying);
+	std::vector<Real> latencies(ticks);
+
+	for (Size k = 0; k < ticks; ++k) {
+		Size u = pick(rng);
+		spots[u] *= std::exp(move(rng));
+
+		Stopwatch watch;
+		repricer.setSpot(u, spots[u]);
+		repricer.NPVs(u, &npvs[0]);
+		latencies[k] = watch.nanoseconds();
+	}
+
+	// Only the options of the ticked underlying were recalculated
+	QL_ENSURE(repricer.recalculations() - initialCalculations
+		== ticks * optionsPerUnderlying,
+		"unexpected recalculations: "
+		<< repricer.recalculations() - initialCalculations);
+
+	BenchmarkResult tick = bench.record(
+		Summarize("live tick-to-NPV (per tick)", 1, latencies));
+
+	PrintResRow("Black-Scholes (live, last tick)",
+		npvs[0]);
+	PrintResRow("  options repriced per tick",
+		Real(optionsPerUnderlying));
+	PrintResRow("  tick-to-NPV p50 (us)",
+		tick.p50 * 1.0e-3);
+	PrintResRow("  tick-to-NPV p99 (us)",
+		tick.p99 * 1.0e-3);
+}
+
+// Price a large book on one thread and then on every core
+void ParallelEquityOption(const OptionInputs & in,
+	const Date & todaysDate,
+	const Date & settlementDate,
+	const Calendar & calendar,
+	Size threads,
+	Benchmark & bench)
+{
+	const Size bookSize = 200000;
+	std::vector<OptionInputs> book = StrikeLadder(in, bookSize);
+	std::vector<Real> npvs(bookSize);
+
+	ParallelPricer serial(todaysDate, settlementDate, calendar, 1);
+	Real serialNs = bench.run("parallel pricer, 1 thread", bookSize, [&]() {
+		serial.price(&book[0], bookSize, &npvs[0]);
+	}).p50;
+
+	ParallelPricer parallel(todaysDate, settlementDate, calendar, threads);
+	Real parallelNs = bench.run("parallel pricer, all threads", bookSize, [&]() {
+		parallel.price(&book[0], bookSize, &npvs[0]);
+	}).p50;
+
+	PrintResRow("Black-Scholes (parallel)",
+		npvs[0]);
+	PrintResRow("  threads",
+		Real(parallel.threads()));
+	PrintResRow("  speedup",
+		serialNs / parallelNs);
+	PrintResRow("  stolen chunks",
+		Real(parallel.stolenChunks()));
+}
+
+// Stream a book back from CSV and binary files while pricing it
+void StreamEquityOption(const OptionInputs & in,
+	const Date & settlementDate,
+	const Calendar & calendar,
+	Benchmark & bench)
+{
+	const Size bookSize = 100000;
+	const Size chunkSize = 4096;
+	const std::string csvPath = "QuantLibTest3-portfolio.csv";
+	const std::string binaryPath = "QuantLibTest3-portfolio.bin";
+
+	std::vector<OptionInputs> book = StrikeLadder(in, bookSize);
+	std::vector<Real> expected(bookSize), npvs(bookSize);
+
+	BatchPricer pricer(settlementDate, calendar);
+	pricer.price(&book[0], bookSize, &expected[0]);
+
+	WritePortfolioCsv(csvPath, &book[0], bookSize);
+	WritePortfolioBinary(binaryPath, &book[0], bookSize);
+
+	Size priced = 0;
+	auto consume = [&](const OptionInputs * chunk, Size n) {
+		pricer.price(chunk, n, &npvs[priced]);
+		priced += n;
+	};
+
+	bench.run("stream CSV + price", bookSize, [&]() {
+		priced = 0;
+		CsvPortfolioReader reader(csvPath);
+		StreamPortfolio(reader, chunkSize, consume);
+	});
+	Real csvError = 0.0;
+	for (Size i = 0; i < bookSize; ++i)
+		csvError = std::max(csvError, std::fabs(npvs[i] - expected[i]));
+
+	bench.run("stream binary + price", bookSize, [&]() {
+		priced = 0;
+		BinaryPortfolioReader reader(binaryPath);
+		StreamPortfolio(reader, chunkSize, consume);
+	});
+	Real binaryError = 0.0;
+	for (Size i = 0; i < bookSize; ++i)
+		binaryError = std::max(binaryError, std::fabs(npvs[i] - expected[i]));
+
+	std::remove(csvPath.c_str());
+	std::remove(binaryPath.c_str());
+
+	PrintResRow("Black-Scholes (streamed)",
+		npvs[0]);
+	PrintResRow("  options streamed",
+		Real(priced));
+	PrintResRow("  max error vs batch, CSV",
+		csvError);
+	PrintResRow("  max error vs batch, binary",
+		binaryError);
+}
+
+// Write a book's price and greeks to a memory-mapped columnar file,
+// and compare with formatting them as a table
+void ResultsEquityOption(const OptionInputs & in,
+	const Date & settlementDate,
+	Benchmark & bench)
+{
+	const Size bookSize = 1000000;
+	const Size tableSize = 10000;
+	const std::string path = "QuantLibTest3-results.bin";
+
+	std::vector<OptionInputs> book = StrikeLadder(in, bookSize);
+	OptionArrays arrays;
+	LoadOptionArrays(&book[0], bookSize, settlementDate, arrays);
+
+	OptionResults expected;
+	BlackScholesGreeksKernel(arrays, expected);
+
+	Real maxError = 0.0;
+	{
+		MappedResultsSink sink(path, bookSize);
+		bench.run("greeks to mapped columns", bookSize, [&]() {
+			WriteOptionResults(arrays, sink);
+		});
+		bench.run("greeks to mapped columns + flush", bookSize, [&]() {
+			WriteOptionResults(arrays, sink);
+			sink.flush();
+		});
+
+		const std::vector<Real> * columns[] = { &expected.npv,
+			&expected.delta, &expected.gamma, &expected.vega,
+			&expected.theta, &expected.rho, &expected.dividendRho,
+			&expected.vanna, &expected.volga };
+		for (Size c = 0; c < LENGTH(columns); ++c) {
+			const Real * written = sink.column(c, 0, bookSize);
+			for (Size i = 0; i < bookSize; ++i)
+				maxError = std::max(maxError,
+				std::fabs(written[i] - (*columns[c])[i]));
+		}
+	}
+	std::remove(path.c_str());
+
+	OptionArrays tableArrays;
+	LoadOptionArrays(&book[0], tableSize, settlementDate, tableArrays);
+	bench.run("greeks to text table", tableSize, [&]() {
+		std::ostringstream table;
+		TableResultsSink sink(table);
+		WriteOptionResults(tableArrays, sink);
+	});
+
+	PrintResRow("Black-Scholes (mapped results)",
+		expected.npv[0]);
+	PrintResRow("  max |mapped - memory|",
+		maxError);
+}
+
+// Monte Carlo for the European on the same process, checked against
+// the analytic price and timed at one and at all threads
+void MonteCarloEquityOption(const boost::shared_ptr<StrikedTypePayoff> & payoff,
+	const boost::shared_ptr<Exercise> & exercise,
+	const boost::shared_ptr<BlackScholesMertonProcess> & bsmProcess,
+	Real analyticNpv,
+	Size threads,
+	Benchmark & bench)
+{
+	const Size samples = 1000000;
+	const Size paths = 2 * samples;
+
+	VanillaOption serialOption(payoff, exercise);
+	serialOption.setPricingEngine(boost::shared_ptr<PricingEngine>(
+		new ParallelMcEuropeanEngine(bsmProcess, samples, 1, true, true, 1)));
+	bench.run("MC European, 1 thread", paths, [&]() {
+		serialOption.recalculate();
+	});
+
+	VanillaOption option(payoff, exercise);
+	option.setPricingEngine(boost::shared_ptr<PricingEngine>(
+		new ParallelMcEuropeanEngine(bsmProcess, samples, 1, true, true, threads)));
+	BenchmarkResult timing = bench.run("MC European, all threads", paths, [&]() {
+		option.recalculate();
+	});
+
+	QL_ENSURE(option.NPV() == serialOption.NPV(),
+		"Monte Carlo price depends on the thread count: "
+		<< option.NPV() << " vs " << serialOption.NPV());
+	QL_ENSURE(std::fabs(option.NPV() - analyticNpv) < 5.0 * option.errorEstimate(),
+		"Monte Carlo price " << option.NPV() << " +/- " << option.errorEstimate()
+		<< " is inconsistent with the analytic " << analyticNpv);
+
+	VanillaOption plainOption(payoff, exercise);
+	plainOption.setPricingEngine(boost::shared_ptr<PricingEngine>(
+		new ParallelMcEuropeanEngine(bsmProcess, paths, 1, false, false, threads)));
+
+	PrintResRow("Monte Carlo (Philox, AV + CV)",
+		option.NPV());
+	PrintResRow("  standard error",
+		option.errorEstimate());
+	PrintResRow("  standard error, no AV/CV",
+		plainOption.errorEstimate());
+	PrintResRow("  paths/s",
+		timing.throughput());
+}
+
+// Convergence of Sobol points with a Brownian bridge against Philox
+// on paths of several steps: error to the analytic price and time at
+// growing sample counts
+void QmcEquityOption(const boost::shared_ptr<StrikedTypePayoff> & payoff,
+	const boost::shared_ptr<Exercise> & exercise,
+	const boost::shared_ptr<BlackScholesMertonProcess> & bsmProcess,
+	Real analyticNpv,
+	Size threads,
+	Benchmark & bench)
+{
+	const Size timeSteps = 16;
+
+	for (Size samples = 1 << 14; samples <= (1 << 20); samples <<= 2) {
+		VanillaOption philoxOption(payoff, exercise);
+		philoxOption.setPricingEngine(boost::shared_ptr<PricingEngine>(
+			new ParallelMcEuropeanEngine(bsmProcess, samples, timeSteps,
+			false, false, threads, 42, ParallelMcEuropeanEngine::PseudoRandom)));
+		VanillaOption sobolOption(payoff, exercise);
+		sobolOption.setPricingEngine(boost::shared_ptr<PricingEngine>(
+			new ParallelMcEuropeanEngine(bsmProcess, samples, timeSteps,
+			false, false, threads, 42, ParallelMcEuropeanEngine::Sobol)));
+
+		std::ostringstream suffix;
+		suffix << ", " << timeSteps << " steps, " << samples << " paths";
+		BenchmarkResult philoxTiming = bench.run("MC Philox" + suffix.str(),
+			samples, [&]() {
+			philoxOption.recalculate();
+		});
+		BenchmarkResult sobolTiming = bench.run("QMC Sobol + BB" + suffix.str(),
+			samples, [&]() {
+			sobolOption.recalculate();
+		});
+
+		Real sobolError = std::fabs(sobolOption.NPV() - analyticNpv);
+		QL_ENSURE(sobolError < 5.0 * sobolOption.errorEstimate(),
+			"Sobol price " << sobolOption.NPV() << " +/- " << sobolOption.errorEstimate()
+			<< " is inconsistent with the analytic " << analyticNpv);
+
+		std::ostringstream label;
+		label << samples << " paths";
+		PrintResRow("Philox error, " + label.str(),
+			std::fabs(philoxOption.NPV() - analyticNpv));
+		PrintResRow("  standard error",
+			philoxOption.errorEstimate());
+		PrintResRow("  paths/s",
+			philoxTiming.throughput());
+		PrintResRow("Sobol + BB error, " + label.str(),
+			sobolError);
+		PrintResRow("  standard error",
+			sobolOption.errorEstimate());
+		PrintResRow("  paths/s",
+			sobolTiming.throughput());
+	}
+}
+
+// American option on the same process by Crank-Nicolson finite
+// differences: the smallest grid within 1e-4 of a fine-grid price,
+// then the throughput of a book priced on that grid
+void FdAmericanEquityOption(const OptionInputs & in,
+	const boost::shared_ptr<BlackScholesMertonProcess> & bsmProcess,
+	const Date & settlementDate,
+	Real europeanNpv,
+	Benchmark & bench)
+{
+	const Real tolerance = 1.0e-4;
+	const Size timeSteps = 100;
+	const Size referenceSize = 2000;
+	const Size bookSize = 100;
+
+	boost::shared_ptr<Exercise> americanExercise(
+		new AmericanExercise(settlementDate, in.maturity));
+	boost::shared_ptr<Exercise> europeanExercise(
+		new EuropeanExercise(in.maturity));
+	boost::shared_ptr<StrikedTypePayoff> payoff(
+		new PlainVanillaPayoff(in.type, in.strike));
+
+	VanillaOption reference(payoff, americanExercise);
+	reference.setPricingEngine(boost::shared_ptr<PricingEngine>(
+		new FdCrankNicolsonEngine(bsmProcess, referenceSize, referenceSize)));
+
+	const Size gridSizes[] = { 100, 200, 300, 400, 600, 800 };
+	Size gridPoints = 0;
+	Real error = 0.0;
+	VanillaOption american(payoff, americanExercise);
+	for (Size i = 0; i < LENGTH(gridSizes) && gridPoints == 0; ++i) {
+		american.setPricingEngine(boost::shared_ptr<PricingEngine>(
+			new FdCrankNicolsonEngine(bsmProcess, timeSteps, gridSizes[i])));
+		error = std::fabs(american.NPV() - reference.NPV());
+		if (error < tolerance)
+			gridPoints = gridSizes[i];
+	}
+	QL_ENSURE(gridPoints > 0,
+		"no grid prices the American option within " << tolerance);
+
+	boost::shared_ptr<PricingEngine> engine(
+		new FdCrankNicolsonEngine(bsmProcess, timeSteps, gridPoints));
+
+	VanillaOption european(payoff, europeanExercise);
+	european.setPricingEngine(engine);
+
+	// The book shares the engine and so its grid buffers
+	std::vector<OptionInputs> book = StrikeLadder(in, bookSize);
+	std::vector<boost::shared_ptr<VanillaOption> > options(bookSize);
+	for (Size i = 0; i < bookSize; ++i) {
+		boost::shared_ptr<StrikedTypePayoff> strikePayoff(
+			new PlainVanillaPayoff(book[i].type, book[i].strike));
+		options[i].reset(new VanillaOption(strikePayoff, americanExercise));
+		options[i]->setPricingEngine(engine);
+	}
+
+	std::ostringstream name;
+	name << "FD American, " << timeSteps << "x" << gridPoints;
+	BenchmarkResult timing = bench.run(name.str(), bookSize, [&]() {
+		for (Size i = 0; i < bookSize; ++i)
+			options[i]->recalculate();
+	});
+
+	PrintResRow("Crank-Nicolson FD (American)",
+		american.NPV());
+	PrintResRow("  error vs fine grid",
+		error);
+	PrintResRow("  grid points",
+		Real(gridPoints));
+	PrintResRow("  European error vs analytic",
+		std::fabs(european.NPV() - europeanNpv));
+	PrintResRow("  prices/s",
+		timing.throughput());
+}
+
+// Time the American approximations on a book loaded once, then check
+// them against Crank-Nicolson finite differences over a grid of
+// maturities, moneyness, volatilities and dividend yields around the
+// input option, both calls and puts
+void AmericanApproximationsEquityOption(const OptionInputs & in,
+	const Date & settlementDate,
+	const Calendar & calendar,
+	Benchmark & bench)
+{
+	const AmericanApproximation methods[] = {
+		BaroneAdesiWhaley, BjerksundStensland, QdPlus };
+	const char * names[] = { "BAW", "BjS", "QD+" };
+
+	const Size bookSize = 100000;
+	std::vector<OptionInputs> book = StrikeLadder(in, bookSize);
+	OptionArrays arrays;
+	LoadOptionArrays(&book[0], bookSize, settlementDate, arrays);
+	std::vector<Real> npvs(bookSize);
+
+	for (Size m = 0; m < LENGTH(methods); ++m) {
+		std::ostringstream name;
+		name << names[m] << " American kernel";
+		BenchmarkResult timing = bench.run(name.str(), bookSize, [&]() {
+			AmericanApproximationKernel(arrays, methods[m], &npvs[0]);
+		});
+		name.str("");
+		name << "  " << names[m] << " ns/option";
+		PrintResRow(name.str(),
+			1.0e9 / timing.throughput());
+	}
+
+	// The grid, by maturity bucket
+	const Integer days[] = { 36, 182, 365, 1095 };
+	const Real moneyness[] = { 0.8, 0.9, 1.0, 1.1, 1.2 };
+	const Volatility vols[] = { 0.1, 0.2, 0.4 };
+	const Spread dividends[] = { 0.0, 0.04 };
+	const Option::Type types[] = { Option::Put, Option::Call };
+	const Size timeSteps = 200, gridPoints = 1000;
+
+	std::vector<OptionInputs> grid;
+	for (Size d = 0; d < LENGTH(days); ++d)
+		for (Size k = 0; k < LENGTH(moneyness); ++k)
+			for (Size v = 0; v < LENGTH(vols); ++v)
+				for (Size q = 0; q < LENGTH(dividends); ++q)
+					for (Size t = 0; t < LENGTH(types); ++t) {
+						OptionInputs option = in;
+						option.type = types[t];
+						option.underlying = in.strike * moneyness[k];
+						option.volatility = vols[v];
+						option.dividendYield = dividends[q];
+						option.maturity = settlementDate + days[d];
+						grid.push_back(option);
+					}
+	const Size gridSize = grid.size();
+	const Size bucketSize = gridSize / LENGTH(days);
+
+	std::vector<Real> reference(gridSize);
+	for (Size i = 0; i < gridSize; ++i) {
+		Handle<Quote> underlying(
+			boost::shared_ptr<Quote>(new SimpleQuote(grid[i].underlying)));
+		boost::shared_ptr<BlackScholesMertonProcess> process =
+			MakeProcess(underlying, grid[i], settlementDate, calendar);
+		VanillaOption option(
+			boost::shared_ptr<StrikedTypePayoff>(
+			new PlainVanillaPayoff(grid[i].type, grid[i].strike)),
+			boost::shared_ptr<Exercise>(
+			new AmericanExercise(settlementDate, grid[i].maturity)));
+		option.setPricingEngine(boost::shared_ptr<PricingEngine>(
+			new FdCrankNicolsonEngine(process, timeSteps, gridPoints)));
+		reference[i] = option.NPV();
+	}
+
+	OptionArrays gridArrays;
+	LoadOptionArrays(&grid[0], gridSize, settlementDate, gridArrays);
+	std::vector<Real> approximations(gridSize);
+
+	for (Size m = 0; m < LENGTH(methods); ++m) {
+		AmericanApproximationKernel(gridArrays, methods[m], &approximations[0]);
+		Real sumOfSquares = 0.0;
+		for (Size d = 0; d < LENGTH(days); ++d) {
+			Real maxError = 0.0;
+			for (Size i = d * bucketSize; i < (d + 1) * bucketSize; ++i) {
+				Real error = std::fabs(approximations[i] - reference[i]);
+				maxError = std::max(maxError, error);
+				sumOfSquares += error * error;
+			}
+			std::ostringstream name;
+			name << "  " << names[m] << " max |error| vs FD, "
+				<< days[d] << "d";
+			PrintResRow(name.str(),
+				maxError);
+		}
+		std::ostringstream name;
+		name << "  " << names[m] << " RMS error vs FD";
+		PrintResRow(name.str(),
+			std::sqrt(sumOfSquares / gridSize));
+	}
+}
+
+// Binomial trees for the European and American option: convergence
+// of the European to the analytic price and steps/s of the American,
+// then an American book priced on every thread, each thread with its
+// own process and one engine, and so one lattice, for all its options
+void TreeEquityOption(const OptionInputs & in,
+	const boost::shared_ptr<BlackScholesMertonProcess> & bsmProcess,
+	const Date & settlementDate,
+	const Calendar & calendar,
+	Real europeanNpv,
+	Size threads,
+	Benchmark & bench)
+{
+	const BinomialTreeEngine::Tree trees[] = {
+		BinomialTreeEngine::CoxRossRubinstein,
+		BinomialTreeEngine::JarrowRudd,
+		BinomialTreeEngine::LeisenReimer };
+	const char * names[] = { "CRR", "JR", "LR" };
+	const char * rows[] = {
+		"Cox-Ross-Rubinstein (American)",
+		"Jarrow-Rudd (American)",
+		"Leisen-Reimer (American)" };
+	const Size steps[] = { 100, 1000, 10000 };
+	const Size timedSteps = 1000;
+
+	boost::shared_ptr<Exercise> americanExercise(
+		new AmericanExercise(settlementDate, in.maturity));
+	boost::shared_ptr<Exercise> europeanExercise(
+		new EuropeanExercise(in.maturity));
+	boost::shared_ptr<StrikedTypePayoff> payoff(
+		new PlainVanillaPayoff(in.type, in.strike));
+
+	for (Size t = 0; t < LENGTH(trees); ++t) {
+		VanillaOption american(payoff, americanExercise);
+		american.setPricingEngine(boost::shared_ptr<PricingEngine>(
+			new BinomialTreeEngine(bsmProcess, trees[t], timedSteps)));
+
+		std::ostringstream name;
+		name << names[t] << " American, " << timedSteps << " steps";
+		BenchmarkResult timing = bench.run(name.str(), timedSteps, [&]() {
+			american.recalculate();
+		});
+
+		PrintResRow(rows[t],
+			american.NPV());
+		PrintResRow("  steps/s",
+			timing.throughput());
+
+		for (Size i = 0; i < LENGTH(steps); ++i) {
+			VanillaOption european(payoff, europeanExercise);
+			european.setPricingEngine(boost::shared_ptr<PricingEngine>(
+				new BinomialTreeEngine(bsmProcess, trees[t], steps[i])));
+			name.str("");
+			name << "  European error, " << steps[i] << " steps";
+			PrintResRow(name.str(),
+				european.NPV() - europeanNpv);
+		}
+	}
+
+	const Size bookSize = 1000;
+	std::vector<OptionInputs> book = StrikeLadder(in, bookSize);
+	const Size workers = std::max<Size>(std::min(threads == 0
+		? Size(std::thread::hardware_concurrency()) : threads, bookSize), 1);
+	const Size slice = (bookSize + workers - 1) / workers;
+
+	// Everything a worker touches is built here and used by it alone
+	std::vector<boost::shared_ptr<VanillaOption> > options(bookSize);
+	for (Size w = 0; w < workers; ++w) {
+		Handle<Quote> underlying(
+			boost::shared_ptr<Quote>(new SimpleQuote(in.underlying)));
+		boost::shared_ptr<PricingEngine> engine(new BinomialTreeEngine(
+			MakeProcess(underlying, in, settlementDate, calendar),
+			BinomialTreeEngine::CoxRossRubinstein, timedSteps));
+		for (Size i = w * slice; i < std::min(bookSize, (w + 1) * slice); ++i) {
+			options[i].reset(new VanillaOption(
+				boost::shared_ptr<StrikedTypePayoff>(
+				new PlainVanillaPayoff(book[i].type, book[i].strike)),
+				americanExercise));
+			options[i]->setPricingEngine(engine);
+		}
+	}
+
+	std::vector<Real> npvs(bookSize);
+	std::vector<std::exception_ptr> errors(workers);
+	auto work = [&](Size w) {
+		try {
+			for (Size i = w * slice; i < std::min(bookSize, (w + 1) * slice); ++i) {
+				options[i]->recalculate();
+				npvs[i] = options[i]->NPV();
+			}
+		}
+		catch (...) {
+			errors[w] = std::current_exception();
+		}
+	};
+
+	std::ostringstream name;
+	name << "CRR American book, " << timedSteps << " steps";
+	BenchmarkResult timing = bench.run(name.str(), bookSize, [&]() {
+		std::vector<std::thread> pool;
+		for (Size w = 1; w < workers; ++w)
+			pool.push_back(std::thread(work, w));
+		work(0);
+		for (Size w = 0; w < pool.size(); ++w)
+			pool[w].join();
+		for (Size w = 0; w < workers; ++w)
+			if (errors[w])
+				std::rethrow_exception(errors[w]);
+	});
 
-	// Set up dates
-	Calendar calendar = TARGET();
-	Date todaysDate(15, May, 1998);
-	Date settlementDate(17, May, 1998);
-	Settings::instance().evaluationDate() = todaysDate;
+	PrintResRow("  book prices/s",
+		timing.throughput());
+	PrintResRow("  threads",
+		Real(workers));
+}
+
+// Volatilities of a book spread over the strikes and expiries of the
+// run's surface, or of a smile around the input option without one,
+// looked up through BlackVarianceSurface and through the index
+void VolSurfaceEquityOption(const OptionInputs & in,
+	const VolSurfaceInputs * surface,
+	const Date & settlementDate,
+	const Calendar & calendar,
+	Benchmark & bench)
+{
+	const VolSurfaceInputs smile = surface
+		? VolSurfaceInputs() : SmileSurface(in, settlementDate, 40, 100);
+	const VolSurfaceInputs & grid = surface ? *surface : smile;
+	const Integer days = grid.expiries.back() - settlementDate;
+
+	const Size bookSize = 100000;
+	std::vector<OptionInputs> book = StrikeLadder(in, bookSize);
+	for (Size i = 1; i < bookSize; ++i)
+		book[i].maturity = settlementDate + Integer(1 + (i * 7919) % days);
+	OptionArrays arrays;
+	LoadOptionArrays(&book[0], bookSize, settlementDate, arrays);
+
+	boost::shared_ptr<BlackVarianceSurface> termStructure =
+		MakeVolSurface(grid, settlementDate, calendar, in.dayCounter);
+	VolSurfaceIndex index(grid, settlementDate, in.dayCounter);
+
+	std::vector<Real> vols(bookSize);
+	Real surfaceNs = bench.run("BlackVarianceSurface lookups", bookSize, [&]() {
+		for (Size i = 0; i < bookSize; ++i)
+			vols[i] = termStructure->blackVol(arrays.time[i], arrays.strike[i], true);
+	}).p50;
+	Real indexNs = bench.run("surface index lookups", bookSize, [&]() {
+		index.volatilities(arrays);
+	}).p50;
+
+	Real maxError = 0.0;
+	for (Size i = 0; i < bookSize; ++i)
+		maxError = std::max(maxError, std::fabs(arrays.volatility[i] - vols[i]));
+	QL_ENSURE(maxError < 1.0e-12,
+		"surface index differs from BlackVarianceSurface by " << maxError);
+
+	PrintResRow("Surface volatility (index)",
+		arrays.volatility[0]);
+	PrintResRow("  surface points",
+		Real(grid.strikes.size() * grid.expiries.size()));
+	PrintResRow("  ns/lookup, BlackVarianceSurface",
+		surfaceNs);
+	PrintResRow("  ns/lookup, index",
+		indexNs);
+	PrintResRow("  max |index - surface|",
+		maxError);
+}
+
+// Zero rates of a book spread over ten years of maturities on the
+// run's bootstrapped curve, or on a sample curve around the input
+// option's rate without one, asking the curve for every option and
+// through a discount table asking it once per date, then the book
+// priced on them by the SoA kernel
+void CurveEquityOption(const OptionInputs & in,
+	const boost::shared_ptr<YieldTermStructure> & curve,
+	const Date & settlementDate,
+	const Calendar & calendar,
+	Benchmark & bench)
+{
+	const boost::shared_ptr<YieldTermStructure> termStructure = curve
+		? curve
+		: BootstrapCurve(SampleCurve(in.riskFreeRate, settlementDate),
+		settlementDate, calendar, in.dayCounter);
+
+	const Size bookSize = 100000;
+	const Integer days = 3650;
+	std::vector<OptionInputs> book = StrikeLadder(in, bookSize);
+	for (Size i = 1; i < bookSize; ++i)
+		book[i].maturity = settlementDate + Integer(1 + (i * 7919) % days);
+	OptionArrays arrays;
+	LoadOptionArrays(&book[0], bookSize, settlementDate, arrays);
+
+	// Bootstrap outside the timings
+	termStructure->discount(in.maturity);
+
+	std::vector<Real> rates(bookSize);
+	Real curveNs = bench.run("curve zero rates, per option", bookSize, [&]() {
+		for (Size i = 0; i < bookSize; ++i)
+			rates[i] = -std::log(termStructure->discount(book[i].maturity))
+			/ arrays.time[i];
+	}).p50;
+
+	Size dates = 0;
+	Real tableNs = bench.run("curve zero rates, discount table", bookSize, [&]() {
+		DiscountTable table(termStructure, &book[0], bookSize);
+		table.zeroRates(&book[0], bookSize, arrays);
+		dates = table.dates();
+	}).p50;
+
+	Real maxError = 0.0;
+	for (Size i = 0; i < bookSize; ++i)
+		maxError = std::max(maxError, std::fabs(arrays.rate[i] - rates[i]));
+	QL_ENSURE(maxError == 0.0,
+		"discount table differs from the curve by " << maxError);
+
+	std::vector<Real> npvs(bookSize);
+	BlackScholesKernel(arrays, &npvs[0]);
+
+	PrintResRow("Black-Scholes (bootstrapped curve)",
+		npvs[0]);
+	PrintResRow("  zero rate to maturity",
+		arrays.rate[0]);
+	PrintResRow("  curve lookups / options",
+		Real(dates) / bookSize);
+	PrintResRow("  ns/option, curve per option",
+		curveNs);
+	PrintResRow("  ns/option, discount table",
+		tableNs);
+}
+
+// Market objects for a book of options on 50 underlyings, one process
+// and engine per option against the processes and engines interned in
+// a MarketCache, with the heap allocations and bytes of each
+void InterningEquityOption(const OptionInputs & in,
+	const Date & settlementDate,
+	const Calendar & calendar,
+	Benchmark & bench)
+{
+	const Size bookSize = 100000;
+	const Size underlyings = 50;
+	std::vector<OptionInputs> book = StrikeLadder(in, bookSize);
+	for (Size i = 0; i < bookSize; ++i)
+		book[i].underlying = in.underlying * (0.8 + 0.4 * (i % underlyings) / underlyings);
+
+	std::vector<boost::shared_ptr<BlackScholesMertonProcess> > processes(bookSize);
+	std::vector<boost::shared_ptr<PricingEngine> > engines(bookSize);
+
+	AllocationCounts before = AllocationsSoFar();
+	for (Size i = 0; i < bookSize; ++i) {
+		Handle<Quote> underlyingH(
+			boost::shared_ptr<Quote>(new SimpleQuote(book[i].underlying)));
+		processes[i] = MakeProcess(underlyingH, book[i], settlementDate, calendar);
+		engines[i] = boost::shared_ptr<PricingEngine>(
+			new AnalyticEuropeanEngine(processes[i]));
+	}
+	AllocationCounts perOption = AllocationsSoFar() - before;
+	processes.assign(bookSize, boost::shared_ptr<BlackScholesMertonProcess>());
+	engines.assign(bookSize, boost::shared_ptr<PricingEngine>());
+
+	MarketCache cache(settlementDate, calendar);
+	before = AllocationsSoFar();
+	for (Size i = 0; i < bookSize; ++i) {
+		processes[i] = cache.process(book[i]);
+		engines[i] = cache.analyticEngine(book[i]);
+	}
+	AllocationCounts interned = AllocationsSoFar() - before;
+	processes.assign(bookSize, boost::shared_ptr<BlackScholesMertonProcess>());
+	engines.assign(bookSize, boost::shared_ptr<PricingEngine>());
+
+	Real perOptionNs = bench.run("market objects, per option", bookSize, [&]() {
+		for (Size i = 0; i < bookSize; ++i) {
+			Handle<Quote> underlyingH(
+				boost::shared_ptr<Quote>(new SimpleQuote(book[i].underlying)));
+			processes[i] = MakeProcess(underlyingH, book[i], settlementDate, calendar);
+		}
+	}).p50;
+	processes.assign(bookSize, boost::shared_ptr<BlackScholesMertonProcess>());
+	Real internedNs = bench.run("market objects, interned", bookSize, [&]() {
+		MarketCache markets(settlementDate, calendar);
+		for (Size i = 0; i < bookSize; ++i)
+			processes[i] = markets.process(book[i]);
+	}).p50;
+
+	// The interleaved book through BatchPricer, which interns the same way
+	std::vector<Real> npvs(bookSize);
+	BatchPricer pricer(settlementDate, calendar);
+	Real batchNs = bench.run("Black-Scholes batch, interleaved markets", bookSize, [&]() {
+		pricer.price(&book[0], bookSize, &npvs[0]);
+	}).p50;
+
+	// A market per option, as streams and servers may see: the cache
+	// stays within its capacity
+	const Size maxMarkets = 1024;
+	MarketCache bounded(settlementDate, calendar, maxMarkets);
+	for (Size i = 0; i < bookSize; ++i) {
+		OptionInputs distinct = book[i];
+		distinct.volatility += 1.0e-6 * i;
+		bounded.process(distinct);
+	}
+	QL_ENSURE(bounded.processes() <= maxMarkets,
+		bounded.processes() << " markets held, more than " << maxMarkets);
+
+	const Real megabyte = 1024.0 * 1024.0;
+	PrintResRow("Black-Scholes (interned markets)",
+		npvs[0]);
+	PrintResRow("  processes, per option",
+		Real(bookSize));
+	PrintResRow("  processes, interned",
+		Real(cache.processes()));
+	PrintResRow("  curves + vols + quotes, interned",
+		Real(cache.curves() + cache.vols() + cache.quotes()));
+	PrintAllocationRow("  allocations, per option",
+		Real(perOption.allocations));
+	PrintAllocationRow("  allocations, interned",
+		Real(interned.allocations));
+	PrintAllocationRow("  MB allocated, per option",
+		perOption.bytes / megabyte);
+	PrintAllocationRow("  MB allocated, interned",
+		interned.bytes / megabyte);
+	PrintResRow("  ns/option, per option",
+		perOptionNs);
+	PrintResRow("  ns/option, interned",
+		internedNs);
+	PrintResRow("  processes held, a market per option",
+		Real(bounded.processes()));
+	PrintResRow("  markets built by BatchPricer",
+		Real(pricer.marketsBuilt()));
+	PrintResRow("  ns/option, BatchPricer",
+		batchNs);
+}
+
+// A book priced option by option as EquityOption() prices, its objects
+// built on the heap and carved out of an arena, with the heap
+// allocations and time of each
+void ArenaEquityOption(const OptionInputs & in,
+	const Date & settlementDate,
+	const Calendar & calendar,
+	Benchmark & bench)
+{
+	const Size bookSize = 10000;
+	std::vector<OptionInputs> book = StrikeLadder(in, bookSize);
+	std::vector<Real> heapNpvs(bookSize), arenaNpvs(bookSize);
+
+	ArenaPricer heap(settlementDate, calendar, false);
+	ArenaPricer arena(settlementDate, calendar, true);
+
+	// The arena's first block outside the counts
+	arena.price(&book[0], 1, &arenaNpvs[0]);
+
+	AllocationCounts before = AllocationsSoFar();
+	heap.price(&book[0], bookSize, &heapNpvs[0]);
+	AllocationCounts heapAllocations = AllocationsSoFar() - before;
+
+	before = AllocationsSoFar();
+	arena.price(&book[0], bookSize, &arenaNpvs[0]);
+	AllocationCounts arenaAllocations = AllocationsSoFar() - before;
+
+	Real maxError = 0.0;
+	for (Size i = 0; i < bookSize; ++i)
+		maxError = std::max(maxError, std::fabs(arenaNpvs[i] - heapNpvs[i]));
+	QL_ENSURE(maxError == 0.0,
+		"arena pricing differs from heap pricing by " << maxError);
+
+	Real heapNs = bench.run("per-option objects, heap", bookSize, [&]() {
+		heap.price(&book[0], bookSize, &heapNpvs[0]);
+	}).p50;
+	Real arenaNs = bench.run("per-option objects, arena", bookSize, [&]() {
+		arena.price(&book[0], bookSize, &arenaNpvs[0]);
+	}).p50;
+
+	PrintResRow("Black-Scholes (arena objects)",
+		arenaNpvs[0]);
+	PrintAllocationRow("  allocations/option, heap",
+		Real(heapAllocations.allocations) / bookSize);
+	PrintAllocationRow("  allocations/option, arena",
+		Real(arenaAllocations.allocations) / bookSize);
+	PrintAllocationRow("  heap bytes/option, heap",
+		Real(heapAllocations.bytes) / bookSize);
+	PrintAllocationRow("  heap bytes/option, arena",
+		Real(arenaAllocations.bytes) / bookSize);
+	PrintResRow("  arena bytes reserved",
+		Real(arena.arena().bytesReserved()));
+	PrintResRow("  ns/option, heap",
+		heapNs);
+	PrintResRow("  ns/option, arena",
+		arenaNs);
+}
+
+// Market setup for a million options, the observable objects of
+// EquityOption() against immutable snapshots, then the book priced on
+// the snapshots and checked against AnalyticEuropeanEngine
+void SnapshotEquityOption(const OptionInputs & in,
+	const Date & settlementDate,
+	const Calendar & calendar,
+	Benchmark & bench)
+{
+	const Size bookSize = 1000000;
+	std::vector<OptionInputs> book = StrikeLadder(in, bookSize);
+
+	// One option's setup as EquityOption() does it, left to go out of
+	// scope
+	auto observableSetup = [&](const OptionInputs & option) {
+		boost::shared_ptr<Exercise> exercise(new EuropeanExercise(option.maturity));
+		Handle<Quote> underlyingH(
+			boost::shared_ptr<Quote>(new SimpleQuote(option.underlying)));
+		boost::shared_ptr<StrikedTypePayoff> payoff(
+			new PlainVanillaPayoff(option.type, option.strike));
+		VanillaOption vanilla(payoff, exercise);
+		vanilla.setPricingEngine(boost::shared_ptr<PricingEngine>(
+			new AnalyticEuropeanEngine(
+			MakeProcess(underlyingH, option, settlementDate, calendar))));
+	};
+
+	std::vector<MarketSnapshot> snapshots;
+	snapshots.reserve(bookSize);
+
+	AllocationCounts before = AllocationsSoFar();
+	for (Size i = 0; i < 1000; ++i)
+		observableSetup(book[i]);
+	AllocationCounts observableAllocations = AllocationsSoFar() - before;
 
-	// Our options
+	before = AllocationsSoFar();
+	for (Size i = 0; i < 1000; ++i)
+		snapshots.push_back(MarketSnapshot(book[i], settlementDate));
+	AllocationCounts snapshotAllocations = AllocationsSoFar() - before;
+
+	Real observableNs = bench.run("market setup, observable", bookSize, [&]() {
+		for (Size i = 0; i < bookSize; ++i)
+			observableSetup(book[i]);
+	}).p50;
+	Real snapshotNs = bench.run("market setup, snapshot", bookSize, [&]() {
+		snapshots.clear();
+		for (Size i = 0; i < bookSize; ++i)
+			snapshots.push_back(MarketSnapshot(book[i], settlementDate));
+	}).p50;
+
+	std::vector<Real> npvs(bookSize);
+	Real priceNs = bench.run("Black-Scholes, snapshot", bookSize, [&]() {
+		SnapshotPrice(&book[0], bookSize, settlementDate, &npvs[0]);
+	}).p50;
+
+	const Size checked = 10000;
+	std::vector<Real> engineNpvs(checked);
+	BatchPricer pricer(settlementDate, calendar);
+	pricer.price(&book[0], checked, &engineNpvs[0]);
+	Real maxError = 0.0;
+	for (Size i = 0; i < checked; ++i)
+		maxError = std::max(maxError, std::fabs(npvs[i] - engineNpvs[i]));
+	QL_ENSURE(maxError < 1.0e-12,
+		"snapshot pricing differs from the engine by " << maxError);
+
+	PrintResRow("Black-Scholes (snapshot)",
+		npvs[0]);
+	PrintAllocationRow("  allocations/option, observable",
+		observableAllocations.allocations / 1000.0);
+	PrintAllocationRow("  allocations/option, snapshot",
+		snapshotAllocations.allocations / 1000.0);
+	PrintResRow("  ns/option setup, observable",
+		observableNs);
+	PrintResRow("  ns/option setup, snapshot",
+		snapshotNs);
+	PrintResRow("  ns/option, snapshot pricing",
+		priceNs);
+	PrintResRow("  max |snapshot - engine|",
+		maxError);
+}
+
+// Times to maturity of a book spread over ten years of maturities, by
+// yearFraction() per option and through a YearFractionTable, on the
+// input option's day counter and on a mix of conventions
+void YearFractionEquityOption(const OptionInputs & in,
+	const Date & settlementDate,
+	Benchmark & bench)
+{
+	const Size bookSize = 100000;
+	const Integer days = 3650;
+	std::vector<OptionInputs> book = StrikeLadder(in, bookSize);
+	for (Size i = 1; i < bookSize; ++i)
+		book[i].maturity = settlementDate + Integer(1 + (i * 7919) % days);
+
+	// Runs of a thousand options on each of three conventions
+	std::vector<OptionInputs> mixed = book;
+	const DayCounter dayCounters[] = { in.dayCounter, Actual360(), Thirty360() };
+	for (Size i = 0; i < bookSize; ++i)
+		mixed[i].dayCounter = dayCounters[(i / 1000) % LENGTH(dayCounters)];
+
+	std::vector<Time> times(bookSize), tableTimes(bookSize), mixedTimes(bookSize);
+	YearFractionTable table(settlementDate);
+
+	Real perOptionNs = bench.run("year fractions, per option", bookSize, [&]() {
+		for (Size i = 0; i < bookSize; ++i)
+			times[i] = book[i].dayCounter.yearFraction(settlementDate, book[i].maturity);
+	}).p50;
+	Real tableNs = bench.run("year fractions, table", bookSize, [&]() {
+		table.yearFractions(&book[0], bookSize, &tableTimes[0]);
+	}).p50;
+	Real mixedNs = bench.run("year fractions, table, mixed conventions", bookSize, [&]() {
+		table.yearFractions(&mixed[0], bookSize, &mixedTimes[0]);
+	}).p50;
+
+	for (Size i = 0; i < bookSize; ++i) {
+		QL_ENSURE(tableTimes[i] == times[i],
+			"table time " << tableTimes[i] << " differs from " << times[i]
+			<< " for " << book[i].maturity);
+		Time t = mixed[i].dayCounter.yearFraction(settlementDate, mixed[i].maturity);
+		QL_ENSURE(mixedTimes[i] == t,
+			"table time " << mixedTimes[i] << " differs from " << t
+			<< " for " << mixed[i].maturity << " " << mixed[i].dayCounter);
+	}
+
+	PrintResRow("Time to maturity (year fraction table)",
+		tableTimes[0]);
+	PrintResRow("  conventions in the mixed book",
+		Real(table.conventions()));
+	PrintResRow("  yearFraction() calls / options, mixed",
+		Real(table.yearFractionCalls()) / bookSize);
+	PrintResRow("  ns/option, per option",
+		perOptionNs);
+	PrintResRow("  ns/option, table",
+		tableNs);
+	PrintResRow("  ns/option, table, mixed",
+		mixedNs);
+}
+
+// The option the program has always priced
+OptionInputs ReferenceOption()
+{
 	OptionInputs in;
 
 	// Set up the option parameters
@@ -162,6 +1734,23 @@ void EquityOption(void)
 	in.maturity = Date(17, May, 1999);
 	in.dayCounter = Actual365Fixed();
 
+	return in;
+}
+
+// Price the option and, given a benchmark, run every pricing path on
+// books built around it
+void EquityOption(const OptionInputs & in,
+	const Date & todaysDate,
+	const Date & settlementDate,
+	const Calendar & calendar,
+	const boost::shared_ptr<YieldTermStructure> & curve,
+	const VolSurfaceInputs * surface,
+	Size threads,
+	Benchmark * bench)
+{
+
+	std::cout << std::endl;
+
 	// Print the options
 	PrintInputs(std::cout, in);
 	std::cout << std::endl;
@@ -180,8 +1769,9 @@ void EquityOption(void)
 		boost::shared_ptr<Quote>(new SimpleQuote(in.underlying)));
 
 	// Bootstrap the yield/dividend/vol curves
-	Handle<YieldTermStructure> flatTermStructure(
-		boost::shared_ptr<YieldTermStructure>(
+	Handle<YieldTermStructure> flatTermStructure(curve
+		? curve
+		: boost::shared_ptr<YieldTermStructure>(
 		new FlatForward(settlementDate,
 		in.riskFreeRate,
 		in.dayCounter)));
@@ -192,8 +1782,12 @@ void EquityOption(void)
 		in.dividendYield,
 		in.dayCounter)));
 
-	Handle<BlackVolTermStructure> flatVolTS(
-		boost::shared_ptr<BlackVolTermStructure>(
+	Handle<BlackVolTermStructure> flatVolTS(surface
+		? boost::shared_ptr<BlackVolTermStructure>(MakeVolSurface(*surface,
+		settlementDate,
+		calendar,
+		in.dayCounter))
+		: boost::shared_ptr<BlackVolTermStructure>(
 		new BlackConstantVol(settlementDate,
 		calendar,
 		in.volatility,
@@ -219,37 +1813,474 @@ void EquityOption(void)
 	BlackScholes(europeanOption,
 		bsmProcess);
 
+	// Closed-form approximations for the American
+	AmericanApproximations(in,
+		settlementDate);
+
+	if (!bench)
+		return;
+
+	// Monte Carlo for the same European
+	MonteCarloEquityOption(payoff,
+		europeanExercise,
+		bsmProcess,
+		europeanOption.NPV(),
+		threads,
+		*bench);
+
+	// Quasi-Monte Carlo convergence on multi-step paths
+	QmcEquityOption(payoff,
+		europeanExercise,
+		bsmProcess,
+		europeanOption.NPV(),
+		threads,
+		*bench);
+
+	// American exercise by finite differences
+	FdAmericanEquityOption(in,
+		bsmProcess,
+		settlementDate,
+		europeanOption.NPV(),
+		*bench);
+
+	// Binomial trees for both exercises
+	TreeEquityOption(in,
+		bsmProcess,
+		settlementDate,
+		calendar,
+		europeanOption.NPV(),
+		threads,
+		*bench);
+
+	// The approximations on a book and against finite differences
+	AmericanApproximationsEquityOption(in,
+		settlementDate,
+		calendar,
+		*bench);
+
+	// Times to maturity for a whole book at once
+	YearFractionEquityOption(in,
+		settlementDate,
+		*bench);
+
+	// Zero rates off a bootstrapped curve
+	CurveEquityOption(in,
+		curve,
+		settlementDate,
+		calendar,
+		*bench);
+
+	// Volatility lookups on a surface
+	VolSurfaceEquityOption(in,
+		surface,
+		settlementDate,
+		calendar,
+		*bench);
+
+	// Market objects shared across a book on many underlyings
+	InterningEquityOption(in,
+		settlementDate,
+		calendar,
+		*bench);
+
+	// Per-option pricing objects out of an arena
+	ArenaEquityOption(in,
+		settlementDate,
+		calendar,
+		*bench);
+
+	// Market setup without observers
+	SnapshotEquityOption(in,
+		settlementDate,
+		calendar,
+		*bench);
+
+	// Black-Scholes for a book of Europeans sharing one market
+	BatchEquityOption(in,
+		settlementDate,
+		calendar);
+
+	// The same pipeline, stage by stage
+	StagesEquityOption(in,
+		settlementDate,
+		calendar,
+		*bench);
+
+	// Black-Scholes for the same book through the SoA kernel
+	KernelEquityOption(in,
+		settlementDate,
+		calendar,
+		*bench);
+
+	// The kernel specialized on option type and payoff
+	PayoffKernelEquityOption(in,
+		settlementDate,
+		calendar,
+		*bench);
+
+	// exp, log and the normal functions in batches
+	VectorMathEquityOption(*bench);
+
+	// Greeks for the same book in one pass
+	GreeksEquityOption(in,
+		europeanOption,
+		settlementDate,
+		*bench);
+
+	// Sensitivities to every input by adjoint differentiation
+	AdjointEquityOption(in,
+		settlementDate,
+		calendar,
+		*bench);
+
+	// Implied volatilities back from the book's prices
+	ImpliedVolEquityOption(in,
+		settlementDate,
+		calendar,
+		*bench);
+
+	// Black-Scholes repriced live on spot ticks
+	LiveEquityOption(in,
+		settlementDate,
+		calendar,
+		*bench);
+
+	// Black-Scholes for a larger book across all cores
+	ParallelEquityOption(in,
+		todaysDate,
+		settlementDate,
+		calendar,
+		threads,
+		*bench);
+
+	// Black-Scholes for a book streamed from disk
+	StreamEquityOption(in,
+		settlementDate,
+		calendar,
+		*bench);
+
+	// Price and greeks for a large book written to a mapped file
+	ResultsEquityOption(in,
+		settlementDate,
+		*bench);
+
+}
+
+// The first option of the input, or the reference option without one
+OptionInputs ChooseOption(const CommandLine & cl)
+{
+	if (cl.input.empty())
+		return ReferenceOption();
+
+	boost::scoped_ptr<PortfolioReader> reader(cl.input == "-"
+		? new CsvPortfolioReader(std::cin)
+		: OpenPortfolio(cl.input));
+
+	OptionInputs in;
+	QL_REQUIRE(reader->read(&in, 1) == 1, cl.input << " holds no options");
+	return in;
+}
+
+// Price and greeks of inputs[0, n) into columns, the options split
+// evenly across one thread per element of arrays
+void PriceSlices(const OptionInputs * inputs,
+	Size n,
+	const Date & settlementDate,
+	const OptionResultColumns & columns,
+	std::vector<OptionArrays> & arrays)
+{
+	const Size threads = std::max<Size>(std::min(arrays.size(), n), 1);
+	const Size slice = (n + threads - 1) / threads;
+	std::vector<std::exception_ptr> errors(threads);
+
+	auto work = [&](Size t) {
+		try {
+			Size begin = t * slice;
+			Size end = std::min(n, begin + slice);
+			if (begin >= end)
+				return;
+			LoadOptionArrays(inputs + begin, end - begin, settlementDate,
+				arrays[t]);
+			BlackScholesGreeksKernel(arrays[t], columns.offset(begin));
+		}
+		catch (...) {
+			errors[t] = std::current_exception();
+		}
+	};
+
+	std::vector<std::thread> workers;
+	for (Size t = 1; t < threads; ++t)
+		workers.push_back(std::thread(work, t));
+	work(0);
+	for (Size t = 0; t < workers.size(); ++t)
+		workers[t].join();
+
+	for (Size t = 0; t < threads; ++t)
+		if (errors[t])
+			std::rethrow_exception(errors[t]);
+}
+
+// The run's volatility surface, if it has one, read into surface and
+// with the option's volatility set to the surface's at its strike and
+// expiry; null otherwise
+const VolSurfaceInputs * ChooseSurface(const CommandLine & cl,
+	const Date & settlementDate,
+	OptionInputs & in,
+	VolSurfaceInputs & surface)
+{
+	if (cl.surface.empty())
+		return 0;
+
+	surface = ReadVolSurfaceCsv(cl.surface);
+	VolSurfaceIndex index(surface, settlementDate, in.dayCounter);
+	in.volatility = index.volatility(
+		in.dayCounter.yearFraction(settlementDate, in.maturity), in.strike);
+	return &surface;
+}
+
+// The run's bootstrapped curve, if it has one, with the option's rate
+// set to the curve's continuously compounded zero rate to its
+// maturity; null otherwise
+boost::shared_ptr<YieldTermStructure> ChooseCurve(const CommandLine & cl,
+	const Date & settlementDate,
+	const Calendar & calendar,
+	OptionInputs & in)
+{
+	if (cl.curve.empty())
+		return boost::shared_ptr<YieldTermStructure>();
+
+	boost::shared_ptr<YieldTermStructure> curve = BootstrapCurve(
+		ReadCurveCsv(cl.curve), settlementDate, calendar, in.dayCounter);
+	in.riskFreeRate = -std::log(curve->discount(in.maturity))
+		/ in.dayCounter.yearFraction(settlementDate, in.maturity);
+	return curve;
+}
+
+// Price one option and optionally write its results
+void RunSingle(const CommandLine & cl,
+	const Date & todaysDate,
+	const Date & settlementDate,
+	const Calendar & calendar)
+{
+	OptionInputs in = ChooseOption(cl);
+	boost::shared_ptr<YieldTermStructure> curve =
+		ChooseCurve(cl, settlementDate, calendar, in);
+	VolSurfaceInputs surfaceInputs;
+	const VolSurfaceInputs * surface =
+		ChooseSurface(cl, settlementDate, in, surfaceInputs);
+	EquityOption(in, todaysDate, settlementDate, calendar, curve, surface,
+		cl.threads, 0);
+
+	if (!cl.output.empty()) {
+		OptionArrays arrays;
+		LoadOptionArrays(&in, 1, settlementDate, arrays);
+		boost::scoped_ptr<ResultsSink> sink(OpenResultsSink(cl.output, 1));
+		WriteOptionResults(arrays, *sink);
+	}
+}
+
+// Stream a portfolio file into a results file chunk by chunk, each
+// chunk priced across all the threads
+void RunBatch(const CommandLine & cl,
+	const Date & settlementDate,
+	std::ostream & report)
+{
+	QL_REQUIRE(!cl.input.empty() && cl.input != "-",
+		"batch mode needs an --input portfolio file");
+	QL_REQUIRE(!cl.output.empty(),
+		"batch mode needs an --output file");
+
+	Stopwatch watch;
+
+	boost::scoped_ptr<PortfolioReader> reader(OpenPortfolio(cl.input));
+	boost::scoped_ptr<ResultsSink> sink(
+		OpenResultsSink(cl.output, PortfolioSize(cl.input)));
+
+	Size threads = cl.threads;
+	if (threads == 0)
+		threads = std::max<Size>(std::thread::hardware_concurrency(), 1);
+	std::vector<OptionArrays> arrays(threads);
+
+	Size priced = 0;
+	StreamPortfolio(*reader, cl.chunkSize,
+		[&](const OptionInputs * chunk, Size n) {
+		PriceSlices(chunk, n, settlementDate, sink->reserve(priced, n), arrays);
+		sink->commit(priced, n);
+		priced += n;
+	});
+
+	report << "Priced " << priced << " options from " << cl.input
+		<< " into " << cl.output << " on " << threads << " threads, "
+		<< priced / watch.seconds() << " options/s" << std::endl;
 }
 
-// Get the option price and print timing information
-int main(int, char*[]) {
+// Points a stream at another buffer until it goes out of scope
+class StreamRedirect
+{
+
+public:
+
+	StreamRedirect(std::ostream & stream,
+		std::streambuf * buffer) :
+		stream_(stream),
+		saved_(stream.rdbuf(buffer))
+	{
+	}
+
+	~StreamRedirect() { stream_.rdbuf(saved_); }
+
+	// The buffer the stream had before
+	std::streambuf * saved() const { return saved_; }
+
+private:
+
+	std::ostream & stream_;
+	std::streambuf * saved_;
+
+};
+
+/* Run the benchmark suite, optionally saving the results as CSV.
+With the CSV on standard output, the report and the benchmark table
+go to standard error so that the CSV can be piped.
+*/
+void RunBenchmark(const CommandLine & cl,
+	const Date & todaysDate,
+	const Date & settlementDate,
+	const Calendar & calendar)
+{
+	const bool csvToStdout = cl.output == "-";
+	StreamRedirect report(std::cout,
+		csvToStdout ? std::cerr.rdbuf() : std::cout.rdbuf());
+
+	Benchmark bench(1, cl.repetitions);
+	OptionInputs in = ChooseOption(cl);
+	boost::shared_ptr<YieldTermStructure> curve =
+		ChooseCurve(cl, settlementDate, calendar, in);
+	VolSurfaceInputs surfaceInputs;
+	const VolSurfaceInputs * surface =
+		ChooseSurface(cl, settlementDate, in, surfaceInputs);
+	EquityOption(in, todaysDate, settlementDate, calendar, curve, surface,
+		cl.threads, &bench);
+	PrintBenchmarks(std::cout, bench.results());
+
+	if (csvToStdout) {
+		std::ostream csv(report.saved());
+		WriteBenchmarksCsv(csv, bench.results());
+	}
+	else if (!cl.output.empty()) {
+		std::ofstream file(cl.output.c_str());
+		QL_REQUIRE(file, "cannot create " << cl.output);
+		WriteBenchmarksCsv(file, bench.results());
+	}
+}
 
+/* Price options as their CSV lines arrive, after a header line,
+answering each with a table row until the input ends. A bad line is
+reported and skipped; it does not stop the server.
+*/
+void RunServer(const CommandLine & cl,
+	const Date & settlementDate,
+	std::ostream & report)
+{
+	boost::scoped_ptr<CsvPortfolioReader> reader(
+		cl.input.empty() || cl.input == "-"
+		? new CsvPortfolioReader(std::cin)
+		: new CsvPortfolioReader(cl.input));
+	boost::scoped_ptr<TableResultsSink> sink(
+		cl.output.empty() || cl.output == "-"
+		? new TableResultsSink(std::cout)
+		: new TableResultsSink(cl.output));
+
+	OptionInputs in;
+	OptionArrays arrays;
+	Size served = 0;
+	for (;;) {
+		try {
+			if (reader->read(&in, 1) == 0)
+				break;
+			LoadOptionArrays(&in, 1, settlementDate, arrays);
+			WriteOptionResults(arrays, *sink, served++);
+		}
+		catch (std::exception & e) {
+			report << e.what() << std::endl;
+		}
+	}
+
+	report << "Served " << served << " options" << std::endl;
+}
+
+// Print the elapsed time of the run
+void PrintRunTime(std::ostream & os,
+	Real seconds)
+{
+	Integer hours = int(seconds / 3600);
+	seconds -= hours * 3600;
+	Integer minutes = int(seconds / 60);
+	seconds -= minutes * 60;
+	os << " \nRun completed in ";
+	if (hours > 0)
+		os << hours << " h ";
+	if (hours > 0 || minutes > 0)
+		os << minutes << " m ";
+
+	// Output the elapsed time
+	os << std::fixed << std::setprecision(5)
+		<< seconds << " s\n" << std::endl;
+}
+
+// Run the mode given on the command line and print timing information
+int main(int argc, char* argv[]) {
+
+	CommandLine cl;
 	try {
+		cl = ParseCommandLine(argc, argv);
+	}
+	catch (std::exception& e) {
+		std::cerr << e.what() << std::endl << std::endl;
+		PrintUsage(std::cerr);
+		return 2;
+	}
+
+	if (cl.help) {
+		PrintUsage(std::cout);
+		return 0;
+	}
+
+	try {
+
+		// Start the wall-clock timer
+		Stopwatch watch;
+
+		// Set up dates
+		Calendar calendar = TARGET();
+		Date todaysDate(15, May, 1998);
+		Date settlementDate(17, May, 1998);
+		Settings::instance().evaluationDate() = todaysDate;
 
-		// Start the timer
-		boost::timer timer;
+		// Batch and server runs, and benchmark runs with their CSV on
+		// --output -, may write their results to std::cout
+		std::ostream & report = cl.mode == CommandLine::Batch
+			|| cl.mode == CommandLine::Server
+			|| (cl.mode == CommandLine::BenchmarkSuite && cl.output == "-")
+			? std::cerr : std::cout;
 
-		// Price the option
-		EquityOption();
+		switch (cl.mode) {
+		case CommandLine::Single:
+			RunSingle(cl, todaysDate, settlementDate, calendar);
+			break;
+		case CommandLine::Batch:
+			RunBatch(cl, settlementDate, report);
+			break;
+		case CommandLine::BenchmarkSuite:
+			RunBenchmark(cl, todaysDate, settlementDate, calendar);
+			break;
+		case CommandLine::Server:
+			RunServer(cl, settlementDate, report);
+			break;
+		}
 
 		// Get the elapsed time
-		Real seconds = timer.elapsed();
-		Integer hours = int(seconds / 3600);
-		seconds -= hours * 3600;
-		Integer minutes = int(seconds / 60);
-		seconds -= minutes * 60;
-		std::cout << " \nRun completed in ";
-		if (hours > 0)
-			std::cout << hours << " h ";
-		if (hours > 0 || minutes > 0)
-			std::cout << minutes << " m ";
-
-		// Output the elapsed time
-		std::cout << std::fixed << std::setprecision(5)
-			<< seconds << " s\n" << std::endl;
-
-		// Ask the user to continue
-		PressEnter();
+		PrintRunTime(report, watch.seconds());
 
 		// Exit
 		return 0;
@@ -257,13 +2288,13 @@ int main(int, char*[]) {
 
 	// Known unknown exceptions
 	catch (std::exception& e) {
-		std::cout << e.what() << std::endl;
+		std::cerr << e.what() << std::endl;
 		return 1;
 	}
 
 	// Unknown unknown exceptions
 	catch (...) {
-		std::cout << "unknown error" << std::endl;
+		std::cerr << "unknown error" << std::endl;
 		return 1;
 	}
 }
\ No newline at end of file
@@ -0,0 +1,291 @@
+/* -*- mode: c++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+// QuantLib Black-Scholes-Merton test - results output
+
+#include "ResultsSink.hpp"
+
+#include <boost/cstdint.hpp>
+#include <algorithm>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+using namespace QuantLib;
+
+namespace {
+
+	const char resultsMagic[8] = { 'Q', 'L', 'R', 'E', 'S', 'V', '0', '1' };
+	const Size resultsHeaderSize = 64;
+
+	const char * const columnNames[] = { "npv", "delta", "gamma", "vega",
+		"theta", "rho", "dividendRho", "vanna", "volga" };
+	const Size columnCount = LENGTH(columnNames);
+
+	struct ResultsHeader {
+		char magic[8];
+		boost::uint64_t rows;
+		boost::uint64_t columns;
+		boost::uint64_t stride;
+		char reserved[32];
+	};
+
+}
+
+// Read-write file with one mapped window per column
+class MappedResultsSink::MappedFile
+{
+
+public:
+
+	MappedFile(const std::string & path,
+		boost::uint64_t size)
+	{
+		for (Size w = 0; w < columnCount; ++w) {
+			views_[w] = 0;
+			viewSizes_[w] = 0;
+		}
+#if defined(_WIN32)
+		file_ = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, 0, 0,
+			CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, 0);
+		QL_REQUIRE(file_ != INVALID_HANDLE_VALUE, "cannot create " << path);
+		mapping_ = CreateFileMappingA(file_, 0, PAGE_READWRITE,
+			DWORD(size >> 32), DWORD(size & 0xffffffff), 0);
+		if (mapping_ == 0) {
+			CloseHandle(file_);
+			QL_FAIL("cannot size " << path << " to " << size << " bytes");
+		}
+		SYSTEM_INFO info;
+		GetSystemInfo(&info);
+		granularity_ = info.dwAllocationGranularity;
+#else
+		fd_ = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+		QL_REQUIRE(fd_ >= 0, "cannot create " << path);
+		if (::ftruncate(fd_, off_t(size)) != 0) {
+			::close(fd_);
+			QL_FAIL("cannot size " << path << " to " << size << " bytes");
+		}
+		granularity_ = ::sysconf(_SC_PAGESIZE);
+#endif
+	}
+
+	~MappedFile()
+	{
+		for (Size w = 0; w < columnCount; ++w)
+			unmap(w);
+#if defined(_WIN32)
+		CloseHandle(mapping_);
+		CloseHandle(file_);
+#else
+		::close(fd_);
+#endif
+	}
+
+	// Map [offset, offset + length) in window w, in place of what it
+	// held, and return a pointer to offset
+	char * view(Size w,
+		boost::uint64_t offset,
+		Size length)
+	{
+		unmap(w);
+
+		boost::uint64_t base = offset - offset % granularity_;
+		viewSizes_[w] = Size(offset - base) + length;
+#if defined(_WIN32)
+		views_[w] = MapViewOfFile(mapping_, FILE_MAP_WRITE,
+			DWORD(base >> 32), DWORD(base & 0xffffffff), viewSizes_[w]);
+		QL_REQUIRE(views_[w] != 0, "cannot map view at " << base);
+#else
+		views_[w] = ::mmap(0, viewSizes_[w], PROT_READ | PROT_WRITE,
+			MAP_SHARED, fd_, off_t(base));
+		if (views_[w] == MAP_FAILED)
+			views_[w] = 0;
+		QL_REQUIRE(views_[w] != 0, "cannot map view at " << base);
+#endif
+		return static_cast<char *>(views_[w]) + (offset - base);
+	}
+
+	// The open windows and the pages of earlier ones
+	void flush()
+	{
+#if defined(_WIN32)
+		for (Size w = 0; w < columnCount; ++w)
+			if (views_[w] != 0)
+				FlushViewOfFile(views_[w], viewSizes_[w]);
+		FlushFileBuffers(file_);
+#else
+		for (Size w = 0; w < columnCount; ++w)
+			if (views_[w] != 0)
+				::msync(views_[w], viewSizes_[w], MS_SYNC);
+		::fsync(fd_);
+#endif
+	}
+
+private:
+
+	void unmap(Size w)
+	{
+		if (views_[w] == 0)
+			return;
+#if defined(_WIN32)
+		UnmapViewOfFile(views_[w]);
+#else
+		::munmap(views_[w], viewSizes_[w]);
+#endif
+		views_[w] = 0;
+	}
+
+#if defined(_WIN32)
+	HANDLE file_;
+	HANDLE mapping_;
+#else
+	int fd_;
+#endif
+	boost::uint64_t granularity_;
+	void * views_[columnCount];
+	Size viewSizes_[columnCount];
+
+};
+
+MappedResultsSink::MappedResultsSink(const std::string & path,
+	Size rows) :
+	file_(0),
+	rows_(rows),
+	stride_((rows + 7) / 8 * 8)
+{
+	file_ = new MappedFile(path, resultsHeaderSize
+		+ boost::uint64_t(columnCount) * stride_ * sizeof(Real));
+
+	ResultsHeader header;
+	std::memset(&header, 0, sizeof(header));
+	std::memcpy(header.magic, resultsMagic, sizeof(resultsMagic));
+	header.rows = rows_;
+	header.columns = columnCount;
+	header.stride = stride_;
+	std::memcpy(file_->view(0, 0, sizeof(header)), &header, sizeof(header));
+}
+
+MappedResultsSink::~MappedResultsSink()
+{
+	delete file_;
+}
+
+OptionResultColumns MappedResultsSink::reserve(Size first,
+	Size n)
+{
+	Real * columns[columnCount];
+	for (Size c = 0; c < columnCount; ++c)
+		columns[c] = window(c, first, n);
+	OptionResultColumns result = { columns[0], columns[1], columns[2],
+		columns[3], columns[4], columns[5], columns[6], columns[7],
+		columns[8] };
+	return result;
+}
+
+void MappedResultsSink::commit(Size,
+	Size)
+{
+	// The results are already in place
+}
+
+void MappedResultsSink::flush()
+{
+	file_->flush();
+}
+
+const Real * MappedResultsSink::column(Size c,
+	Size first,
+	Size n)
+{
+	QL_REQUIRE(c < columnCount, "no results column " << c);
+	return window(c, first, n);
+}
+
+Real * MappedResultsSink::window(Size c,
+	Size first,
+	Size n)
+{
+	QL_REQUIRE(first <= rows_ && n <= rows_ - first,
+		"rows " << first << " to " << first + n
+		<< " are outside a results file of " << rows_ << " rows");
+	return reinterpret_cast<Real *>(file_->view(c, resultsHeaderSize
+		+ (boost::uint64_t(c) * stride_ + first) * sizeof(Real),
+		std::max<Size>(n, 1) * sizeof(Real)));
+}
+
+TableResultsSink::TableResultsSink(std::ostream & os) :
+	os_(os)
+{
+	printHeader();
+}
+
+TableResultsSink::TableResultsSink(const std::string & path) :
+	file_(path.c_str()),
+	os_(file_)
+{
+	QL_REQUIRE(file_, "cannot create " << path);
+	printHeader();
+}
+
+void TableResultsSink::printHeader()
+{
+	os_ << std::setw(10) << std::left << "option";
+	for (Size c = 0; c < columnCount; ++c)
+		os_ << std::setw(14) << std::left << columnNames[c];
+	os_ << std::endl;
+}
+
+OptionResultColumns TableResultsSink::reserve(Size,
+	Size n)
+{
+	buffer_.resize(n);
+	return buffer_.columns();
+}
+
+void TableResultsSink::commit(Size first,
+	Size n)
+{
+	const std::vector<Real> * columns[] = { &buffer_.npv, &buffer_.delta,
+		&buffer_.gamma, &buffer_.vega, &buffer_.theta, &buffer_.rho,
+		&buffer_.dividendRho, &buffer_.vanna, &buffer_.volga };
+
+	for (Size i = 0; i < n; ++i) {
+		os_ << std::setw(10) << std::left << first + i;
+		for (Size c = 0; c < columnCount; ++c)
+			os_ << std::setw(14) << std::left << (*columns[c])[i];
+		os_ << '\n';
+	}
+	os_.flush();
+}
+
+ResultsSink * OpenResultsSink(const std::string & path,
+	Size rows)
+{
+	const std::string table = ".txt";
+
+	if (path == "-")
+		return new TableResultsSink(std::cout);
+	if (path.size() >= table.size()
+		&& path.compare(path.size() - table.size(), table.size(), table) == 0)
+		return new TableResultsSink(path);
+	return new MappedResultsSink(path, rows);
+}
+
+void WriteOptionResults(const OptionArrays & arrays,
+	ResultsSink & sink,
+	Size first)
+{
+	const Size n = arrays.size();
+	if (n == 0)
+		return;
+
+	BlackScholesGreeksKernel(arrays, sink.reserve(first, n));
+	sink.commit(first, n);
+}
@@ -0,0 +1,149 @@
+/* -*- mode: c++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+// QuantLib Black-Scholes-Merton test - results output
+
+#ifndef quantlibtest3_results_sink_hpp
+#define quantlibtest3_results_sink_hpp
+
+#include "BlackScholesKernel.hpp"
+#include <fstream>
+#include <string>
+
+/** Destination for the price and greeks of a book.
+
+A producer asks for storage for rows [first, first + n) with
+reserve(), fills it (typically with BlackScholesGreeksKernel) and
+hands it back with commit(). Sinks that can expose their final
+storage directly, like MappedResultsSink, make the whole path
+zero-copy.
+*/
+class ResultsSink
+{
+
+public:
+
+	virtual ~ResultsSink() {}
+
+	virtual OptionResultColumns reserve(QuantLib::Size first,
+		QuantLib::Size n) = 0;
+
+	virtual void commit(QuantLib::Size first,
+		QuantLib::Size n) = 0;
+
+};
+
+/* Mapped results format: a 64-byte header
+
+    char magic[8];           "QLRESV01"
+    uint64 rows;
+    uint64 columns;          9: npv, delta, gamma, vega, theta, rho,
+                             dividendRho, vanna, volga
+    uint64 stride;           doubles between column starts
+    char reserved[32];
+
+followed by the columns, each stride little-endian doubles of which
+the first rows are used. stride is rows rounded up to a multiple of
+8, so every column starts on a 64-byte boundary and can be mapped
+and read as a plain double array.
+*/
+
+/** Writes results straight into a memory-mapped columnar file.
+
+The file is sized for rows options up front, but only the rows asked
+for are mapped: reserve() maps a window of each column over them and
+returns pointers into those windows, so there is no formatting and no
+copy on the way out, and the address space used is that of one
+reservation rather than of the file, which on 32-bit builds could not
+be mapped whole past a few million rows. The windows of a reservation
+stay valid until the next reserve() or column(). The data reach the
+disk as the windows move on and when the sink is destroyed, or
+earlier with flush().
+*/
+class MappedResultsSink :
+	public ResultsSink
+{
+
+public:
+
+	MappedResultsSink(const std::string & path,
+		QuantLib::Size rows);
+	~MappedResultsSink();
+
+	OptionResultColumns reserve(QuantLib::Size first,
+		QuantLib::Size n);
+
+	void commit(QuantLib::Size first,
+		QuantLib::Size n);
+
+	// Write the results so far back to the file
+	void flush();
+
+	QuantLib::Size rows() const { return rows_; }
+
+	// Rows [first, first + n) of column c, in the order of the file
+	// header, mapped in place of the reserved window of that column
+	const QuantLib::Real * column(QuantLib::Size c,
+		QuantLib::Size first,
+		QuantLib::Size n);
+
+private:
+
+	class MappedFile;
+
+	// Map rows [first, first + n) of column c
+	QuantLib::Real * window(QuantLib::Size c,
+		QuantLib::Size first,
+		QuantLib::Size n);
+
+	MappedFile * file_;
+	QuantLib::Size rows_;
+	QuantLib::Size stride_;
+
+	MappedResultsSink(const MappedResultsSink &);
+	MappedResultsSink & operator=(const MappedResultsSink &);
+
+};
+
+/** Prints results as a human-readable table, one row per option.
+
+Formatting every cell costs far more than pricing, so this is meant
+for debugging small books, not for production output.
+*/
+class TableResultsSink :
+	public ResultsSink
+{
+
+public:
+
+	explicit TableResultsSink(std::ostream & os);
+	explicit TableResultsSink(const std::string & path);
+
+	OptionResultColumns reserve(QuantLib::Size first,
+		QuantLib::Size n);
+
+	void commit(QuantLib::Size first,
+		QuantLib::Size n);
+
+private:
+
+	std::ofstream file_;
+	std::ostream & os_;
+	OptionResults buffer_;
+
+	void printHeader();
+
+};
+
+/* Sink for an output argument: "-" prints a table on std::cout, a
+path ending in .txt gets a table and any other path a mapped
+columnar file of the given number of rows.
+*/
+ResultsSink * OpenResultsSink(const std::string & path,
+	QuantLib::Size rows);
+
+// Price and greeks of arrays, written to rows [first, first + size) of sink
+void WriteOptionResults(const OptionArrays & arrays,
+	ResultsSink & sink,
+	QuantLib::Size first = 0);
+
+#endif
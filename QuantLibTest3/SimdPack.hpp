@@ -0,0 +1,385 @@
+/* -*- mode: c++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+// QuantLib Black-Scholes-Merton test - SIMD register packs
+
+#ifndef quantlibtest3_simd_pack_hpp
+#define quantlibtest3_simd_pack_hpp
+
+#include <cmath>
+#include <cstring>
+
+#if defined(__AVX2__) || defined(__AVX512F__)
+#include <immintrin.h>
+#endif
+
+/** Thin wrappers over a register of doubles or floats.
+
+Each pack exposes the same static interface so that the math
+functions and pricing kernels can be written once as templates and
+instantiated for the widest instruction set the build targets
+(see simd::Native and simd::FloatNative). The scalar packs are used
+for loop tails and for builds without AVX2. set1() takes a double
+in every pack, so that constants are written once for both
+precisions.
+*/
+
+namespace simd {
+
+	// One double per register
+	struct Scalar
+	{
+		typedef double value_type;
+		typedef double reg;
+		typedef bool mask;
+		enum { width = 1 };
+
+		static reg load(const double * p) { return *p; }
+		static void store(double * p, reg a) { *p = a; }
+		static reg set1(double a) { return a; }
+
+		static reg add(reg a, reg b) { return a + b; }
+		static reg sub(reg a, reg b) { return a - b; }
+		static reg mul(reg a, reg b) { return a * b; }
+		static reg div(reg a, reg b) { return a / b; }
+		static reg fmadd(reg a, reg b, reg c) { return a * b + c; }
+		static reg neg(reg a) { return -a; }
+		static reg abs(reg a) { return std::fabs(a); }
+		static reg min(reg a, reg b) { return a < b ? a : b; }
+		static reg max(reg a, reg b) { return a > b ? a : b; }
+		static reg sqrt(reg a) { return std::sqrt(a); }
+		static reg round(reg a) { return std::floor(a + 0.5); }
+
+		static mask lt(reg a, reg b) { return a < b; }
+		static mask gt(reg a, reg b) { return a > b; }
+		static mask le(reg a, reg b) { return a <= b; }
+		static mask ge(reg a, reg b) { return a >= b; }
+		static mask maskAnd(mask a, mask b) { return a && b; }
+		static mask maskOr(mask a, mask b) { return a || b; }
+		static reg select(mask m, reg a, reg b) { return m ? a : b; }
+
+		// 2^n for integral n in [-1022, 1023]
+		static reg pow2n(reg n)
+		{
+			unsigned long long bits =
+				(unsigned long long)((long long)n + 1023) << 52;
+			double d;
+			std::memcpy(&d, &bits, sizeof(d));
+			return d;
+		}
+
+		// Unbiased binary exponent of a positive normal number
+		static reg exponent(reg a)
+		{
+			unsigned long long bits;
+			std::memcpy(&bits, &a, sizeof(bits));
+			return double((long long)((bits >> 52) & 0x7ff) - 1023);
+		}
+
+		// Mantissa of a positive normal number, in [1, 2)
+		static reg mantissa(reg a)
+		{
+			unsigned long long bits;
+			std::memcpy(&bits, &a, sizeof(bits));
+			bits = (bits & 0x000fffffffffffffULL) | 0x3ff0000000000000ULL;
+			double d;
+			std::memcpy(&d, &bits, sizeof(d));
+			return d;
+		}
+	};
+
+	// One float per register
+	struct FloatScalar
+	{
+		typedef float value_type;
+		typedef float reg;
+		typedef bool mask;
+		enum { width = 1 };
+
+		static reg load(const float * p) { return *p; }
+		static void store(float * p, reg a) { *p = a; }
+		static reg set1(double a) { return float(a); }
+
+		static reg add(reg a, reg b) { return a + b; }
+		static reg sub(reg a, reg b) { return a - b; }
+		static reg mul(reg a, reg b) { return a * b; }
+		static reg div(reg a, reg b) { return a / b; }
+		static reg fmadd(reg a, reg b, reg c) { return a * b + c; }
+		static reg neg(reg a) { return -a; }
+		static reg abs(reg a) { return std::fabs(a); }
+		static reg min(reg a, reg b) { return a < b ? a : b; }
+		static reg max(reg a, reg b) { return a > b ? a : b; }
+		static reg sqrt(reg a) { return std::sqrt(a); }
+		static reg round(reg a) { return std::floor(a + 0.5f); }
+
+		static mask lt(reg a, reg b) { return a < b; }
+		static mask gt(reg a, reg b) { return a > b; }
+		static mask le(reg a, reg b) { return a <= b; }
+		static mask ge(reg a, reg b) { return a >= b; }
+		static mask maskAnd(mask a, mask b) { return a && b; }
+		static mask maskOr(mask a, mask b) { return a || b; }
+		static reg select(mask m, reg a, reg b) { return m ? a : b; }
+
+		// 2^n for integral n in [-126, 127]
+		static reg pow2n(reg n)
+		{
+			unsigned int bits = (unsigned int)((int)n + 127) << 23;
+			float f;
+			std::memcpy(&f, &bits, sizeof(f));
+			return f;
+		}
+
+		static reg exponent(reg a)
+		{
+			unsigned int bits;
+			std::memcpy(&bits, &a, sizeof(bits));
+			return float((int)((bits >> 23) & 0xff) - 127);
+		}
+
+		static reg mantissa(reg a)
+		{
+			unsigned int bits;
+			std::memcpy(&bits, &a, sizeof(bits));
+			bits = (bits & 0x007fffffU) | 0x3f800000U;
+			float f;
+			std::memcpy(&f, &bits, sizeof(f));
+			return f;
+		}
+	};
+
+#if defined(__AVX2__)
+
+	// Four doubles per register
+	struct Avx2
+	{
+		typedef double value_type;
+		typedef __m256d reg;
+		typedef __m256d mask;
+		enum { width = 4 };
+
+		static reg load(const double * p) { return _mm256_loadu_pd(p); }
+		static void store(double * p, reg a) { _mm256_storeu_pd(p, a); }
+		static reg set1(double a) { return _mm256_set1_pd(a); }
+
+		static reg add(reg a, reg b) { return _mm256_add_pd(a, b); }
+		static reg sub(reg a, reg b) { return _mm256_sub_pd(a, b); }
+		static reg mul(reg a, reg b) { return _mm256_mul_pd(a, b); }
+		static reg div(reg a, reg b) { return _mm256_div_pd(a, b); }
+#if defined(__FMA__)
+		static reg fmadd(reg a, reg b, reg c) { return _mm256_fmadd_pd(a, b, c); }
+#else
+		static reg fmadd(reg a, reg b, reg c) { return add(mul(a, b), c); }
+#endif
+		static reg neg(reg a) { return _mm256_xor_pd(a, _mm256_set1_pd(-0.0)); }
+		static reg abs(reg a) { return _mm256_andnot_pd(_mm256_set1_pd(-0.0), a); }
+		static reg min(reg a, reg b) { return _mm256_min_pd(a, b); }
+		static reg max(reg a, reg b) { return _mm256_max_pd(a, b); }
+		static reg sqrt(reg a) { return _mm256_sqrt_pd(a); }
+		static reg round(reg a)
+		{
+			return _mm256_round_pd(a, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+		}
+
+		static mask lt(reg a, reg b) { return _mm256_cmp_pd(a, b, _CMP_LT_OQ); }
+		static mask gt(reg a, reg b) { return _mm256_cmp_pd(a, b, _CMP_GT_OQ); }
+		static mask le(reg a, reg b) { return _mm256_cmp_pd(a, b, _CMP_LE_OQ); }
+		static mask ge(reg a, reg b) { return _mm256_cmp_pd(a, b, _CMP_GE_OQ); }
+		static mask maskAnd(mask a, mask b) { return _mm256_and_pd(a, b); }
+		static mask maskOr(mask a, mask b) { return _mm256_or_pd(a, b); }
+		static reg select(mask m, reg a, reg b) { return _mm256_blendv_pd(b, a, m); }
+
+		// Adding 2^52 leaves n + 1023 in the low mantissa bits
+		static reg pow2n(reg n)
+		{
+			__m256i bits = _mm256_castpd_si256(
+				_mm256_add_pd(n, _mm256_set1_pd(1023.0 + 4503599627370496.0)));
+			return _mm256_castsi256_pd(_mm256_slli_epi64(bits, 52));
+		}
+
+		static reg exponent(reg a)
+		{
+			__m256i e = _mm256_srli_epi64(_mm256_castpd_si256(a), 52);
+			e = _mm256_or_si256(e, _mm256_set1_epi64x(0x4330000000000000LL));
+			return _mm256_sub_pd(_mm256_castsi256_pd(e),
+				_mm256_set1_pd(4503599627370496.0 + 1023.0));
+		}
+
+		static reg mantissa(reg a)
+		{
+			__m256i bits = _mm256_and_si256(_mm256_castpd_si256(a),
+				_mm256_set1_epi64x(0x000fffffffffffffLL));
+			bits = _mm256_or_si256(bits, _mm256_set1_epi64x(0x3ff0000000000000LL));
+			return _mm256_castsi256_pd(bits);
+		}
+	};
+
+	// Eight floats per register
+	struct FloatAvx2
+	{
+		typedef float value_type;
+		typedef __m256 reg;
+		typedef __m256 mask;
+		enum { width = 8 };
+
+		static reg load(const float * p) { return _mm256_loadu_ps(p); }
+		static void store(float * p, reg a) { _mm256_storeu_ps(p, a); }
+		static reg set1(double a) { return _mm256_set1_ps(float(a)); }
+
+		static reg add(reg a, reg b) { return _mm256_add_ps(a, b); }
+		static reg sub(reg a, reg b) { return _mm256_sub_ps(a, b); }
+		static reg mul(reg a, reg b) { return _mm256_mul_ps(a, b); }
+		static reg div(reg a, reg b) { return _mm256_div_ps(a, b); }
+#if defined(__FMA__)
+		static reg fmadd(reg a, reg b, reg c) { return _mm256_fmadd_ps(a, b, c); }
+#else
+		static reg fmadd(reg a, reg b, reg c) { return add(mul(a, b), c); }
+#endif
+		static reg neg(reg a) { return _mm256_xor_ps(a, _mm256_set1_ps(-0.0f)); }
+		static reg abs(reg a) { return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a); }
+		static reg min(reg a, reg b) { return _mm256_min_ps(a, b); }
+		static reg max(reg a, reg b) { return _mm256_max_ps(a, b); }
+		static reg sqrt(reg a) { return _mm256_sqrt_ps(a); }
+		static reg round(reg a)
+		{
+			return _mm256_round_ps(a, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+		}
+
+		static mask lt(reg a, reg b) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+		static mask gt(reg a, reg b) { return _mm256_cmp_ps(a, b, _CMP_GT_OQ); }
+		static mask le(reg a, reg b) { return _mm256_cmp_ps(a, b, _CMP_LE_OQ); }
+		static mask ge(reg a, reg b) { return _mm256_cmp_ps(a, b, _CMP_GE_OQ); }
+		static mask maskAnd(mask a, mask b) { return _mm256_and_ps(a, b); }
+		static mask maskOr(mask a, mask b) { return _mm256_or_ps(a, b); }
+		static reg select(mask m, reg a, reg b) { return _mm256_blendv_ps(b, a, m); }
+
+		// Adding 2^23 leaves n + 127 in the low mantissa bits
+		static reg pow2n(reg n)
+		{
+			__m256i bits = _mm256_castps_si256(
+				_mm256_add_ps(n, _mm256_set1_ps(127.0f + 8388608.0f)));
+			return _mm256_castsi256_ps(_mm256_slli_epi32(bits, 23));
+		}
+
+		static reg exponent(reg a)
+		{
+			__m256i e = _mm256_srli_epi32(_mm256_castps_si256(a), 23);
+			e = _mm256_or_si256(e, _mm256_set1_epi32(0x4b000000));
+			return _mm256_sub_ps(_mm256_castsi256_ps(e),
+				_mm256_set1_ps(8388608.0f + 127.0f));
+		}
+
+		static reg mantissa(reg a)
+		{
+			__m256i bits = _mm256_and_si256(_mm256_castps_si256(a),
+				_mm256_set1_epi32(0x007fffff));
+			bits = _mm256_or_si256(bits, _mm256_set1_epi32(0x3f800000));
+			return _mm256_castsi256_ps(bits);
+		}
+	};
+
+#endif
+
+#if defined(__AVX512F__)
+
+	// Eight doubles per register
+	struct Avx512
+	{
+		typedef double value_type;
+		typedef __m512d reg;
+		typedef __mmask8 mask;
+		enum { width = 8 };
+
+		static reg load(const double * p) { return _mm512_loadu_pd(p); }
+		static void store(double * p, reg a) { _mm512_storeu_pd(p, a); }
+		static reg set1(double a) { return _mm512_set1_pd(a); }
+
+		static reg add(reg a, reg b) { return _mm512_add_pd(a, b); }
+		static reg sub(reg a, reg b) { return _mm512_sub_pd(a, b); }
+		static reg mul(reg a, reg b) { return _mm512_mul_pd(a, b); }
+		static reg div(reg a, reg b) { return _mm512_div_pd(a, b); }
+		static reg fmadd(reg a, reg b, reg c) { return _mm512_fmadd_pd(a, b, c); }
+		static reg neg(reg a) { return _mm512_sub_pd(_mm512_setzero_pd(), a); }
+		static reg abs(reg a) { return _mm512_abs_pd(a); }
+		static reg min(reg a, reg b) { return _mm512_min_pd(a, b); }
+		static reg max(reg a, reg b) { return _mm512_max_pd(a, b); }
+		static reg sqrt(reg a) { return _mm512_sqrt_pd(a); }
+		static reg round(reg a)
+		{
+			return _mm512_roundscale_pd(a, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+		}
+
+		static mask lt(reg a, reg b) { return _mm512_cmp_pd_mask(a, b, _CMP_LT_OQ); }
+		static mask gt(reg a, reg b) { return _mm512_cmp_pd_mask(a, b, _CMP_GT_OQ); }
+		static mask le(reg a, reg b) { return _mm512_cmp_pd_mask(a, b, _CMP_LE_OQ); }
+		static mask ge(reg a, reg b) { return _mm512_cmp_pd_mask(a, b, _CMP_GE_OQ); }
+		static mask maskAnd(mask a, mask b) { return mask(a & b); }
+		static mask maskOr(mask a, mask b) { return mask(a | b); }
+		static reg select(mask m, reg a, reg b) { return _mm512_mask_blend_pd(m, b, a); }
+
+		static reg pow2n(reg n) { return _mm512_scalef_pd(_mm512_set1_pd(1.0), n); }
+		static reg exponent(reg a) { return _mm512_getexp_pd(a); }
+		static reg mantissa(reg a)
+		{
+			return _mm512_getmant_pd(a, _MM_MANT_NORM_1_2, _MM_MANT_SIGN_src);
+		}
+	};
+
+	// Sixteen floats per register
+	struct FloatAvx512
+	{
+		typedef float value_type;
+		typedef __m512 reg;
+		typedef __mmask16 mask;
+		enum { width = 16 };
+
+		static reg load(const float * p) { return _mm512_loadu_ps(p); }
+		static void store(float * p, reg a) { _mm512_storeu_ps(p, a); }
+		static reg set1(double a) { return _mm512_set1_ps(float(a)); }
+
+		static reg add(reg a, reg b) { return _mm512_add_ps(a, b); }
+		static reg sub(reg a, reg b) { return _mm512_sub_ps(a, b); }
+		static reg mul(reg a, reg b) { return _mm512_mul_ps(a, b); }
+		static reg div(reg a, reg b) { return _mm512_div_ps(a, b); }
+		static reg fmadd(reg a, reg b, reg c) { return _mm512_fmadd_ps(a, b, c); }
+		static reg neg(reg a) { return _mm512_sub_ps(_mm512_setzero_ps(), a); }
+		static reg abs(reg a) { return _mm512_abs_ps(a); }
+		static reg min(reg a, reg b) { return _mm512_min_ps(a, b); }
+		static reg max(reg a, reg b) { return _mm512_max_ps(a, b); }
+		static reg sqrt(reg a) { return _mm512_sqrt_ps(a); }
+		static reg round(reg a)
+		{
+			return _mm512_roundscale_ps(a, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+		}
+
+		static mask lt(reg a, reg b) { return _mm512_cmp_ps_mask(a, b, _CMP_LT_OQ); }
+		static mask gt(reg a, reg b) { return _mm512_cmp_ps_mask(a, b, _CMP_GT_OQ); }
+		static mask le(reg a, reg b) { return _mm512_cmp_ps_mask(a, b, _CMP_LE_OQ); }
+		static mask ge(reg a, reg b) { return _mm512_cmp_ps_mask(a, b, _CMP_GE_OQ); }
+		static mask maskAnd(mask a, mask b) { return mask(a & b); }
+		static mask maskOr(mask a, mask b) { return mask(a | b); }
+		static reg select(mask m, reg a, reg b) { return _mm512_mask_blend_ps(m, b, a); }
+
+		static reg pow2n(reg n) { return _mm512_scalef_ps(_mm512_set1_ps(1.0f), n); }
+		static reg exponent(reg a) { return _mm512_getexp_ps(a); }
+		static reg mantissa(reg a)
+		{
+			return _mm512_getmant_ps(a, _MM_MANT_NORM_1_2, _MM_MANT_SIGN_src);
+		}
+	};
+
+#endif
+
+	// Widest packs available to this build
+#if defined(__AVX512F__)
+	typedef Avx512 Native;
+	typedef FloatAvx512 FloatNative;
+#elif defined(__AVX2__)
+	typedef Avx2 Native;
+	typedef FloatAvx2 FloatNative;
+#else
+	typedef Scalar Native;
+	typedef FloatScalar FloatNative;
+#endif
+
+}
+
+#endif
@@ -0,0 +1,88 @@
+/* -*- mode: c++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+// QuantLib Black-Scholes-Merton test - static snapshot pricing
+
+#include "SnapshotPricer.hpp"
+
+#include <cmath>
+
+using namespace QuantLib;
+
+MarketSnapshot::MarketSnapshot(const OptionInputs & in,
+	const Date & settlementDate) :
+	settlementDate_(settlementDate),
+	dayCounter_(in.dayCounter),
+	spot_(in.underlying),
+	riskFreeRate_(in.riskFreeRate),
+	dividendYield_(in.dividendYield),
+	volatility_(in.volatility)
+{
+	QL_REQUIRE(spot_ > 0.0, "negative or null underlying given");
+}
+
+Time MarketSnapshot::time(const Date & d) const
+{
+	return dayCounter_.yearFraction(settlementDate_, d);
+}
+
+// Continuous compounding, as FlatForward's default
+DiscountFactor MarketSnapshot::riskFreeDiscount(Time t) const
+{
+	return std::exp(-riskFreeRate_ * t);
+}
+
+DiscountFactor MarketSnapshot::dividendDiscount(Time t) const
+{
+	return std::exp(-dividendYield_ * t);
+}
+
+Real MarketSnapshot::variance(Time t) const
+{
+	return volatility_ * volatility_ * t;
+}
+
+namespace {
+
+	// The forward, standard deviation and discount factor that
+	// AnalyticEuropeanEngine hands BlackCalculator
+	Real BlackPrice(const MarketSnapshot & market,
+		Option::Type type,
+		Real strike,
+		const Date & maturity)
+	{
+		Time t = market.time(maturity);
+		DiscountFactor riskFreeDiscount = market.riskFreeDiscount(t);
+		Real forward = market.spot() * market.dividendDiscount(t) / riskFreeDiscount;
+		BlackCalculator black(type, strike, forward,
+			std::sqrt(market.variance(t)), riskFreeDiscount);
+		return black.value();
+	}
+
+}
+
+Real SnapshotPrice(const MarketSnapshot & market,
+	Option::Type type,
+	Real strike,
+	const Date & maturity)
+{
+	// Expired options are worth nothing, as for Instrument::NPV()
+	if (maturity <= Settings::instance().evaluationDate())
+		return 0.0;
+	return BlackPrice(market, type, strike, maturity);
+}
+
+void SnapshotPrice(const OptionInputs * inputs,
+	Size n,
+	const Date & settlementDate,
+	Real * npvs)
+{
+	const Date today = Settings::instance().evaluationDate();
+
+	for (Size i = 0; i < n; ++i) {
+		const OptionInputs & in = inputs[i];
+		npvs[i] = in.maturity <= today
+			? 0.0
+			: BlackPrice(MarketSnapshot(in, settlementDate), in.type, in.strike,
+			in.maturity);
+	}
+}
@@ -0,0 +1,61 @@
+/* -*- mode: c++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+// QuantLib Black-Scholes-Merton test - static snapshot pricing
+
+#ifndef quantlibtest3_snapshot_pricer_hpp
+#define quantlibtest3_snapshot_pricer_hpp
+
+#include "OptionInputs.hpp"
+
+/** The market of an option frozen as plain values.
+
+Holds what EquityOption()'s quote, flat curves and constant
+volatility would answer, computed the same way, without any of them:
+no Handle, no Observable and no registration, so building one is a
+few copies and a snapshot can be copied, stored in arrays and shared
+between threads freely. Nothing can move it after construction; a new
+market is a new snapshot.
+*/
+class MarketSnapshot
+{
+
+public:
+
+	MarketSnapshot(const OptionInputs & in,
+		const QuantLib::Date & settlementDate);
+
+	QuantLib::Real spot() const { return spot_; }
+
+	// Year fraction from the settlement date, as the term structures
+	QuantLib::Time time(const QuantLib::Date & d) const;
+
+	// As FlatForward::discount() and BlackConstantVol::blackVariance()
+	QuantLib::DiscountFactor riskFreeDiscount(QuantLib::Time t) const;
+	QuantLib::DiscountFactor dividendDiscount(QuantLib::Time t) const;
+	QuantLib::Real variance(QuantLib::Time t) const;
+
+private:
+
+	QuantLib::Date settlementDate_;
+	QuantLib::DayCounter dayCounter_;
+	QuantLib::Real spot_;
+	QuantLib::Rate riskFreeRate_;
+	QuantLib::Rate dividendYield_;
+	QuantLib::Volatility volatility_;
+
+};
+
+// A European on a snapshot through BlackCalculator, as
+// AnalyticEuropeanEngine prices it; zero once expired
+QuantLib::Real SnapshotPrice(const MarketSnapshot & market,
+	QuantLib::Option::Type type,
+	QuantLib::Real strike,
+	const QuantLib::Date & maturity);
+
+// Price n options from inputs into npvs[0..n), one snapshot each
+void SnapshotPrice(const OptionInputs * inputs,
+	QuantLib::Size n,
+	const QuantLib::Date & settlementDate,
+	QuantLib::Real * npvs);
+
+#endif
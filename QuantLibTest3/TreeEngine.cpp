@@ -0,0 +1,170 @@
+/* -*- mode: c++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+// QuantLib Black-Scholes-Merton test - binomial trees
+
+#include "TreeEngine.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace QuantLib;
+
+namespace {
+
+	// Peizer-Pratt method 2 inversion: the probability that makes the
+	// binomial distribution of n steps approximate N(z)
+	Real PeizerPratt(Real z,
+		Size n)
+	{
+		Real x = z / (n + 1.0 / 3.0 + 0.1 / (n + 1.0));
+		Real p = 0.5 * std::sqrt(1.0 - std::exp(-x * x * (n + 1.0 / 6.0)));
+		return z >= 0.0 ? 0.5 + p : 0.5 - p;
+	}
+
+	/* Values far out of the money are flushed to zero every few steps,
+	before they can become denormal: thousands of steps of discounting
+	would otherwise spread denormals over the tails, and arithmetic on
+	them is many times slower than on normal numbers. Even shrinking a
+	hundredfold per step, a negligible value stays normal for
+	flushInterval steps.
+	*/
+	const Real negligible = 1.0e-250;
+	const Size flushInterval = 16;
+
+}
+
+BinomialTreeEngine::BinomialTreeEngine(
+	const boost::shared_ptr<GeneralizedBlackScholesProcess> & process,
+	Tree tree,
+	Size timeSteps) :
+	process_(process),
+	tree_(tree),
+	timeSteps_(timeSteps)
+{
+	QL_REQUIRE(timeSteps_ >= 2, "at least two time steps are needed");
+
+	registerWith(process_);
+}
+
+void BinomialTreeEngine::calculate() const
+{
+	const Exercise::Type exerciseType = arguments_.exercise->type();
+	QL_REQUIRE(exerciseType == Exercise::American
+		|| exerciseType == Exercise::European,
+		"only American and European exercise are supported");
+	const bool american = exerciseType == Exercise::American;
+
+	boost::shared_ptr<StrikedTypePayoff> payoff =
+		boost::dynamic_pointer_cast<StrikedTypePayoff>(arguments_.payoff);
+	QL_REQUIRE(payoff, "non-striked payoff given");
+	const Real phi = payoff->optionType() == Option::Call ? 1.0 : -1.0;
+
+	const Time maturity = process_->time(arguments_.exercise->lastDate());
+	QL_REQUIRE(maturity > 0.0, "option expired");
+
+	const Real spot = process_->x0();
+	const Real strike = payoff->strike();
+	QL_REQUIRE(spot > 0.0, "non-positive spot " << spot);
+
+	const Rate r = -std::log(process_->riskFreeRate()->discount(maturity)) / maturity;
+	const Rate q = -std::log(process_->dividendYield()->discount(maturity)) / maturity;
+	const Real variance = process_->blackVolatility()->blackVariance(maturity, strike);
+	QL_REQUIRE(variance > 0.0, "non-positive variance " << variance);
+
+	const Size n = tree_ == LeisenReimer ? (timeSteps_ | 1) : timeSteps_;
+	const Time dt = maturity / n;
+	const Real stepVariance = variance / n;
+	const Real stepStdDev = std::sqrt(stepVariance);
+	const Real drift = (r - q) * dt - 0.5 * stepVariance;
+
+	// Up and down factors of the spot and the probability of going up
+	Real up, down, pu;
+	switch (tree_) {
+	case CoxRossRubinstein:
+		up = std::exp(stepStdDev);
+		down = 1.0 / up;
+		pu = 0.5 + 0.5 * drift / stepStdDev;
+		break;
+	case JarrowRudd:
+		up = std::exp(drift + stepStdDev);
+		down = std::exp(drift - stepStdDev);
+		pu = 0.5;
+		break;
+	case LeisenReimer:
+		{
+			Real stdDev = std::sqrt(variance);
+			Real d2 = (std::log(spot / strike) + drift * n) / stdDev;
+			Real growth = std::exp((r - q) * dt);
+			pu = PeizerPratt(d2, n);
+			up = growth * PeizerPratt(d2 + stdDev, n) / pu;
+			down = (growth - pu * up) / (1.0 - pu);
+		}
+		break;
+	default:
+		QL_FAIL("unknown binomial tree");
+	}
+	QL_REQUIRE(pu >= 0.0 && pu <= 1.0,
+		"probability " << pu << " out of range; more time steps are needed");
+
+	const DiscountFactor discount = std::exp(-r * dt);
+	const Real upWeight = discount * pu;
+	const Real downWeight = discount * (1.0 - pu);
+	const Real inverseDown = 1.0 / down;
+
+	// Nodes at maturity, from the lowest spot up
+	values_.resize(n + 1);
+	spots_.resize(n + 1);
+	Real * v = &values_[0];
+	Real * s = &spots_[0];
+	const Real logUp = std::log(up), logDown = std::log(down);
+	for (Size j = 0; j <= n; ++j) {
+		s[j] = spot * std::exp(j * logUp + (n - j) * logDown);
+		v[j] = std::max(phi * (s[j] - strike), 0.0);
+	}
+
+	// Roll back in place: node j of step i has node j of step i + 1
+	// below it and node j + 1 above it, and its spot is that of node
+	// j of step i + 1 divided by down
+	Real values1[2], spots1[2], values2[3], spots2[3];
+	for (Size i = n; i-- > 0; ) {
+		if (american) {
+			for (Size j = 0; j <= i; ++j) {
+				s[j] *= inverseDown;
+				Real continuation = downWeight * v[j] + upWeight * v[j + 1];
+				v[j] = std::max(continuation, phi * (s[j] - strike));
+			}
+		} else {
+			for (Size j = 0; j <= i; ++j)
+				v[j] = downWeight * v[j] + upWeight * v[j + 1];
+		}
+
+		if (i % flushInterval == 0) {
+			for (Size j = 0; j <= i; ++j)
+				if (v[j] < negligible)
+					v[j] = 0.0;
+		}
+
+		if (i == 2 || i == 1) {
+			Real * values = i == 2 ? values2 : values1;
+			Real * spots = i == 2 ? spots2 : spots1;
+			for (Size j = 0; j <= i; ++j) {
+				values[j] = v[j];
+				spots[j] = american
+					? s[j]
+					: spot * std::exp(j * logUp + (i - j) * logDown);
+			}
+		}
+	}
+
+	Real deltaUp = (values2[2] - values2[1]) / (spots2[2] - spots2[1]);
+	Real deltaDown = (values2[1] - values2[0]) / (spots2[1] - spots2[0]);
+
+	results_.value = v[0];
+	results_.delta = (values1[1] - values1[0]) / (spots1[1] - spots1[0]);
+	results_.gamma = (deltaUp - deltaDown) / (0.5 * (spots2[2] - spots2[0]));
+
+	// From the Black-Scholes equation, which the tree value satisfies
+	// as well as it prices the option
+	results_.theta = r * results_.value - (r - q) * spot * results_.delta
+		- 0.5 * variance / maturity * spot * spot * results_.gamma;
+}
@@ -0,0 +1,66 @@
+/* -*- mode: c++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+// QuantLib Black-Scholes-Merton test - binomial trees
+
+#ifndef quantlibtest3_tree_engine_hpp
+#define quantlibtest3_tree_engine_hpp
+
+#include <ql/quantlib.hpp>
+
+#include <vector>
+
+/** Binomial tree engine for American and European options on a
+Black-Scholes process.
+
+The trees are those of QuantLib's BinomialVanillaEngine:
+CoxRossRubinstein has equal and opposite jumps in log(S) with the
+drift in the probabilities, JarrowRudd has equal probabilities with
+the drift in the jumps, and LeisenReimer matches the binomial
+distribution to the Black-Scholes one by Peizer-Pratt inversion and
+takes an odd number of steps, one more than asked for if needed.
+Rate, dividend yield and volatility (at the strike) are the flat
+equivalents over the life of the option.
+
+The lattice is one array of values, and one of spots for American
+exercise, rolled back in place, so a step touches timeSteps + 1
+contiguous doubles and thousands of steps stay in cache. The arrays
+are allocated by the first calculation and reused by the next ones:
+an engine serves every option priced on one thread, and must not be
+shared by options priced on different threads at the same time.
+
+Results are value, delta and gamma from the first two steps of the
+tree and theta from the Black-Scholes equation.
+*/
+class BinomialTreeEngine :
+	public QuantLib::VanillaOption::engine
+{
+
+public:
+
+	enum Tree {
+		CoxRossRubinstein,
+		JarrowRudd,
+		LeisenReimer
+	};
+
+	BinomialTreeEngine(
+		const boost::shared_ptr<QuantLib::GeneralizedBlackScholesProcess> & process,
+		Tree tree,
+		QuantLib::Size timeSteps);
+
+	void calculate() const;
+
+private:
+
+	boost::shared_ptr<QuantLib::GeneralizedBlackScholesProcess> process_;
+	Tree tree_;
+	QuantLib::Size timeSteps_;
+
+	// Option values and, for American exercise, spots at the nodes of
+	// the current step
+	mutable std::vector<QuantLib::Real> values_;
+	mutable std::vector<QuantLib::Real> spots_;
+
+};
+
+#endif
@@ -0,0 +1,106 @@
+/* -*- mode: c++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+// QuantLib Black-Scholes-Merton test - batched elementary functions
+
+#include "VectorMath.hpp"
+#include "FastMath.hpp"
+
+using namespace QuantLib;
+
+namespace {
+
+	// f over x[0, n) on pack V, the tail on pack S
+	template <class V, class S, class F>
+	inline void Apply(const typename V::value_type * x,
+		Size n,
+		typename V::value_type * out,
+		F f)
+	{
+		Size i = 0;
+		for (; i + V::width <= n; i += V::width)
+			V::store(out + i, f.template operator()<V>(V::load(x + i)));
+		for (; i < n; ++i)
+			S::store(out + i, f.template operator()<S>(S::load(x + i)));
+	}
+
+	struct ExpFunction {
+		template <class V>
+		typename V::reg operator()(typename V::reg x) const { return simd::Exp<V>(x); }
+	};
+
+	struct LogFunction {
+		template <class V>
+		typename V::reg operator()(typename V::reg x) const { return simd::Log<V>(x); }
+	};
+
+	struct NormalPdfFunction {
+		template <class V>
+		typename V::reg operator()(typename V::reg x) const { return simd::NormalPdf<V>(x); }
+	};
+
+	struct NormalCdfFunction {
+		template <class V>
+		typename V::reg operator()(typename V::reg x) const { return simd::NormalCdf<V>(x); }
+	};
+
+	struct InverseNormalCdfFunction {
+		template <class V>
+		typename V::reg operator()(typename V::reg p) const { return simd::InverseNormalCdf<V>(p); }
+	};
+
+	typedef simd::Native D;
+	typedef simd::Scalar DS;
+	typedef simd::FloatNative F;
+	typedef simd::FloatScalar FS;
+
+}
+
+void BatchExp(const double * x, Size n, double * out)
+{
+	Apply<D, DS>(x, n, out, ExpFunction());
+}
+
+void BatchLog(const double * x, Size n, double * out)
+{
+	Apply<D, DS>(x, n, out, LogFunction());
+}
+
+void BatchNormalPdf(const double * x, Size n, double * out)
+{
+	Apply<D, DS>(x, n, out, NormalPdfFunction());
+}
+
+void BatchNormalCdf(const double * x, Size n, double * out)
+{
+	Apply<D, DS>(x, n, out, NormalCdfFunction());
+}
+
+void BatchInverseNormalCdf(const double * p, Size n, double * out)
+{
+	Apply<D, DS>(p, n, out, InverseNormalCdfFunction());
+}
+
+void BatchExp(const float * x, Size n, float * out)
+{
+	Apply<F, FS>(x, n, out, ExpFunction());
+}
+
+void BatchLog(const float * x, Size n, float * out)
+{
+	Apply<F, FS>(x, n, out, LogFunction());
+}
+
+void BatchNormalPdf(const float * x, Size n, float * out)
+{
+	Apply<F, FS>(x, n, out, NormalPdfFunction());
+}
+
+void BatchNormalCdf(const float * x, Size n, float * out)
+{
+	Apply<F, FS>(x, n, out, NormalCdfFunction());
+}
+
+void BatchInverseNormalCdf(const float * p, Size n, float * out)
+{
+	Apply<F, FS>(p, n, out, InverseNormalCdfFunction());
+}
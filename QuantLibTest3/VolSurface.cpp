@@ -0,0 +1,224 @@
+/* -*- mode: c++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+// QuantLib Black-Scholes-Merton test - volatility surfaces
+
+#include "VolSurface.hpp"
+#include "CsvParsing.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+
+using namespace QuantLib;
+
+namespace {
+
+	// Shortest time looked up, as BlackVolTermStructure::blackVol()
+	// does for expiries at the reference date
+	const Time minimumTime = 0.00001;
+
+}
+
+VolSurfaceInputs ReadVolSurfaceCsv(const std::string & path)
+{
+	std::ifstream file(path.c_str());
+	QL_REQUIRE(file, "cannot open " << path);
+
+	VolSurfaceInputs surface;
+	std::string line;
+	QL_REQUIRE(std::getline(file, line), path << " is empty");
+	std::vector<std::string> header = SplitCsv(line);
+	QL_REQUIRE(header.size() >= 2, "no expiries in the header of " << path);
+	for (Size j = 1; j < header.size(); ++j) {
+		surface.expiries.push_back(ParseIsoDate(header[j], 1));
+		QL_REQUIRE(j == 1 || surface.expiries[j - 1] > surface.expiries[j - 2],
+			"expiries not increasing in " << path);
+	}
+
+	std::vector<std::vector<Real> > rows;
+	Size lineNumber = 1;
+	while (std::getline(file, line)) {
+		++lineNumber;
+		if (line.empty())
+			continue;
+		std::vector<std::string> fields = SplitCsv(line);
+		QL_REQUIRE(fields.size() == header.size(),
+			"expected " << header.size() << " fields on line " << lineNumber
+			<< " of " << path);
+		surface.strikes.push_back(ParseReal(fields[0], lineNumber));
+		QL_REQUIRE(surface.strikes.size() == 1
+			|| surface.strikes.back() > surface.strikes[surface.strikes.size() - 2],
+			"strikes not increasing in " << path);
+		std::vector<Real> row(fields.size() - 1);
+		for (Size j = 0; j < row.size(); ++j)
+			row[j] = ParseReal(fields[j + 1], lineNumber);
+		rows.push_back(row);
+	}
+	QL_REQUIRE(rows.size() >= 2, "fewer than two strikes in " << path);
+
+	surface.volatilities = Matrix(rows.size(), surface.expiries.size());
+	for (Size i = 0; i < rows.size(); ++i)
+		for (Size j = 0; j < rows[i].size(); ++j)
+			surface.volatilities[i][j] = rows[i][j];
+	return surface;
+}
+
+VolSurfaceInputs SmileSurface(const OptionInputs & in,
+	const Date & settlementDate,
+	Size expiries,
+	Size strikes)
+{
+	QL_REQUIRE(expiries >= 1 && strikes >= 2,
+		"a surface needs an expiry and two strikes");
+
+	VolSurfaceInputs surface;
+	for (Size j = 0; j < expiries; ++j)
+		surface.expiries.push_back(settlementDate
+		+ Integer(1826 * (j + 1) / expiries));
+	for (Size i = 0; i < strikes; ++i)
+		surface.strikes.push_back(in.strike * (0.5 + 1.5 * i / (strikes - 1)));
+
+	surface.volatilities = Matrix(strikes, expiries);
+	for (Size i = 0; i < strikes; ++i) {
+		Real x = std::log(surface.strikes[i] / in.strike);
+		for (Size j = 0; j < expiries; ++j) {
+			Time t = in.dayCounter.yearFraction(settlementDate, surface.expiries[j]);
+			surface.volatilities[i][j] = in.volatility
+				+ (0.15 * x - 0.1) * x / std::sqrt(t + 0.25);
+		}
+	}
+	return surface;
+}
+
+boost::shared_ptr<BlackVarianceSurface> MakeVolSurface(
+	const VolSurfaceInputs & surface,
+	const Date & settlementDate,
+	const Calendar & calendar,
+	const DayCounter & dayCounter)
+{
+	return boost::shared_ptr<BlackVarianceSurface>(
+		new BlackVarianceSurface(settlementDate,
+		calendar,
+		surface.expiries,
+		surface.strikes,
+		surface.volatilities,
+		dayCounter,
+		BlackVarianceSurface::ConstantExtrapolation,
+		BlackVarianceSurface::ConstantExtrapolation));
+}
+
+void VolSurfaceIndex::Axis::build(Size bucketsPerInterval)
+{
+	QL_REQUIRE(nodes.size() >= 2, "an axis needs two nodes");
+	first = nodes.front();
+	last = nodes.back();
+
+	const Size intervals = nodes.size() - 1;
+	buckets.resize(bucketsPerInterval * intervals);
+	inverseWidth = buckets.size() / (last - first);
+
+	Size interval = 0;
+	for (Size b = 0; b < buckets.size(); ++b) {
+		Real edge = first + b / inverseWidth;
+		while (interval + 1 < intervals && edge >= nodes[interval + 1])
+			++interval;
+		buckets[b] = interval;
+	}
+}
+
+Size VolSurfaceIndex::Axis::locate(Real x) const
+{
+	Size b = std::min(Size((x - first) * inverseWidth), buckets.size() - 1);
+	Size interval = buckets[b];
+	while (interval + 2 < nodes.size() && x >= nodes[interval + 1])
+		++interval;
+	return interval;
+}
+
+VolSurfaceIndex::VolSurfaceIndex(const VolSurfaceInputs & surface,
+	const Date & settlementDate,
+	const DayCounter & dayCounter,
+	Size bucketsPerInterval)
+{
+	const Size expiries = surface.expiries.size();
+	const Size strikes = surface.strikes.size();
+	QL_REQUIRE(expiries >= 1 && strikes >= 2,
+		"a surface needs an expiry and two strikes");
+	QL_REQUIRE(surface.volatilities.rows() == strikes
+		&& surface.volatilities.columns() == expiries,
+		"volatility matrix is " << surface.volatilities.rows() << "x"
+		<< surface.volatilities.columns() << ", expected "
+		<< strikes << "x" << expiries);
+	QL_REQUIRE(bucketsPerInterval > 0, "no buckets per interval");
+
+	// As BlackVarianceSurface: variance grows from zero at time zero
+	times_.nodes.push_back(0.0);
+	for (Size j = 0; j < expiries; ++j) {
+		times_.nodes.push_back(dayCounter.yearFraction(settlementDate,
+			surface.expiries[j]));
+		QL_REQUIRE(times_.nodes[j + 1] > times_.nodes[j],
+			"expiries not increasing after the settlement date");
+	}
+	strikes_.nodes = surface.strikes;
+	times_.build(bucketsPerInterval);
+	strikes_.build(bucketsPerInterval);
+
+	const Size timeNodes = expiries + 1;
+	std::vector<Real> variances(strikes * timeNodes, 0.0);
+	for (Size i = 0; i < strikes; ++i)
+		for (Size j = 0; j < expiries; ++j) {
+			Volatility vol = surface.volatilities[i][j];
+			variances[i * timeNodes + j + 1] = vol * vol * times_.nodes[j + 1];
+		}
+
+	cells_.resize((strikes - 1) * expiries);
+	for (Size i = 0; i + 1 < strikes; ++i)
+		for (Size j = 0; j < expiries; ++j) {
+			Real w00 = variances[i * timeNodes + j];
+			Real w10 = variances[i * timeNodes + j + 1];
+			Real w01 = variances[(i + 1) * timeNodes + j];
+			Real w11 = variances[(i + 1) * timeNodes + j + 1];
+
+			Cell & cell = cells_[i * expiries + j];
+			cell.time = times_.nodes[j];
+			cell.inverseDt = 1.0 / (times_.nodes[j + 1] - times_.nodes[j]);
+			cell.strike = strikes_.nodes[i];
+			cell.inverseDk = 1.0 / (strikes_.nodes[i + 1] - strikes_.nodes[i]);
+			cell.w0 = w00;
+			cell.a = w10 - w00;
+			cell.b = w01 - w00;
+			cell.c = w11 - w10 - w01 + w00;
+		}
+}
+
+Volatility VolSurfaceIndex::volatility(Time t,
+	Real strike) const
+{
+	// Flat volatility beyond the grid: clamping the time keeps w / t,
+	// clamping the strike keeps w
+	t = std::min(std::max(t, minimumTime), times_.last);
+	strike = std::min(std::max(strike, strikes_.first), strikes_.last);
+
+	const Cell & cell = cells_[strikes_.locate(strike) * (times_.nodes.size() - 1)
+		+ times_.locate(t)];
+	Real u = (t - cell.time) * cell.inverseDt;
+	Real v = (strike - cell.strike) * cell.inverseDk;
+	Real variance = cell.w0 + cell.a * u + (cell.b + cell.c * u) * v;
+	return std::sqrt(std::max(variance, 0.0) / t);
+}
+
+void VolSurfaceIndex::volatilities(const Real * times,
+	const Real * strikes,
+	Size n,
+	Real * volatilities) const
+{
+	for (Size i = 0; i < n; ++i)
+		volatilities[i] = volatility(times[i], strikes[i]);
+}
+
+void VolSurfaceIndex::volatilities(OptionArrays & arrays) const
+{
+	if (arrays.size() > 0)
+		volatilities(&arrays.time[0], &arrays.strike[0], arrays.size(),
+			&arrays.volatility[0]);
+}
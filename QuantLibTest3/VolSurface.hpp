@@ -0,0 +1,106 @@
+/* -*- mode: c++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+// QuantLib Black-Scholes-Merton test - volatility surfaces
+
+#ifndef quantlibtest3_vol_surface_hpp
+#define quantlibtest3_vol_surface_hpp
+
+#include "OptionInputs.hpp"
+#include "BlackScholesKernel.hpp"
+
+#include <string>
+#include <vector>
+
+// Black volatilities on a strike x expiry grid, laid out as
+// BlackVarianceSurface takes them: one row per strike
+struct VolSurfaceInputs {
+	std::vector<QuantLib::Date> expiries;
+	std::vector<QuantLib::Real> strikes;
+	QuantLib::Matrix volatilities;
+};
+
+/* Read a surface from CSV: a header of "strike" and the expiries as
+YYYY-MM-DD, then one line per strike of the strike and its
+volatilities. Expiries and strikes must be increasing.
+*/
+VolSurfaceInputs ReadVolSurfaceCsv(const std::string & path);
+
+// A skewed smile around the option's volatility on an even grid of
+// strikes from half to twice its strike and of expiries up to five
+// years, for runs without a surface file
+VolSurfaceInputs SmileSurface(const OptionInputs & in,
+	const QuantLib::Date & settlementDate,
+	QuantLib::Size expiries,
+	QuantLib::Size strikes);
+
+// The surface as a term structure for EquityOption(): bilinear in
+// variance, flat in volatility beyond the first and last strikes and
+// beyond the last expiry
+boost::shared_ptr<QuantLib::BlackVarianceSurface> MakeVolSurface(
+	const VolSurfaceInputs & surface,
+	const QuantLib::Date & settlementDate,
+	const QuantLib::Calendar & calendar,
+	const QuantLib::DayCounter & dayCounter);
+
+/** Volatility lookups on a surface without the term structure.
+
+Gives the same volatilities as MakeVolSurface()'s surface, from a
+precomputed index instead of binary searches behind virtual calls.
+Each axis keeps a table of evenly spaced buckets holding the grid
+interval their left edge falls in, so a lookup is a multiply, a
+table load and at most a step or two forward on grids whose spacing
+doesn't vary by more than bucketsPerInterval. Each grid cell keeps
+its origin, inverse widths and the four coefficients of its bilinear
+variance in one 64-byte line, so interpolating touches one cache line
+besides the two bucket tables.
+*/
+class VolSurfaceIndex
+{
+
+public:
+
+	VolSurfaceIndex(const VolSurfaceInputs & surface,
+		const QuantLib::Date & settlementDate,
+		const QuantLib::DayCounter & dayCounter,
+		QuantLib::Size bucketsPerInterval = 4);
+
+	QuantLib::Volatility volatility(QuantLib::Time t,
+		QuantLib::Real strike) const;
+
+	// volatilities[i] for times[i] and strikes[i], i in [0, n)
+	void volatilities(const QuantLib::Real * times,
+		const QuantLib::Real * strikes,
+		QuantLib::Size n,
+		QuantLib::Real * volatilities) const;
+
+	// Set the volatility of every option of the arrays from its time
+	// and strike
+	void volatilities(OptionArrays & arrays) const;
+
+	QuantLib::Size cells() const { return cells_.size(); }
+
+private:
+
+	// Grid nodes of one axis and the interval of each bucket
+	struct Axis {
+		std::vector<QuantLib::Real> nodes;
+		std::vector<QuantLib::Size> buckets;
+		QuantLib::Real first, last, inverseWidth;
+
+		void build(QuantLib::Size bucketsPerInterval);
+		QuantLib::Size locate(QuantLib::Real x) const;
+	};
+
+	// w = w0 + a u + b v + c u v with u and v the distances from the
+	// cell's origin in time and strike scaled to the cell's widths
+	struct Cell {
+		QuantLib::Real time, inverseDt, strike, inverseDk;
+		QuantLib::Real w0, a, b, c;
+	};
+
+	Axis times_, strikes_;
+	std::vector<Cell> cells_;
+
+};
+
+#endif
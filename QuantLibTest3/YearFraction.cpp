@@ -0,0 +1,118 @@
+/* -*- mode: c++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+// QuantLib Black-Scholes-Merton test - batch year fractions
+
+#include "YearFraction.hpp"
+
+#include <algorithm>
+
+using namespace QuantLib;
+
+namespace {
+
+	// The implementation a day counter shares with its copies
+	struct SharedImpl : DayCounter {
+		static const void * of(const DayCounter & dayCounter)
+		{
+			return (dayCounter.*&SharedImpl::impl_).get();
+		}
+	};
+
+	bool SameDayCounter(const DayCounter & a, const DayCounter & b)
+	{
+		return SharedImpl::of(a) == SharedImpl::of(b) || a == b;
+	}
+
+}
+
+YearFractionTable::YearFractionTable(const Date & settlementDate) :
+	settlementDate_(settlementDate),
+	calls_(0)
+{
+}
+
+// Index of the convention of a day counter, added on first sight
+Size YearFractionTable::convention(const DayCounter & dayCounter)
+{
+	const std::string name = dayCounter.name();
+	for (Size i = 0; i < conventions_.size(); ++i)
+		if (conventions_[i].name == name)
+			return i;
+
+	Convention c;
+	c.dayCounter = dayCounter;
+	c.name = name;
+	c.daysPerYear = dayCounter == Actual365Fixed() ? 365.0
+		: dayCounter == Actual360() ? 360.0
+		: 0.0;
+	conventions_.push_back(c);
+	return conventions_.size() - 1;
+}
+
+void YearFractionTable::yearFractions(const OptionInputs * inputs,
+	Size n,
+	Time * times)
+{
+	conventions_.clear();
+	calls_ = 0;
+	if (n == 0)
+		return;
+
+	// Serial numbers and conventions, consecutive options on the same
+	// day counter skipping the lookup
+	serials_.resize(n);
+	optionConventions_.resize(n);
+	Date::serial_type first = inputs[0].maturity.serialNumber(), last = first;
+	Size current = convention(inputs[0].dayCounter);
+	for (Size i = 0; i < n; ++i) {
+		serials_[i] = inputs[i].maturity.serialNumber();
+		first = std::min(first, serials_[i]);
+		last = std::max(last, serials_[i]);
+
+		if (i > 0 && !SameDayCounter(inputs[i].dayCounter,
+			inputs[i - 1].dayCounter))
+			current = convention(inputs[i].dayCounter);
+		optionConventions_[i] = current;
+	}
+
+	// Conventions without a closed form get a table over [first, last]
+	// with one yearFraction() call per distinct maturity
+	const Size dates = Size(last - first + 1);
+	for (Size c = 0; c < conventions_.size(); ++c) {
+		Convention & entry = conventions_[c];
+		if (entry.daysPerYear > 0.0)
+			continue;
+		entry.times.assign(dates, Null<Time>());
+		for (Size i = 0; i < n; ++i) {
+			if (optionConventions_[i] != c)
+				continue;
+			Time & t = entry.times[Size(serials_[i] - first)];
+			if (t == Null<Time>()) {
+				t = entry.dayCounter.yearFraction(settlementDate_,
+					inputs[i].maturity);
+				++calls_;
+			}
+		}
+	}
+
+	// The kernels only see the resulting doubles. Day counts are exact
+	// in a double, so dividing them gives what the day counter would.
+	const Date::serial_type settlement = settlementDate_.serialNumber();
+	if (conventions_.size() == 1 && conventions_[0].daysPerYear > 0.0) {
+		const Real daysPerYear = conventions_[0].daysPerYear;
+		const Date::serial_type * serials = &serials_[0];
+		for (Size i = 0; i < n; ++i)
+			times[i] = Real(serials[i] - settlement) / daysPerYear;
+	} else if (conventions_.size() == 1) {
+		const Time * table = &conventions_[0].times[0];
+		for (Size i = 0; i < n; ++i)
+			times[i] = table[Size(serials_[i] - first)];
+	} else {
+		for (Size i = 0; i < n; ++i) {
+			const Convention & entry = conventions_[optionConventions_[i]];
+			times[i] = entry.daysPerYear > 0.0
+				? Real(serials_[i] - settlement) / entry.daysPerYear
+				: entry.times[Size(serials_[i] - first)];
+		}
+	}
+}
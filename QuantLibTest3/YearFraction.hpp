@@ -0,0 +1,70 @@
+/* -*- mode: c++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+// QuantLib Black-Scholes-Merton test - batch year fractions
+
+#ifndef quantlibtest3_year_fraction_hpp
+#define quantlibtest3_year_fraction_hpp
+
+#include "OptionInputs.hpp"
+
+#include <string>
+#include <vector>
+
+/** Year fractions from a settlement date to the maturities of a book.
+
+Rather than one DayCounter::yearFraction() call per option, the book
+is taken one day-count convention at a time. The maturities are
+first turned into an array of date serial numbers. Actual/365 (Fixed)
+and Actual/360 times are then a division of each serial's distance
+from the settlement date, a loop the compiler vectorizes and which
+gives the same doubles as the day counters. Other conventions get a
+table of year fractions indexed by serial number over the book's
+maturities, filled with one yearFraction() call per distinct
+maturity, which every option of the convention then reads.
+
+Options are matched to conventions by day counter name, as
+DayCounter::operator== does, but only where the day counter differs
+from the previous option's. Copies of one day counter, which the
+portfolio loaders give every option of a convention, share their
+implementation and are recognized by it without building a name, so
+a run of them costs a pointer comparison per option. The serial
+number and convention buffers are kept between calls; use one
+instance per thread.
+*/
+class YearFractionTable
+{
+
+public:
+
+	explicit YearFractionTable(const QuantLib::Date & settlementDate);
+
+	// times[i] for the maturity and day counter of inputs[i], i in [0, n)
+	void yearFractions(const OptionInputs * inputs,
+		QuantLib::Size n,
+		QuantLib::Time * times);
+
+	// Conventions in the last book, and the yearFraction() calls made
+	// for those without a closed form
+	QuantLib::Size conventions() const { return conventions_.size(); }
+	QuantLib::Size yearFractionCalls() const { return calls_; }
+
+private:
+
+	struct Convention {
+		QuantLib::DayCounter dayCounter;
+		std::string name;
+		QuantLib::Real daysPerYear;          // 0 without a closed form
+		std::vector<QuantLib::Time> times;   // by serial, without one
+	};
+
+	QuantLib::Size convention(const QuantLib::DayCounter & dayCounter);
+
+	QuantLib::Date settlementDate_;
+	std::vector<Convention> conventions_;
+	std::vector<QuantLib::Date::serial_type> serials_;
+	std::vector<QuantLib::Size> optionConventions_;
+	QuantLib::Size calls_;
+
+};
+
+#endif
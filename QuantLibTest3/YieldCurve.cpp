@@ -0,0 +1,204 @@
+/* -*- mode: c++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+// QuantLib Black-Scholes-Merton test - bootstrapped yield curves
+
+#include "YieldCurve.hpp"
+#include "CsvParsing.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+
+using namespace QuantLib;
+
+namespace {
+
+	// 10D, 1W, 3M, 5Y
+	Period ParsePeriod(const std::string & field, Size lineNumber)
+	{
+		int length;
+		char unit;
+		QL_REQUIRE(std::sscanf(field.c_str(), "%d%c", &length, &unit) == 2
+			&& length > 0,
+			"invalid tenor '" << field << "' on line " << lineNumber);
+		switch (unit) {
+		case 'D': return Period(length, Days);
+		case 'W': return Period(length, Weeks);
+		case 'M': return Period(length, Months);
+		case 'Y': return Period(length, Years);
+		default:
+			QL_FAIL("invalid tenor unit '" << unit << "' on line " << lineNumber);
+		}
+	}
+
+	CurveQuote MakeQuote(CurveQuote::Instrument instrument,
+		const Period & tenor,
+		const Date & startDate,
+		Real quote)
+	{
+		CurveQuote q;
+		q.instrument = instrument;
+		q.tenor = tenor;
+		q.startDate = startDate;
+		q.quote = quote;
+		return q;
+	}
+
+}
+
+std::vector<CurveQuote> ReadCurveCsv(const std::string & path)
+{
+	std::ifstream file(path.c_str());
+	QL_REQUIRE(file, "cannot open " << path);
+
+	std::vector<CurveQuote> quotes;
+	std::string line;
+	Size lineNumber = 1;
+	std::getline(file, line);
+	while (std::getline(file, line)) {
+		++lineNumber;
+		if (line.empty())
+			continue;
+		std::vector<std::string> fields = SplitCsv(line);
+		QL_REQUIRE(fields.size() == 3,
+			"expected 3 fields on line " << lineNumber << " of " << path);
+		Real quote = ParseReal(fields[2], lineNumber);
+		if (fields[0] == "deposit")
+			quotes.push_back(MakeQuote(CurveQuote::Deposit,
+			ParsePeriod(fields[1], lineNumber), Date(), quote));
+		else if (fields[0] == "future")
+			quotes.push_back(MakeQuote(CurveQuote::Future,
+			Period(), ParseIsoDate(fields[1], lineNumber), quote));
+		else if (fields[0] == "swap")
+			quotes.push_back(MakeQuote(CurveQuote::Swap,
+			ParsePeriod(fields[1], lineNumber), Date(), quote));
+		else
+			QL_FAIL("unknown instrument '" << fields[0] << "' on line "
+			<< lineNumber << " of " << path);
+	}
+	QL_REQUIRE(!quotes.empty(), "no instruments in " << path);
+	return quotes;
+}
+
+std::vector<CurveQuote> SampleCurve(Rate rate,
+	const Date & settlementDate)
+{
+	std::vector<CurveQuote> quotes;
+	quotes.push_back(MakeQuote(CurveQuote::Deposit, Period(1, Weeks), Date(), rate - 0.0020));
+	quotes.push_back(MakeQuote(CurveQuote::Deposit, Period(1, Months), Date(), rate - 0.0015));
+	quotes.push_back(MakeQuote(CurveQuote::Deposit, Period(3, Months), Date(), rate - 0.0010));
+
+	Date imm = IMM::nextDate(settlementDate + Period(3, Months));
+	for (Size i = 0; i < 4; ++i) {
+		quotes.push_back(MakeQuote(CurveQuote::Future, Period(), imm,
+			100.0 * (1.0 - (rate - 0.0005 + 0.0005 * i))));
+		imm = IMM::nextDate(imm + 1);
+	}
+
+	const Integer years[] = { 2, 3, 5, 7, 10, 15, 20, 30 };
+	for (Size i = 0; i < LENGTH(years); ++i)
+		quotes.push_back(MakeQuote(CurveQuote::Swap, Period(years[i], Years), Date(),
+			rate + 0.01 * (1.0 - std::exp(-years[i] / 10.0))));
+	return quotes;
+}
+
+boost::shared_ptr<YieldTermStructure> BootstrapCurve(
+	const std::vector<CurveQuote> & quotes,
+	const Date & settlementDate,
+	const Calendar & calendar,
+	const DayCounter & dayCounter)
+{
+	const Natural fixingDays = 2;
+	const Natural futureMonths = 3;
+	boost::shared_ptr<IborIndex> floatingIndex(new Euribor6M);
+
+	std::vector<boost::shared_ptr<RateHelper> > helpers;
+	for (Size i = 0; i < quotes.size(); ++i) {
+		Handle<QuantLib::Quote> quote(
+			boost::shared_ptr<QuantLib::Quote>(new SimpleQuote(quotes[i].quote)));
+		switch (quotes[i].instrument) {
+		case CurveQuote::Deposit:
+			helpers.push_back(boost::shared_ptr<RateHelper>(
+				new DepositRateHelper(quote, quotes[i].tenor, fixingDays,
+				calendar, ModifiedFollowing, true, Actual360())));
+			break;
+		case CurveQuote::Future:
+			helpers.push_back(boost::shared_ptr<RateHelper>(
+				new FuturesRateHelper(quote, quotes[i].startDate, futureMonths,
+				calendar, ModifiedFollowing, true, Actual360())));
+			break;
+		case CurveQuote::Swap:
+			helpers.push_back(boost::shared_ptr<RateHelper>(
+				new SwapRateHelper(quote, quotes[i].tenor, calendar, Annual,
+				Unadjusted, Thirty360(), floatingIndex)));
+			break;
+		default:
+			QL_FAIL("unknown curve instrument");
+		}
+	}
+
+	boost::shared_ptr<YieldTermStructure> curve(
+		new PiecewiseYieldCurve<Discount, LogLinear>(settlementDate, helpers,
+		dayCounter));
+	curve->enableExtrapolation();
+	return curve;
+}
+
+DiscountTable::DiscountTable(const boost::shared_ptr<YieldTermStructure> & curve,
+	const OptionInputs * inputs,
+	Size n) :
+	first_(0),
+	dates_(0)
+{
+	if (n == 0)
+		return;
+
+	// Maturities before the curve's reference date, which only expired
+	// options have, get no discount factor
+	const Date::serial_type reference = curve->referenceDate().serialNumber();
+	Date::serial_type first = 0, last = 0;
+	bool any = false;
+	for (Size i = 0; i < n; ++i) {
+		Date::serial_type maturity = inputs[i].maturity.serialNumber();
+		if (maturity < reference)
+			continue;
+		first = any ? std::min(first, maturity) : maturity;
+		last = any ? std::max(last, maturity) : maturity;
+		any = true;
+	}
+	if (!any)
+		return;
+
+	first_ = first;
+	discounts_.assign(Size(last - first + 1), Null<DiscountFactor>());
+	for (Size i = 0; i < n; ++i) {
+		if (inputs[i].maturity.serialNumber() < reference)
+			continue;
+		DiscountFactor & discount =
+			discounts_[Size(inputs[i].maturity.serialNumber() - first_)];
+		if (discount == Null<DiscountFactor>()) {
+			discount = curve->discount(inputs[i].maturity);
+			++dates_;
+		}
+	}
+}
+
+DiscountFactor DiscountTable::discount(const Date & d) const
+{
+	Date::serial_type index = d.serialNumber() - first_;
+	QL_REQUIRE(index >= 0 && Size(index) < discounts_.size()
+		&& discounts_[Size(index)] != Null<DiscountFactor>(),
+		d << " is not a maturity of the book");
+	return discounts_[Size(index)];
+}
+
+void DiscountTable::zeroRates(const OptionInputs * inputs,
+	Size n,
+	OptionArrays & arrays) const
+{
+	for (Size i = 0; i < n; ++i)
+		arrays.rate[i] = arrays.time[i] > 0.0
+			? -std::log(discount(inputs[i].maturity)) / arrays.time[i]
+			: 0.0;
+}
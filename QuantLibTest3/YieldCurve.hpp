@@ -0,0 +1,87 @@
+/* -*- mode: c++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+// QuantLib Black-Scholes-Merton test - bootstrapped yield curves
+
+#ifndef quantlibtest3_yield_curve_hpp
+#define quantlibtest3_yield_curve_hpp
+
+#include "OptionInputs.hpp"
+#include "BlackScholesKernel.hpp"
+
+#include <string>
+#include <vector>
+
+// One quote of the instruments a curve is bootstrapped on
+struct CurveQuote {
+	enum Instrument { Deposit, Future, Swap };
+
+	Instrument instrument;
+	QuantLib::Period tenor;      // deposits and swaps
+	QuantLib::Date startDate;    // futures: the IMM date they start on
+	QuantLib::Real quote;        // rate, or price for futures
+};
+
+/* Read curve quotes from CSV: a header, then one instrument per line
+as "deposit,3M,0.0525", "future,1998-06-17,94.80" or "swap,5Y,0.061",
+tenors in D, W, M or Y
+*/
+std::vector<CurveQuote> ReadCurveCsv(const std::string & path);
+
+// Deposits to 3M, four futures from the next IMM date and swaps to
+// 30Y on a gently upward sloping curve around the given rate, for
+// runs without a curve file
+std::vector<CurveQuote> SampleCurve(QuantLib::Rate rate,
+	const QuantLib::Date & settlementDate);
+
+/* Bootstrap the quotes into a PiecewiseYieldCurve, log-linear in
+discount factors. Deposits and futures use Actual/360 and swaps pay
+annual 30/360 fixed against Euribor 6M, on the given calendar.
+*/
+boost::shared_ptr<QuantLib::YieldTermStructure> BootstrapCurve(
+	const std::vector<CurveQuote> & quotes,
+	const QuantLib::Date & settlementDate,
+	const QuantLib::Calendar & calendar,
+	const QuantLib::DayCounter & dayCounter);
+
+/** Discount factors of a curve at the maturities of a book.
+
+The curve is asked once for each distinct maturity; the factors are
+kept in a flat table indexed by date serial number from the book's
+earliest maturity to its latest, so that looking one up is a
+subtraction and a load and the curve can be shared by the whole book
+without every option going through its interpolation and virtual
+calls.
+*/
+class DiscountTable
+{
+
+public:
+
+	DiscountTable(const boost::shared_ptr<QuantLib::YieldTermStructure> & curve,
+		const OptionInputs * inputs,
+		QuantLib::Size n);
+
+	// d must be the maturity of one of the book's options, not before
+	// the curve's reference date
+	QuantLib::DiscountFactor discount(const QuantLib::Date & d) const;
+
+	// Continuously compounded zero rates to the maturities of
+	// inputs[0, n) into arrays.rate, given the arrays' times. Options
+	// with time <= 0 get 0: the kernels price them as expired or at
+	// their payoff, neither of which the rate enters.
+	void zeroRates(const OptionInputs * inputs,
+		QuantLib::Size n,
+		OptionArrays & arrays) const;
+
+	// Distinct maturities, and so curve lookups
+	QuantLib::Size dates() const { return dates_; }
+
+private:
+
+	QuantLib::Date::serial_type first_;
+	std::vector<QuantLib::DiscountFactor> discounts_;
+	QuantLib::Size dates_;
+
+};
+
+#endif
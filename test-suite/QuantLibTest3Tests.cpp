@@ -0,0 +1,969 @@
+/* -*- mode: c++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+// QuantLib Black-Scholes-Merton test - test suite
+
+/* The correctness checks of the pricing modules, run by ctest. The
+driver's benchmark mode checks the same properties on its larger
+books as it times them; these run in seconds on small ones, on the
+dates and option of the driver.
+*/
+
+#define BOOST_TEST_MODULE QuantLibTest3
+#include <boost/test/included/unit_test.hpp>
+#include <boost/scoped_ptr.hpp>
+
+#include "OptionInputs.hpp"
+#include "BatchPricer.hpp"
+#include "BlackScholesKernel.hpp"
+#include "PayoffKernel.hpp"
+#include "AmericanApproximations.hpp"
+#include "ImpliedVolatility.hpp"
+#include "MonteCarloEngine.hpp"
+#include "Philox.hpp"
+#include "YearFraction.hpp"
+#include "ArenaPricer.hpp"
+#include "SnapshotPricer.hpp"
+#include "LiveRepricer.hpp"
+#include "PortfolioLoader.hpp"
+#include "ResultsSink.hpp"
+#include "CommandLine.hpp"
+#include "FiniteDifferenceEngine.hpp"
+#include "TreeEngine.hpp"
+#include "Adjoint.hpp"
+#include "VolSurface.hpp"
+#include "YieldCurve.hpp"
+#include "MarketCache.hpp"
+#include "VectorMath.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <vector>
+
+using namespace QuantLib;
+
+namespace {
+
+	const Date todaysDate(15, May, 1998);
+	const Date settlementDate(17, May, 1998);
+
+	// The evaluation date of the driver's runs, for every test
+	struct EvaluationDate {
+		EvaluationDate() { Settings::instance().evaluationDate() = todaysDate; }
+	};
+
+	// The option the driver prices
+	OptionInputs ReferenceOption()
+	{
+		OptionInputs in;
+		in.type = Option::Put;
+		in.underlying = 36;
+		in.strike = 40;
+		in.dividendYield = 0.00;
+		in.riskFreeRate = 0.06;
+		in.volatility = 0.20;
+		in.maturity = Date(17, May, 1999);
+		in.dayCounter = Actual365Fixed();
+		return in;
+	}
+
+	/* n options around the reference option: strikes from half to
+	one and a half times its strike, calls then puts, maturities up to
+	five years and a dividend yield, so both types and the discounting
+	of both curves are exercised
+	*/
+	std::vector<OptionInputs> Book(Size n)
+	{
+		OptionInputs in = ReferenceOption();
+		in.dividendYield = 0.02;
+		std::vector<OptionInputs> book(n, in);
+		for (Size i = 0; i < n; ++i) {
+			book[i].type = i < n / 2 ? Option::Call : Option::Put;
+			book[i].strike = in.strike * (0.5 + Real(i) / n);
+			book[i].maturity = settlementDate + Integer(30 + (i * 7919) % 1800);
+		}
+		return book;
+	}
+
+	// The option's price through AnalyticEuropeanEngine and a
+	// VanillaOption with the given payoff
+	Real EnginePrice(const OptionInputs & in,
+		const boost::shared_ptr<StrikedTypePayoff> & payoff)
+	{
+		Handle<Quote> underlyingH(
+			boost::shared_ptr<Quote>(new SimpleQuote(in.underlying)));
+		VanillaOption option(payoff,
+			boost::shared_ptr<Exercise>(new EuropeanExercise(in.maturity)));
+		option.setPricingEngine(boost::shared_ptr<PricingEngine>(
+			new AnalyticEuropeanEngine(
+			MakeProcess(underlyingH, in, settlementDate, TARGET()))));
+		return option.NPV();
+	}
+
+	// The reference option's market with its own spot quote
+	boost::shared_ptr<BlackScholesMertonProcess> ReferenceProcess()
+	{
+		OptionInputs in = ReferenceOption();
+		Handle<Quote> underlyingH(
+			boost::shared_ptr<Quote>(new SimpleQuote(in.underlying)));
+		return MakeProcess(underlyingH, in, settlementDate, TARGET());
+	}
+
+	// The reference option's price under the given exercise and engine
+	Real ReferencePrice(const boost::shared_ptr<Exercise> & exercise,
+		const boost::shared_ptr<PricingEngine> & engine)
+	{
+		OptionInputs in = ReferenceOption();
+		VanillaOption option(
+			boost::shared_ptr<StrikedTypePayoff>(
+			new PlainVanillaPayoff(in.type, in.strike)), exercise);
+		option.setPricingEngine(engine);
+		return option.NPV();
+	}
+
+	// ParseCommandLine on the arguments after the program name
+	CommandLine Parse(const char * const * args,
+		Size n)
+	{
+		std::vector<char *> argv(1, const_cast<char *>("QuantLibTest3"));
+		for (Size i = 0; i < n; ++i)
+			argv.push_back(const_cast<char *>(args[i]));
+		return ParseCommandLine(int(argv.size()), &argv[0]);
+	}
+
+	void CheckSameOption(const OptionInputs & read,
+		const OptionInputs & written)
+	{
+		BOOST_CHECK_EQUAL(read.type, written.type);
+		BOOST_CHECK_EQUAL(read.underlying, written.underlying);
+		BOOST_CHECK_EQUAL(read.strike, written.strike);
+		BOOST_CHECK_EQUAL(read.dividendYield, written.dividendYield);
+		BOOST_CHECK_EQUAL(read.riskFreeRate, written.riskFreeRate);
+		BOOST_CHECK_EQUAL(read.volatility, written.volatility);
+		BOOST_CHECK(read.maturity == written.maturity);
+		BOOST_CHECK(read.dayCounter == written.dayCounter);
+	}
+
+	// A Monte Carlo price of the reference option and its error
+	Real McPrice(ParallelMcEuropeanEngine::Sequence sequence,
+		Size threads,
+		Real & errorEstimate)
+	{
+		OptionInputs in = ReferenceOption();
+		Handle<Quote> underlyingH(
+			boost::shared_ptr<Quote>(new SimpleQuote(in.underlying)));
+		VanillaOption option(
+			boost::shared_ptr<StrikedTypePayoff>(
+			new PlainVanillaPayoff(in.type, in.strike)),
+			boost::shared_ptr<Exercise>(new EuropeanExercise(in.maturity)));
+		option.setPricingEngine(boost::shared_ptr<PricingEngine>(
+			new ParallelMcEuropeanEngine(
+			MakeProcess(underlyingH, in, settlementDate, TARGET()),
+			16384, 4, true, true, threads, 42, sequence)));
+		errorEstimate = option.errorEstimate();
+		return option.NPV();
+	}
+
+}
+
+BOOST_GLOBAL_FIXTURE(EvaluationDate);
+
+BOOST_AUTO_TEST_CASE(kernelMatchesAnalyticEngine)
+{
+	const Size n = 1000;
+	std::vector<OptionInputs> book = Book(n);
+	std::vector<Real> kernelNpvs(n), engineNpvs(n);
+
+	OptionArrays arrays;
+	LoadOptionArrays(&book[0], n, settlementDate, arrays);
+	BlackScholesKernel(arrays, &kernelNpvs[0]);
+
+	BatchPricer pricer(settlementDate, TARGET());
+	pricer.price(&book[0], n, &engineNpvs[0]);
+
+	for (Size i = 0; i < n; ++i)
+		BOOST_CHECK_SMALL(kernelNpvs[i] - engineNpvs[i], 1.0e-12);
+}
+
+BOOST_AUTO_TEST_CASE(payoffKernelMatchesAnalyticEngine)
+{
+	const Size n = 200;
+	std::vector<OptionInputs> book = Book(n);
+	OptionArrays arrays;
+	LoadOptionArrays(&book[0], n, settlementDate, arrays);
+
+	const payoff::CashOrNothing cash = { 10.0 };
+	std::vector<Real> vanillaNpvs(n), cashNpvs(n), assetNpvs(n);
+	BlackScholesKernel(arrays, payoff::PlainVanilla(), &vanillaNpvs[0]);
+	BlackScholesKernel(arrays, cash, &cashNpvs[0]);
+	BlackScholesKernel(arrays, payoff::AssetOrNothing(), &assetNpvs[0]);
+
+	for (Size i = 0; i < n; i += 7) {
+		const OptionInputs & in = book[i];
+		BOOST_CHECK_SMALL(vanillaNpvs[i] - EnginePrice(in,
+			boost::shared_ptr<StrikedTypePayoff>(
+			new PlainVanillaPayoff(in.type, in.strike))), 1.0e-11);
+		BOOST_CHECK_SMALL(cashNpvs[i] - EnginePrice(in,
+			boost::shared_ptr<StrikedTypePayoff>(
+			new CashOrNothingPayoff(in.type, in.strike, cash.cash))), 1.0e-11);
+		BOOST_CHECK_SMALL(assetNpvs[i] - EnginePrice(in,
+			boost::shared_ptr<StrikedTypePayoff>(
+			new AssetOrNothingPayoff(in.type, in.strike))), 1.0e-11);
+	}
+}
+
+BOOST_AUTO_TEST_CASE(expiredOptionsPriceToZero)
+{
+	// Maturities on and before the evaluation date, as BatchPricer
+	// and Instrument::NPV() see them
+	const Size n = 16;
+	std::vector<OptionInputs> book = Book(n);
+	for (Size i = 0; i < n; ++i)
+		book[i].maturity = todaysDate - Integer(i);
+
+	OptionArrays arrays;
+	LoadOptionArrays(&book[0], n, settlementDate, arrays);
+	std::vector<Real> kernelNpvs(n), payoffNpvs(n), batchNpvs(n);
+	OptionResults greeks;
+	BlackScholesKernel(arrays, &kernelNpvs[0]);
+	BlackScholesKernel(arrays, payoff::PlainVanilla(), &payoffNpvs[0]);
+	BlackScholesGreeksKernel(arrays, greeks);
+	BatchPricer(settlementDate, TARGET()).price(&book[0], n, &batchNpvs[0]);
+
+	std::vector<Real> americanNpvs(n);
+	AmericanApproximationKernel(arrays, BaroneAdesiWhaley, &americanNpvs[0]);
+
+	for (Size i = 0; i < n; ++i) {
+		BOOST_CHECK_EQUAL(kernelNpvs[i], 0.0);
+		BOOST_CHECK_EQUAL(payoffNpvs[i], 0.0);
+		BOOST_CHECK_EQUAL(greeks.npv[i], 0.0);
+		BOOST_CHECK_EQUAL(greeks.delta[i], 0.0);
+		BOOST_CHECK_EQUAL(americanNpvs[i], 0.0);
+		BOOST_CHECK_EQUAL(batchNpvs[i], 0.0);
+	}
+}
+
+BOOST_AUTO_TEST_CASE(optionsAtSettlementPriceToPayoff)
+{
+	// Live on the evaluation date but with no time left from the
+	// settlement date: the engine's zero-variance price, the payoff
+	const Size n = 16;
+	std::vector<OptionInputs> book = Book(n);
+	for (Size i = 0; i < n; ++i)
+		book[i].maturity = settlementDate;
+
+	OptionArrays arrays;
+	LoadOptionArrays(&book[0], n, settlementDate, arrays);
+	std::vector<Real> kernelNpvs(n), americanNpvs(n), batchNpvs(n);
+	BlackScholesKernel(arrays, &kernelNpvs[0]);
+	AmericanApproximationKernel(arrays, BaroneAdesiWhaley, &americanNpvs[0]);
+	BatchPricer(settlementDate, TARGET()).price(&book[0], n, &batchNpvs[0]);
+
+	for (Size i = 0; i < n; ++i) {
+		Real payoff = PlainVanillaPayoff(book[i].type, book[i].strike)(
+			book[i].underlying);
+		BOOST_CHECK_SMALL(kernelNpvs[i] - payoff, 1.0e-12);
+		BOOST_CHECK_SMALL(americanNpvs[i] - payoff, 1.0e-12);
+		BOOST_CHECK_SMALL(batchNpvs[i] - payoff, 1.0e-12);
+	}
+}
+
+BOOST_AUTO_TEST_CASE(optionsBeforeSettlementAreRejected)
+{
+	// Maturing after the evaluation date but before settlement: the
+	// engine has a negative time and throws, and so does the loader
+	std::vector<OptionInputs> book = Book(1);
+	book[0].maturity = todaysDate + 1;
+
+	OptionArrays arrays;
+	BOOST_CHECK_THROW(LoadOptionArrays(&book[0], 1, settlementDate, arrays),
+		Error);
+	Real npv;
+	BOOST_CHECK_THROW(
+		BatchPricer(settlementDate, TARGET()).price(&book[0], 1, &npv),
+		Error);
+}
+
+BOOST_AUTO_TEST_CASE(impliedVolatilitiesRoundTrip)
+{
+	// Calls and puts across strikes and volatilities, all with enough
+	// time value for the volatility to be well defined
+	const Size n = 1000;
+	std::vector<OptionInputs> book(n, ReferenceOption());
+	for (Size i = 0; i < n; ++i) {
+		book[i].type = i % 2 == 0 ? Option::Call : Option::Put;
+		book[i].dividendYield = 0.02;
+		book[i].strike *= 0.8 + 0.45 * i / n;
+		book[i].volatility *= 0.5 + 2.0 * ((i * 7919) % n) / n;
+	}
+
+	OptionArrays arrays;
+	LoadOptionArrays(&book[0], n, settlementDate, arrays);
+	std::vector<Real> prices(n), vols(n);
+	BlackScholesKernel(arrays, &prices[0]);
+	ImpliedVolatilityKernel(arrays, &prices[0], &vols[0]);
+
+	for (Size i = 0; i < n; ++i)
+		BOOST_CHECK_SMALL(vols[i] - book[i].volatility, 1.0e-10);
+
+	// Below the intrinsic value there is no volatility
+	prices[0] = 0.0;
+	prices[1] = -1.0;
+	ImpliedVolatilityKernel(arrays, &prices[0], &vols[0]);
+	BOOST_CHECK(vols[0] != vols[0]);
+	BOOST_CHECK(vols[1] != vols[1]);
+}
+
+BOOST_AUTO_TEST_CASE(liveRepricerRecalculatesTickedUnderlying)
+{
+	const Size underlyings = 3, optionsPerUnderlying = 5;
+	std::vector<OptionInputs> book = Book(optionsPerUnderlying);
+
+	LiveRepricer repricer(settlementDate, TARGET());
+	for (Size u = 0; u < underlyings; ++u) {
+		Size underlying = repricer.addUnderlying(book[0]);
+		for (Size i = 0; i < optionsPerUnderlying; ++i)
+			repricer.addOption(underlying, book[i]);
+	}
+
+	std::vector<Real> npvs(optionsPerUnderlying);
+	for (Size u = 0; u < underlyings; ++u)
+		repricer.NPVs(u, &npvs[0]);
+	const Size initialCalculations = repricer.recalculations();
+
+	// Only the options of the ticked underlying are recalculated, to
+	// the prices of the new spot
+	const Real spot = book[0].underlying * 1.01;
+	repricer.setSpot(1, spot);
+	for (Size u = 0; u < underlyings; ++u)
+		repricer.NPVs(u, &npvs[0]);
+	BOOST_CHECK_EQUAL(repricer.recalculations() - initialCalculations,
+		optionsPerUnderlying);
+
+	for (Size i = 0; i < optionsPerUnderlying; ++i)
+		book[i].underlying = spot;
+	std::vector<Real> expected(optionsPerUnderlying);
+	BatchPricer(settlementDate, TARGET()).price(&book[0],
+		optionsPerUnderlying, &expected[0]);
+	repricer.NPVs(1, &npvs[0]);
+	for (Size i = 0; i < optionsPerUnderlying; ++i)
+		BOOST_CHECK_SMALL(npvs[i] - expected[i], 1.0e-12);
+}
+
+BOOST_AUTO_TEST_CASE(portfolioFilesRoundTrip)
+{
+	const Size n = 1000, chunkSize = 64;
+	const std::string csvPath = "QuantLibTest3Tests-portfolio.csv";
+	const std::string binaryPath = "QuantLibTest3Tests-portfolio.bin";
+	std::vector<OptionInputs> book = Book(n);
+	const DayCounter dayCounters[] = { Actual365Fixed(), Actual360(),
+		Thirty360(), ActualActual() };
+	for (Size i = 0; i < n; ++i)
+		book[i].dayCounter = dayCounters[i % LENGTH(dayCounters)];
+
+	WritePortfolioCsv(csvPath, &book[0], n);
+	WritePortfolioBinary(binaryPath, &book[0], n);
+	BOOST_CHECK_EQUAL(PortfolioSize(csvPath), n);
+	BOOST_CHECK_EQUAL(PortfolioSize(binaryPath), n);
+
+	const std::string paths[] = { csvPath, binaryPath };
+	for (Size f = 0; f < LENGTH(paths); ++f) {
+		std::vector<OptionInputs> read;
+		boost::scoped_ptr<PortfolioReader> reader(OpenPortfolio(paths[f]));
+		Size streamed = StreamPortfolio(*reader, chunkSize,
+			[&](const OptionInputs * chunk, Size m) {
+			read.insert(read.end(), chunk, chunk + m);
+		});
+		BOOST_CHECK_EQUAL(streamed, n);
+		BOOST_REQUIRE_EQUAL(read.size(), n);
+		for (Size i = 0; i < n; ++i)
+			CheckSameOption(read[i], book[i]);
+	}
+
+	// A binary file shorter than its header says, and one whose count
+	// would wrap around when multiplied by the record size
+	{
+		std::ifstream in(binaryPath.c_str(), std::ios::binary);
+		std::string bytes((std::istreambuf_iterator<char>(in)),
+			std::istreambuf_iterator<char>());
+		in.close();
+
+		std::string truncated = bytes.substr(0, bytes.size() - 8);
+		std::ofstream(binaryPath.c_str(), std::ios::binary).write(
+			truncated.data(), truncated.size());
+		BOOST_CHECK_THROW(BinaryPortfolioReader reader(binaryPath), Error);
+
+		std::string wrapping = bytes;
+		const boost::uint64_t count = (boost::uint64_t(1) << 60) + n / 3;
+		std::memcpy(&wrapping[8], &count, sizeof(count));
+		std::ofstream(binaryPath.c_str(), std::ios::binary).write(
+			wrapping.data(), wrapping.size());
+		BOOST_CHECK_THROW(BinaryPortfolioReader reader(binaryPath), Error);
+	}
+
+	std::remove(csvPath.c_str());
+	std::remove(binaryPath.c_str());
+}
+
+BOOST_AUTO_TEST_CASE(malformedPortfolioLinesAreRejected)
+{
+	const std::string header =
+		"type,underlying,strike,dividendYield,riskFreeRate,"
+		"volatility,maturity,dayCounter\n";
+	const char * malformed[] = {
+		"Put,36,40,0,0.06,0.2,1999-05-17\n",
+		"Put,36,40,0,0.06,0.2,1999-05-17,Actual/365 (Fixed),1\n",
+		"Put,36,40,0,0.06,0.2,1999-05-17,Actual/365 (Fixed),\n",
+		"Put,36,forty,0,0.06,0.2,1999-05-17,Actual/365 (Fixed)\n",
+		"Put,36,40x,0,0.06,0.2,1999-05-17,Actual/365 (Fixed)\n",
+		"Straddle,36,40,0,0.06,0.2,1999-05-17,Actual/365 (Fixed)\n",
+		"Put,36,40,0,0.06,0.2,17/05/1999,Actual/365 (Fixed)\n",
+		"Put,36,40,0,0.06,0.2,1999-05-17,Business/252\n"
+	};
+
+	OptionInputs in;
+	{
+		std::istringstream stream(header
+			+ "Put,36,40,0,0.06,0.2,1999-05-17,Actual/365 (Fixed)\r\n");
+		CsvPortfolioReader reader(stream);
+		BOOST_CHECK_EQUAL(reader.read(&in, 1), 1U);
+		CheckSameOption(in, ReferenceOption());
+	}
+	for (Size i = 0; i < LENGTH(malformed); ++i) {
+		std::istringstream stream(header + malformed[i]);
+		CsvPortfolioReader reader(stream);
+		BOOST_CHECK_THROW(reader.read(&in, 1), Error);
+	}
+}
+
+BOOST_AUTO_TEST_CASE(mappedResultsReadBack)
+{
+	const Size n = 1000, chunkSize = 300;
+	const std::string path = "QuantLibTest3Tests-results.bin";
+	std::vector<OptionInputs> book = Book(n);
+	OptionArrays arrays;
+	LoadOptionArrays(&book[0], n, settlementDate, arrays);
+	OptionResults expected;
+	BlackScholesGreeksKernel(arrays, expected);
+
+	{
+		// Written a chunk at a time, each in its own windows
+		MappedResultsSink sink(path, n);
+		for (Size first = 0; first < n; first += chunkSize) {
+			Size m = std::min(chunkSize, n - first);
+			OptionArrays chunk;
+			LoadOptionArrays(&book[first], m, settlementDate, chunk);
+			WriteOptionResults(chunk, sink, first);
+		}
+		sink.flush();
+		BOOST_CHECK_THROW(sink.reserve(n - 1, 2), Error);
+
+		const std::vector<Real> * columns[] = { &expected.npv,
+			&expected.delta, &expected.gamma, &expected.vega,
+			&expected.theta, &expected.rho, &expected.dividendRho,
+			&expected.vanna, &expected.volga };
+		for (Size c = 0; c < LENGTH(columns); ++c) {
+			const Real * written = sink.column(c, 0, n);
+			for (Size i = 0; i < n; ++i)
+				BOOST_CHECK_EQUAL(written[i], (*columns[c])[i]);
+		}
+	}
+
+	// The file as another reader sees it
+	std::ifstream file(path.c_str(), std::ios::binary);
+	char magic[8];
+	boost::uint64_t rows, columns, stride;
+	file.read(magic, sizeof(magic));
+	file.read(reinterpret_cast<char *>(&rows), sizeof(rows));
+	file.read(reinterpret_cast<char *>(&columns), sizeof(columns));
+	file.read(reinterpret_cast<char *>(&stride), sizeof(stride));
+	BOOST_CHECK(std::equal(magic, magic + sizeof(magic), "QLRESV01"));
+	BOOST_CHECK_EQUAL(rows, n);
+	BOOST_CHECK_EQUAL(columns, 9U);
+	std::vector<Real> volga(n);
+	file.seekg(64 + 8 * stride * sizeof(Real));
+	file.read(reinterpret_cast<char *>(&volga[0]), n * sizeof(Real));
+	BOOST_CHECK(file);
+	file.close();
+	for (Size i = 0; i < n; ++i)
+		BOOST_CHECK_EQUAL(volga[i], expected.volga[i]);
+
+	std::remove(path.c_str());
+}
+
+BOOST_AUTO_TEST_CASE(commandLineParses)
+{
+	const char * none[] = { "" };
+	CommandLine defaults = Parse(none, 0);
+	BOOST_CHECK_EQUAL(defaults.mode, CommandLine::BenchmarkSuite);
+	BOOST_CHECK_EQUAL(defaults.threads, 0U);
+	BOOST_CHECK_EQUAL(defaults.chunkSize, 65536U);
+	BOOST_CHECK_EQUAL(defaults.repetitions, 10U);
+	BOOST_CHECK(!defaults.help);
+
+	const char * batch[] = { "batch", "-t", "4", "--input", "book.csv",
+		"-o", "results.bin", "--curve", "curve.csv", "--surface",
+		"surface.csv", "--chunk", "100", "--repetitions", "3", "--help" };
+	CommandLine cl = Parse(batch, LENGTH(batch));
+	BOOST_CHECK_EQUAL(cl.mode, CommandLine::Batch);
+	BOOST_CHECK_EQUAL(cl.threads, 4U);
+	BOOST_CHECK_EQUAL(cl.input, "book.csv");
+	BOOST_CHECK_EQUAL(cl.output, "results.bin");
+	BOOST_CHECK_EQUAL(cl.curve, "curve.csv");
+	BOOST_CHECK_EQUAL(cl.surface, "surface.csv");
+	BOOST_CHECK_EQUAL(cl.chunkSize, 100U);
+	BOOST_CHECK_EQUAL(cl.repetitions, 3U);
+	BOOST_CHECK(cl.help);
+
+	const char * single[] = { "single" };
+	BOOST_CHECK_EQUAL(Parse(single, 1).mode, CommandLine::Single);
+	const char * server[] = { "server", "-i", "-" };
+	BOOST_CHECK_EQUAL(Parse(server, 3).mode, CommandLine::Server);
+}
+
+BOOST_AUTO_TEST_CASE(commandLineRejectsBadArguments)
+{
+	const char * unknownMode[] = { "price" };
+	const char * unknownOption[] = { "batch", "--fast", "1" };
+	const char * missingValue[] = { "batch", "--input" };
+	const char * negativeCount[] = { "batch", "--threads", "-2" };
+	const char * notACount[] = { "batch", "--chunk", "many" };
+	const char * zeroChunk[] = { "batch", "--chunk", "0" };
+	const char * zeroRepetitions[] = { "benchmark", "--repetitions", "0" };
+	const char * serverThreads[] = { "server", "--threads", "4" };
+
+	BOOST_CHECK_THROW(Parse(unknownMode, LENGTH(unknownMode)), Error);
+	BOOST_CHECK_THROW(Parse(unknownOption, LENGTH(unknownOption)), Error);
+	BOOST_CHECK_THROW(Parse(missingValue, LENGTH(missingValue)), Error);
+	BOOST_CHECK_THROW(Parse(negativeCount, LENGTH(negativeCount)), Error);
+	BOOST_CHECK_THROW(Parse(notACount, LENGTH(notACount)), Error);
+	BOOST_CHECK_THROW(Parse(zeroChunk, LENGTH(zeroChunk)), Error);
+	BOOST_CHECK_THROW(Parse(zeroRepetitions, LENGTH(zeroRepetitions)), Error);
+	BOOST_CHECK_THROW(Parse(serverThreads, LENGTH(serverThreads)), Error);
+}
+
+BOOST_AUTO_TEST_CASE(philoxMatchesKnownAnswers)
+{
+	// Philox4x32-10 known-answer vectors of the Random123 distribution:
+	// key (k0, k1), counter, output
+	struct KnownAnswer {
+		Philox4x32::word key[2];
+		Philox4x32::word counter[4];
+		Philox4x32::word output[4];
+	};
+	const KnownAnswer answers[] = {
+		{ { 0x00000000, 0x00000000 },
+		{ 0x00000000, 0x00000000, 0x00000000, 0x00000000 },
+		{ 0x6627e8d5, 0xe169c58d, 0xbc57ac4c, 0x9b00dbd8 } },
+		{ { 0xffffffff, 0xffffffff },
+		{ 0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff },
+		{ 0x408f276d, 0x41c83b0e, 0xa20bc7c6, 0x6d5451fd } },
+		{ { 0xa4093822, 0x299f31d0 },
+		{ 0x243f6a88, 0x85a308d3, 0x13198a2e, 0x03707344 },
+		{ 0xd16cfe09, 0x94fdcceb, 0x5001e420, 0x24126ea1 } }
+	};
+
+	for (Size i = 0; i < LENGTH(answers); ++i) {
+		const KnownAnswer & a = answers[i];
+		Philox4x32 rng(boost::uint64_t(a.key[1]) << 32 | a.key[0]);
+		Philox4x32::Block b = rng(a.counter[0], a.counter[1],
+			a.counter[2], a.counter[3]);
+		for (Size j = 0; j < 4; ++j)
+			BOOST_CHECK_EQUAL(b.v[j], a.output[j]);
+	}
+}
+
+BOOST_AUTO_TEST_CASE(monteCarloIsDeterministic)
+{
+	// The same seed gives the same bits at any thread count
+	const ParallelMcEuropeanEngine::Sequence sequences[] = {
+		ParallelMcEuropeanEngine::PseudoRandom, ParallelMcEuropeanEngine::Sobol };
+	OptionInputs in = ReferenceOption();
+	Real analytic = EnginePrice(in, boost::shared_ptr<StrikedTypePayoff>(
+		new PlainVanillaPayoff(in.type, in.strike)));
+
+	for (Size s = 0; s < LENGTH(sequences); ++s) {
+		Real singleError, parallelError, againError;
+		Real single = McPrice(sequences[s], 1, singleError);
+		Real parallel = McPrice(sequences[s], 4, parallelError);
+		Real again = McPrice(sequences[s], 4, againError);
+		BOOST_CHECK_EQUAL(single, parallel);
+		BOOST_CHECK_EQUAL(singleError, parallelError);
+		BOOST_CHECK_EQUAL(parallel, again);
+		BOOST_CHECK_SMALL(single - analytic, 5.0 * singleError);
+	}
+}
+
+BOOST_AUTO_TEST_CASE(finiteDifferencesConverge)
+{
+	OptionInputs in = ReferenceOption();
+	boost::shared_ptr<BlackScholesMertonProcess> process = ReferenceProcess();
+	boost::shared_ptr<Exercise> american(
+		new AmericanExercise(settlementDate, in.maturity));
+	boost::shared_ptr<Exercise> european(new EuropeanExercise(in.maturity));
+
+	Real reference = ReferencePrice(american, boost::shared_ptr<PricingEngine>(
+		new FdCrankNicolsonEngine(process, 1000, 1000)));
+	Real americanNpv = ReferencePrice(american, boost::shared_ptr<PricingEngine>(
+		new FdCrankNicolsonEngine(process, 100, 400)));
+	Real europeanNpv = ReferencePrice(european, boost::shared_ptr<PricingEngine>(
+		new FdCrankNicolsonEngine(process, 100, 400)));
+	Real analytic = EnginePrice(in, boost::shared_ptr<StrikedTypePayoff>(
+		new PlainVanillaPayoff(in.type, in.strike)));
+
+	BOOST_CHECK_SMALL(americanNpv - reference, 1.0e-3);
+	BOOST_CHECK_SMALL(europeanNpv - analytic, 1.0e-3);
+	BOOST_CHECK_GT(americanNpv, europeanNpv);
+}
+
+BOOST_AUTO_TEST_CASE(americanApproximationsMatchFiniteDifferences)
+{
+	// Maturities, moneyness, volatilities and dividend yields around
+	// the reference option, calls and puts
+	const Integer days[] = { 90, 365 };
+	const Real moneyness[] = { 0.9, 1.0, 1.1 };
+	const Volatility vols[] = { 0.2, 0.3 };
+	const Spread dividends[] = { 0.0, 0.04 };
+	const Option::Type types[] = { Option::Put, Option::Call };
+	const OptionInputs in = ReferenceOption();
+
+	std::vector<OptionInputs> grid;
+	for (Size d = 0; d < LENGTH(days); ++d)
+		for (Size k = 0; k < LENGTH(moneyness); ++k)
+			for (Size v = 0; v < LENGTH(vols); ++v)
+				for (Size q = 0; q < LENGTH(dividends); ++q)
+					for (Size t = 0; t < LENGTH(types); ++t) {
+						OptionInputs option = in;
+						option.type = types[t];
+						option.underlying = in.strike * moneyness[k];
+						option.volatility = vols[v];
+						option.dividendYield = dividends[q];
+						option.maturity = settlementDate + days[d];
+						grid.push_back(option);
+					}
+	const Size n = grid.size();
+
+	std::vector<Real> reference(n);
+	for (Size i = 0; i < n; ++i) {
+		Handle<Quote> underlyingH(
+			boost::shared_ptr<Quote>(new SimpleQuote(grid[i].underlying)));
+		VanillaOption option(
+			boost::shared_ptr<StrikedTypePayoff>(
+			new PlainVanillaPayoff(grid[i].type, grid[i].strike)),
+			boost::shared_ptr<Exercise>(
+			new AmericanExercise(settlementDate, grid[i].maturity)));
+		option.setPricingEngine(boost::shared_ptr<PricingEngine>(
+			new FdCrankNicolsonEngine(
+			MakeProcess(underlyingH, grid[i], settlementDate, TARGET()),
+			200, 1000)));
+		reference[i] = option.NPV();
+	}
+
+	OptionArrays arrays;
+	LoadOptionArrays(&grid[0], n, settlementDate, arrays);
+	std::vector<Real> european(n);
+	BlackScholesKernel(arrays, &european[0]);
+
+	// QD+ is the most accurate of the three by an order of magnitude
+	const AmericanApproximation methods[] = {
+		BaroneAdesiWhaley, BjerksundStensland, QdPlus };
+	const Real tolerances[] = { 0.05, 0.05, 5.0e-3 };
+	std::vector<Real> npvs(n);
+	for (Size m = 0; m < LENGTH(methods); ++m) {
+		AmericanApproximationKernel(arrays, methods[m], &npvs[0]);
+		for (Size i = 0; i < n; ++i) {
+			Real intrinsic = PlainVanillaPayoff(grid[i].type, grid[i].strike)(
+				grid[i].underlying);
+			BOOST_CHECK_SMALL(npvs[i] - reference[i], tolerances[m]);
+			BOOST_CHECK_GE(npvs[i], european[i] - 1.0e-12);
+			BOOST_CHECK_GE(npvs[i], intrinsic - 1.0e-12);
+		}
+	}
+}
+
+BOOST_AUTO_TEST_CASE(treesConvergeToAnalytic)
+{
+	OptionInputs in = ReferenceOption();
+	boost::shared_ptr<BlackScholesMertonProcess> process = ReferenceProcess();
+	boost::shared_ptr<Exercise> american(
+		new AmericanExercise(settlementDate, in.maturity));
+	boost::shared_ptr<Exercise> european(new EuropeanExercise(in.maturity));
+	Real analytic = EnginePrice(in, boost::shared_ptr<StrikedTypePayoff>(
+		new PlainVanillaPayoff(in.type, in.strike)));
+	Real fd = ReferencePrice(american, boost::shared_ptr<PricingEngine>(
+		new FdCrankNicolsonEngine(process, 1000, 1000)));
+
+	// Leisen-Reimer converges as 1/n^2, the others as 1/n
+	const BinomialTreeEngine::Tree trees[] = {
+		BinomialTreeEngine::CoxRossRubinstein,
+		BinomialTreeEngine::JarrowRudd,
+		BinomialTreeEngine::LeisenReimer };
+	const Real tolerances[] = { 1.0e-2, 1.0e-2, 1.0e-4 };
+	const Size steps = 1000;
+
+	for (Size t = 0; t < LENGTH(trees); ++t) {
+		boost::shared_ptr<PricingEngine> engine(
+			new BinomialTreeEngine(process, trees[t], steps));
+		Real europeanNpv = ReferencePrice(european, engine);
+		Real americanNpv = ReferencePrice(american, engine);
+		BOOST_CHECK_SMALL(europeanNpv - analytic, tolerances[t]);
+		BOOST_CHECK_SMALL(americanNpv - fd, 1.0e-2);
+		BOOST_CHECK_GT(americanNpv, europeanNpv);
+	}
+}
+
+BOOST_AUTO_TEST_CASE(adjointMatchesFiniteDifferences)
+{
+	const Size n = 20;
+	std::vector<OptionInputs> book = Book(n);
+	ad::Tape tape;
+	const Real h = 1.0e-5;
+
+	// Central differences of the engine price in each input
+	for (Size i = 0; i < n; ++i) {
+		OptionSensitivities adjoint =
+			AdjointBlackScholes(book[i], settlementDate, tape);
+
+		Real * inputs[] = { &book[i].underlying, &book[i].strike,
+			&book[i].riskFreeRate, &book[i].dividendYield,
+			&book[i].volatility };
+		const Real adjoints[] = { adjoint.underlying, adjoint.strike,
+			adjoint.riskFreeRate, adjoint.dividendYield, adjoint.volatility };
+
+		BOOST_CHECK_SMALL(adjoint.npv - EnginePrice(book[i],
+			boost::shared_ptr<StrikedTypePayoff>(
+			new PlainVanillaPayoff(book[i].type, book[i].strike))), 1.0e-12);
+
+		for (Size k = 0; k < LENGTH(inputs); ++k) {
+			Real value = *inputs[k];
+			Real step = h * std::max(std::fabs(value), 1.0);
+			*inputs[k] = value + step;
+			Real up = EnginePrice(book[i], boost::shared_ptr<StrikedTypePayoff>(
+				new PlainVanillaPayoff(book[i].type, book[i].strike)));
+			*inputs[k] = value - step;
+			Real down = EnginePrice(book[i], boost::shared_ptr<StrikedTypePayoff>(
+				new PlainVanillaPayoff(book[i].type, book[i].strike)));
+			*inputs[k] = value;
+
+			Real difference = (up - down) / (2.0 * step);
+			BOOST_CHECK_SMALL(adjoints[k] - difference,
+				1.0e-6 * std::max(std::fabs(difference), 1.0));
+		}
+	}
+}
+
+BOOST_AUTO_TEST_CASE(surfaceIndexMatchesVarianceSurface)
+{
+	OptionInputs in = ReferenceOption();
+	const VolSurfaceInputs grid = SmileSurface(in, settlementDate, 10, 20);
+	const Integer days = grid.expiries.back() - settlementDate;
+
+	const Size n = 2000;
+	std::vector<OptionInputs> book = Book(n);
+	for (Size i = 0; i < n; ++i)
+		book[i].maturity = settlementDate + Integer(1 + (i * 7919) % days);
+	OptionArrays arrays;
+	LoadOptionArrays(&book[0], n, settlementDate, arrays);
+
+	boost::shared_ptr<BlackVarianceSurface> surface =
+		MakeVolSurface(grid, settlementDate, TARGET(), in.dayCounter);
+	VolSurfaceIndex index(grid, settlementDate, in.dayCounter);
+	index.volatilities(arrays);
+
+	for (Size i = 0; i < n; ++i)
+		BOOST_CHECK_SMALL(arrays.volatility[i]
+			- surface->blackVol(arrays.time[i], arrays.strike[i], true), 1.0e-12);
+}
+
+BOOST_AUTO_TEST_CASE(discountTableMatchesCurve)
+{
+	OptionInputs in = ReferenceOption();
+	boost::shared_ptr<YieldTermStructure> curve = BootstrapCurve(
+		SampleCurve(in.riskFreeRate, settlementDate),
+		settlementDate, TARGET(), in.dayCounter);
+
+	// Ten years of maturities, the first with no time left
+	const Size n = 2000;
+	std::vector<OptionInputs> book = Book(n);
+	for (Size i = 0; i < n; ++i)
+		book[i].maturity = settlementDate + Integer(i == 0 ? 0 : 1 + (i * 7919) % 3650);
+	OptionArrays arrays;
+	LoadOptionArrays(&book[0], n, settlementDate, arrays);
+
+	DiscountTable table(curve, &book[0], n);
+	table.zeroRates(&book[0], n, arrays);
+
+	BOOST_CHECK_EQUAL(arrays.rate[0], 0.0);
+	for (Size i = 1; i < n; ++i) {
+		BOOST_CHECK_EQUAL(table.discount(book[i].maturity),
+			curve->discount(book[i].maturity));
+		BOOST_CHECK_EQUAL(arrays.rate[i],
+			-std::log(curve->discount(book[i].maturity)) / arrays.time[i]);
+	}
+	BOOST_CHECK_THROW(table.discount(settlementDate + 4000), Error);
+}
+
+BOOST_AUTO_TEST_CASE(marketCacheInternsAndEvicts)
+{
+	// A book on a few underlyings builds one market per underlying
+	const Size n = 500, underlyings = 50;
+	std::vector<OptionInputs> book = Book(n);
+	for (Size i = 0; i < n; ++i)
+		book[i].underlying = 30.0 + Real(i % underlyings) / 5.0;
+
+	MarketCache cache(settlementDate, TARGET());
+	std::vector<boost::shared_ptr<BlackScholesMertonProcess> > processes(n);
+	for (Size i = 0; i < n; ++i)
+		processes[i] = cache.process(book[i]);
+
+	BOOST_CHECK_EQUAL(cache.processes(), underlyings);
+	BOOST_CHECK_EQUAL(cache.marketsBuilt(), underlyings);
+	for (Size i = underlyings; i < n; ++i)
+		BOOST_CHECK(processes[i] == processes[i % underlyings]);
+	BOOST_CHECK(cache.analyticEngine(book[0])
+		== cache.analyticEngine(book[underlyings]));
+	BOOST_CHECK(cache.analyticEngine(book[0]) != cache.analyticEngine(book[1]));
+
+	// A market per option stays within the cache's capacity, and the
+	// processes handed out before it emptied live on
+	const Size maxMarkets = 16;
+	MarketCache bounded(settlementDate, TARGET(), maxMarkets);
+	for (Size i = 0; i < n; ++i) {
+		OptionInputs distinct = book[i];
+		distinct.volatility += 1.0e-6 * i;
+		processes[i] = bounded.process(distinct);
+		BOOST_CHECK_LE(bounded.processes(), maxMarkets);
+	}
+	BOOST_CHECK_EQUAL(bounded.marketsBuilt(), n);
+	BOOST_CHECK_EQUAL(processes[0]->x0(), book[0].underlying);
+
+	bounded.clear();
+	BOOST_CHECK_EQUAL(bounded.processes(), 0U);
+	BOOST_CHECK_EQUAL(bounded.quotes(), 0U);
+}
+
+BOOST_AUTO_TEST_CASE(yearFractionsMatchDayCounters)
+{
+	// Runs of each convention, with and without a closed form
+	const Size n = 1200;
+	std::vector<OptionInputs> book = Book(n);
+	const DayCounter dayCounters[] = { Actual365Fixed(), Actual360(),
+		Thirty360(), ActualActual(ActualActual::ISDA) };
+	for (Size i = 0; i < n; ++i)
+		book[i].dayCounter = dayCounters[(i / 100) % LENGTH(dayCounters)];
+
+	std::vector<Time> times(n);
+	YearFractionTable table(settlementDate);
+	table.yearFractions(&book[0], n, &times[0]);
+
+	BOOST_CHECK_EQUAL(table.conventions(), LENGTH(dayCounters));
+	for (Size i = 0; i < n; ++i)
+		BOOST_CHECK_EQUAL(times[i],
+			book[i].dayCounter.yearFraction(settlementDate, book[i].maturity));
+}
+
+BOOST_AUTO_TEST_CASE(arenaMatchesHeap)
+{
+	const Size n = 200;
+	std::vector<OptionInputs> book = Book(n);
+	std::vector<Real> arenaNpvs(n), heapNpvs(n), batchNpvs(n);
+
+	ArenaPricer arena(settlementDate, TARGET(), true);
+	arena.price(&book[0], n, &arenaNpvs[0]);
+	ArenaPricer heap(settlementDate, TARGET(), false);
+	heap.price(&book[0], n, &heapNpvs[0]);
+	BatchPricer(settlementDate, TARGET()).price(&book[0], n, &batchNpvs[0]);
+
+	for (Size i = 0; i < n; ++i) {
+		BOOST_CHECK_EQUAL(arenaNpvs[i], heapNpvs[i]);
+		BOOST_CHECK_SMALL(arenaNpvs[i] - batchNpvs[i], 1.0e-12);
+	}
+}
+
+BOOST_AUTO_TEST_CASE(snapshotMatchesBatchPricer)
+{
+	const Size n = 1000;
+	std::vector<OptionInputs> book = Book(n);
+	std::vector<Real> snapshotNpvs(n), batchNpvs(n);
+
+	SnapshotPrice(&book[0], n, settlementDate, &snapshotNpvs[0]);
+	BatchPricer(settlementDate, TARGET()).price(&book[0], n, &batchNpvs[0]);
+
+	for (Size i = 0; i < n; ++i)
+		BOOST_CHECK_SMALL(snapshotNpvs[i] - batchNpvs[i], 1.0e-12);
+}
+
+BOOST_AUTO_TEST_CASE(vectorMathMatchesScalar)
+{
+	// Arguments spanning what the pricers feed each function
+	const Size n = 10000;
+	std::vector<double> x(n), positive(n), p(n), out(n);
+	for (Size i = 0; i < n; ++i) {
+		x[i] = -8.0 + 16.0 * (i + 0.5) / n;
+		positive[i] = 0.01 + 10.0 * (i + 0.5) / n;
+		p[i] = (i + 0.5) / n;
+	}
+	std::vector<float> xf(x.begin(), x.end()), positivef(positive.begin(),
+		positive.end()), pf(p.begin(), p.end()), outf(n);
+
+	CumulativeNormalDistribution cdf;
+	NormalDistribution pdf;
+	InverseCumulativeNormal inverse;
+
+	// Errors relative to the scalar value, or absolute where the
+	// function is documented so, in double and in float
+	Real errors[5] = {}, floatErrors[5] = {};
+	BatchExp(&x[0], n, &out[0]);
+	BatchExp(&xf[0], n, &outf[0]);
+	for (Size i = 0; i < n; ++i) {
+		Real expected = std::exp(x[i]);
+		errors[0] = std::max(errors[0], std::fabs(out[i] - expected) / expected);
+		Real expectedFloat = std::exp(Real(xf[i]));
+		floatErrors[0] = std::max(floatErrors[0],
+			std::fabs(outf[i] - expectedFloat) / expectedFloat);
+	}
+	BatchLog(&positive[0], n, &out[0]);
+	BatchLog(&positivef[0], n, &outf[0]);
+	for (Size i = 0; i < n; ++i) {
+		Real expected = std::log(positive[i]);
+		Real scale = std::max(std::fabs(expected), 1.0);
+		errors[1] = std::max(errors[1], std::fabs(out[i] - expected) / scale);
+		floatErrors[1] = std::max(floatErrors[1],
+			std::fabs(outf[i] - std::log(Real(positivef[i]))) / scale);
+	}
+	BatchNormalPdf(&x[0], n, &out[0]);
+	BatchNormalPdf(&xf[0], n, &outf[0]);
+	for (Size i = 0; i < n; ++i) {
+		Real expected = pdf(x[i]);
+		errors[2] = std::max(errors[2], std::fabs(out[i] - expected) / expected);
+		floatErrors[2] = std::max(floatErrors[2],
+			std::fabs(outf[i] - pdf(xf[i])) / pdf(xf[i]));
+	}
+	BatchNormalCdf(&x[0], n, &out[0]);
+	BatchNormalCdf(&xf[0], n, &outf[0]);
+	for (Size i = 0; i < n; ++i) {
+		errors[3] = std::max(errors[3], std::fabs(out[i] - cdf(x[i])));
+		floatErrors[3] = std::max(floatErrors[3],
+			std::fabs(outf[i] - cdf(xf[i])));
+	}
+	BatchInverseNormalCdf(&p[0], n, &out[0]);
+	BatchInverseNormalCdf(&pf[0], n, &outf[0]);
+	for (Size i = 0; i < n; ++i) {
+		errors[4] = std::max(errors[4], std::fabs(out[i] - inverse(p[i])));
+		floatErrors[4] = std::max(floatErrors[4],
+			std::fabs(outf[i] - inverse(pf[i])) / std::max(std::fabs(inverse(pf[i])), 1.0));
+	}
+
+	// exp, log, n(x), N(x), N^-1(p); N^-1(p) in double to QuantLib's
+	// own accuracy
+	const Real tolerances[] = { 1.0e-15, 1.0e-15, 1.0e-13, 1.0e-12, 1.0e-7 };
+	const Real floatTolerances[] = { 5.0e-7, 5.0e-7, 2.0e-6, 1.0e-6, 1.0e-6 };
+	for (Size f = 0; f < LENGTH(tolerances); ++f) {
+		BOOST_CHECK_SMALL(errors[f], tolerances[f]);
+		BOOST_CHECK_SMALL(floatErrors[f], floatTolerances[f]);
+	}
+}